@@ -6,6 +6,13 @@
 namespace chart{}
 
 #include "chart/ChartJs.hpp"
+#include "chart/ChartJsAggregation.hpp"
+#include "chart/ChartJsArena.hpp"
+#include "chart/ChartJsChunkWriter.hpp"
+#include "chart/ChartJsDashboard.hpp"
+#include "chart/ChartJsLevelOfDetail.hpp"
+#include "chart/ChartJsLoader.hpp"
+#include "chart/ChartJsWriter.hpp"
 
 using namespace chart;
 
@@ -3,11 +3,20 @@
 #ifndef CHARTAPI_CHART_CHARTJS_HPP
 #define CHARTAPI_CHART_CHARTJS_HPP
 
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <memory>
+#include <type_traits>
+#include <utility>
 
 #include <api/api.hpp>
 #include <json/Json.hpp>
 
+#include "ChartJsWriter.hpp"
+
 namespace chart {
 
 class ChartJsFlags {
@@ -51,6 +60,22 @@ public:
 
   ChartJsColor(var::StringView hex_code);
 
+  // hex code literals such as ChartJsColor("9BA4B2") are parsed at compile
+  // time, other char arrays (such as a runtime buffer) are parsed up to the
+  // terminator as a StringView
+  template <size_t N, typename std::enable_if<N == 7, int>::type = 0>
+  constexpr ChartJsColor(const char (&hex_code)[N]) {
+    for (size_t i = 0; i < 6; i++) {
+      if (get_hex_digit(hex_code[i]) < 0) {
+        return;
+      }
+    }
+    m_red = get_hex_byte(hex_code[0], hex_code[1]);
+    m_green = get_hex_byte(hex_code[2], hex_code[3]);
+    m_blue = get_hex_byte(hex_code[4], hex_code[5]);
+    m_is_valid = true;
+  }
+
   ChartJsColor &set_red(u8 value) {
     m_red = value;
     m_is_valid = true;
@@ -75,11 +100,18 @@ public:
     return *this;
   }
 
+  // length of "rgba(255,255,255,1.00)" plus the terminator
+  static constexpr size_t string_size = 23;
+
   var::GeneralString to_string() const {
-    return var::GeneralString().format("rgba(%d,%d,%d,%0.2f)", m_red, m_green, m_blue,
-                                m_alpha * 1.0f / 255);
+    char buffer[string_size];
+    return var::GeneralString(var::StringView(buffer, to_buffer(buffer)));
   }
 
+  // writes rgba(r,g,b,a) with alpha as a fraction with 2 decimals (same
+  // as printf %0.2f), returns the length without the terminator
+  size_t to_buffer(char (&buffer)[string_size]) const;
+
   static ChartJsColor create_red(u8 value = 255) {
     return ChartJsColor().set_red(value).set_green(0).set_blue(0).set_alpha(
         255);
@@ -119,27 +151,27 @@ public:
         .set_alpha(255);
   }
 
-  static ChartJsColor get_standard(u32 idx) {
-    var::Vector<ChartJsColor> palette = create_standard_palette();
-    return palette.at(idx % palette.count());
-  }
+  static constexpr size_t standard_palette_count = 16;
 
-  static var::Vector<ChartJsColor> create_standard_palette() {
-    var::Vector<ChartJsColor> result = {
-        ChartJsColor("9BA4B2"), ChartJsColor("F1D651"), ChartJsColor("9F5D6B"),
-        ChartJsColor("343D68"), ChartJsColor("94BFDE"), ChartJsColor("AA3C55"),
-        ChartJsColor("255C35"), ChartJsColor("AA9E9B"), ChartJsColor("38323D"),
-        ChartJsColor("84817E"), ChartJsColor("A19B9A"), ChartJsColor("88BCAA"),
-        ChartJsColor("787FCC"), ChartJsColor("2F6192"), ChartJsColor("A2795B"),
-        ChartJsColor("2C1B2E")};
-    return result;
-  }
+  static ChartJsColor get_standard(u32 idx);
+  static var::Vector<ChartJsColor> create_standard_palette();
 
 private:
   ChartJsColor &set_valid(bool value = true) {
     m_is_valid = value;
     return *this;
   }
+
+  static constexpr int get_hex_digit(char value) {
+    return (value >= '0' && value <= '9')   ? value - '0'
+           : (value >= 'a' && value <= 'f') ? value - 'a' + 10
+           : (value >= 'A' && value <= 'F') ? value - 'A' + 10
+                                            : -1;
+  }
+
+  static constexpr u8 get_hex_byte(char high, char low) {
+    return u8(get_hex_digit(high) * 16 + get_hex_digit(low));
+  }
   u8 m_red = 0xff;
   u8 m_green = 0xff;
   u8 m_blue = 0xff;
@@ -147,6 +179,53 @@ private:
   bool m_is_valid = false;
 };
 
+// Interned strings (category labels such as hostnames or endpoints) with
+// integer ids. Each label is stored once, ids are assigned in the order
+// labels are first interned, so equal ids mean equal labels and ids can
+// be sorted by rank(). Tables are shared (with std::shared_ptr) by the
+// columns and chart data that refer to them.
+class ChartJsLabelTable {
+public:
+  static constexpr u32 invalid_id = 0xffffffff;
+
+  // the id of label, added if it is new
+  u32 intern(var::StringView label);
+  // the id of label, invalid_id if it was not interned
+  u32 find(var::StringView label) const;
+
+  // valid until the next label is interned
+  var::StringView at(u32 id) const {
+    const u32 start = id ? m_end_list.at(id - 1) : 0;
+    return var::StringView(m_text.data() + start, m_end_list.at(id) - start);
+  }
+
+  size_t count() const { return m_end_list.count(); }
+  // bytes of label text
+  size_t size() const { return m_text.count(); }
+
+  // position of the label when the labels are sorted by byte value, the
+  // ranks are recalculated after labels are interned (not thread safe)
+  u32 rank(u32 id) const;
+
+  json::JsonArray to_array() const;
+  const ChartJsLabelTable &write(ChartJsWriter &writer) const;
+
+  ChartJsLabelTable &clear();
+
+private:
+  // labels back to back, m_end_list has the end of each
+  var::Vector<char> m_text;
+  var::Vector<u32> m_end_list;
+  // open addressing index of the ids (id + 1, 0 if empty), at most half
+  // full
+  var::Vector<u32> m_slot_list;
+  mutable var::Vector<u32> m_rank_list;
+
+  static u32 get_hash(var::StringView label);
+  size_t get_slot(var::StringView label, u32 hash) const;
+  void grow();
+};
+
 class ChartJsStringDataPoint {
 public:
   json::JsonObject to_object() const {
@@ -186,6 +265,845 @@ private:
   API_AF(ChartJsRealDataPoint, float, y, 0.0f);
 };
 
+// The least and greatest finite values of a column (not valid if there
+// are none) and the least value greater than 0 for logarithmic axes.
+class ChartJsRange {
+public:
+  bool is_valid() const { return minimum() <= maximum(); }
+  bool is_positive_valid() const { return positive_minimum() <= maximum(); }
+
+  ChartJsRange &include(double value) {
+    if (std::isfinite(value)) {
+      m_minimum = value < m_minimum ? value : m_minimum;
+      m_maximum = value > m_maximum ? value : m_maximum;
+      if (value > 0.0 && value < m_positive_minimum) {
+        m_positive_minimum = value;
+      }
+    }
+    return *this;
+  }
+
+  ChartJsRange &include(const ChartJsRange &value) {
+    m_minimum = value.minimum() < m_minimum ? value.minimum() : m_minimum;
+    m_maximum = value.maximum() > m_maximum ? value.maximum() : m_maximum;
+    m_positive_minimum = value.positive_minimum() < m_positive_minimum
+                           ? value.positive_minimum()
+                           : m_positive_minimum;
+    return *this;
+  }
+
+private:
+  API_AF(ChartJsRange, double, minimum, HUGE_VAL);
+  API_AF(ChartJsRange, double, maximum, -HUGE_VAL);
+  API_AF(ChartJsRange, double, positive_minimum, HUGE_VAL);
+};
+
+class ChartJsDataColumn {
+public:
+  enum class Type {
+    none,
+    real32,
+    real64,
+    integer64,
+    // integers (such as epoch milliseconds on a ChartJsAxis::Type::time
+    // axis) stored as the first value, a step and the varint packed
+    // difference of each later value from the step; a regularly sampled
+    // column costs the same at any count (set with set_type())
+    timestamp,
+    // ids of label_table() written as the label strings
+    label
+  };
+
+  // values between timestamp checkpoints (the most decoded per access)
+  static constexpr size_t timestamp_checkpoint_interval = 64;
+
+  // the column type is set by the first append (or set_type()); later
+  // values are converted to the column type (a label column only takes
+  // ids of label_table())
+  ChartJsDataColumn &append(float value);
+  ChartJsDataColumn &append(double value);
+  ChartJsDataColumn &append(s64 value);
+
+  // interns value in label_table() (created if none) and appends the id,
+  // ignored unless the column is empty or a label column
+  ChartJsDataColumn &append(var::StringView value);
+
+  // true if append(value) adds a value rather than ignoring it
+  bool is_appendable(float value) const {
+    return m_type != Type::label || is_label_id(s64(value));
+  }
+  bool is_appendable(double value) const {
+    return m_type != Type::label || is_label_id(s64(value));
+  }
+  bool is_appendable(s64 value) const {
+    return m_type != Type::label || is_label_id(value);
+  }
+  bool is_appendable(var::StringView) const {
+    return m_type == Type::none || m_type == Type::label;
+  }
+
+  ChartJsDataColumn &append(const float *values, size_t count);
+  ChartJsDataColumn &append(const double *values, size_t count);
+  ChartJsDataColumn &append(const s64 *values, size_t count);
+
+  // replaces the values with the storage of values (nothing is copied
+  // unless the column is rolling)
+  ChartJsDataColumn &assign(var::Vector<float> &&values) {
+    return assign(m_real32, std::move(values), Type::real32);
+  }
+  ChartJsDataColumn &assign(var::Vector<double> &&values) {
+    return assign(m_real64, std::move(values), Type::real64);
+  }
+  ChartJsDataColumn &assign(var::Vector<s64> &&values) {
+    return assign(m_integer64, std::move(values), Type::integer64);
+  }
+
+  // a reserve before the column has a type is applied when the type is
+  // set (by set_type() or the first append)
+  ChartJsDataColumn &reserve(size_t count);
+  ChartJsDataColumn &clear();
+
+  // the table of a label column, ids appended to the column must be
+  // from the table (set before appending)
+  const std::shared_ptr<ChartJsLabelTable> &label_table() const {
+    return m_label_table;
+  }
+  ChartJsDataColumn &
+  set_label_table(const std::shared_ptr<ChartJsLabelTable> &value) {
+    set_type(Type::label);
+    m_label_table = value;
+    return *this;
+  }
+
+  // sets the type of an empty column, ignored if the column has values
+  ChartJsDataColumn &set_type(Type value) {
+    if (is_empty() && m_capacity == 0) {
+      m_type = value;
+      reserve_pending();
+    }
+    return *this;
+  }
+
+  // makes the column a rolling window of the last capacity values: the
+  // storage is allocated here and once full, each append replaces the
+  // oldest value without allocating (a timestamp column is stored as
+  // integer64)
+  ChartJsDataColumn &set_capacity(size_t capacity, Type type);
+  size_t capacity() const { return m_capacity; }
+  bool is_rolling() const { return m_capacity > 0; }
+
+  // number of values ever appended (not reset by clear()), the value at
+  // offset was appended as number sequence() - count() + offset
+  u64 sequence() const { return m_sequence; }
+
+  Type type() const { return m_type; }
+  bool is_empty() const { return count() == 0; }
+  bool is_integer() const {
+    return m_type == Type::integer64 || m_type == Type::timestamp;
+  }
+  // a timestamp column where every value is first + offset * step
+  bool is_regular() const {
+    return m_type == Type::timestamp && m_delta_list.count() == 0;
+  }
+
+  size_t count() const {
+    switch (m_type) {
+    case Type::none:
+      return 0;
+    case Type::real32:
+      return m_real32.count();
+    case Type::real64:
+      return m_real64.count();
+    case Type::integer64:
+    case Type::label:
+      return m_integer64.count();
+    case Type::timestamp:
+      return m_timestamp_count;
+    }
+    return 0;
+  }
+
+  double at(size_t offset) const {
+    switch (m_type) {
+    case Type::none:
+      return 0.0;
+    case Type::real32:
+      return m_real32.at(get_position(offset));
+    case Type::real64:
+      return m_real64.at(get_position(offset));
+    case Type::integer64:
+    case Type::label:
+      return m_integer64.at(get_position(offset));
+    case Type::timestamp:
+      return timestamp_at(offset);
+    }
+    return 0.0;
+  }
+
+  s64 integer_at(size_t offset) const {
+    switch (m_type) {
+    case Type::integer64:
+    case Type::label:
+      return m_integer64.at(get_position(offset));
+    case Type::timestamp:
+      return timestamp_at(offset);
+    default:
+      return s64(at(offset));
+    }
+  }
+
+  s64 timestamp_at(size_t offset) const {
+    if (offset < m_regular_count) {
+      return m_first + s64(offset) * m_step;
+    }
+    return get_irregular_timestamp(offset);
+  }
+
+  // the label at offset of a label column
+  var::StringView label_at(size_t offset) const {
+    return m_label_table
+             ? m_label_table->at(u32(m_integer64.at(get_position(offset))))
+             : var::StringView();
+  }
+
+  // the first value and the difference of the second value from it
+  // (timestamp columns)
+  s64 first() const { return m_first; }
+  s64 step() const { return m_step; }
+
+  json::JsonValue to_value(size_t offset) const;
+  const ChartJsDataColumn &write(ChartJsWriter &writer, size_t offset) const;
+
+  // the range of the values in one pass over the storage (not valid for
+  // label columns)
+  ChartJsRange calculate_range() const;
+
+  // storage order, rotated by head() for a full rolling column
+  size_t head() const { return m_head; }
+  const var::Vector<float> &real32() const { return m_real32; }
+  const var::Vector<double> &real64() const { return m_real64; }
+  const var::Vector<s64> &integer64() const { return m_integer64; }
+  // bytes used by the packed timestamp differences
+  size_t timestamp_size() const {
+    return m_delta_list.count()
+           + m_checkpoint_list.count() * sizeof(TimestampCheckpoint);
+  }
+
+private:
+  // the value before an entry of m_delta_list and the entry position
+  struct TimestampCheckpoint {
+    s64 value;
+    size_t position;
+  };
+
+  Type m_type = Type::none;
+  var::Vector<float> m_real32;
+  var::Vector<double> m_real64;
+  // integer64 values or label ids
+  var::Vector<s64> m_integer64;
+  std::shared_ptr<ChartJsLabelTable> m_label_table;
+  size_t m_capacity = 0;
+  size_t m_head = 0;
+  u64 m_sequence = 0;
+  // reserved before the type was known
+  size_t m_reserve_count = 0;
+
+  // timestamp storage: the first m_regular_count values are
+  // m_first + offset * m_step, each later value is packed in m_delta_list
+  // as the zigzag varint of (value - previous value - m_step)
+  s64 m_first = 0;
+  s64 m_step = 0;
+  s64 m_last = 0;
+  size_t m_timestamp_count = 0;
+  size_t m_regular_count = 0;
+  var::Vector<u8> m_delta_list;
+  var::Vector<TimestampCheckpoint> m_checkpoint_list;
+  // the last value decoded so reading in order decodes each value once
+  // (a column is not read from more than one thread at a time)
+  mutable size_t m_cursor_offset = 0;
+  mutable s64 m_cursor_value = 0;
+  mutable size_t m_cursor_position = 0;
+
+  void push_timestamp(s64 value);
+  // ignored unless value is an id of label_table()
+  void push_label_id(s64 value);
+  bool is_label_id(s64 value) const {
+    return m_label_table && value >= 0
+           && u64(value) < m_label_table->count();
+  }
+  s64 get_irregular_timestamp(size_t offset) const;
+
+  void set_type_if_none(Type value) {
+    if (m_type == Type::none) {
+      m_type = value;
+      reserve_pending();
+    }
+  }
+
+  void reserve_pending() {
+    if (m_reserve_count && m_type != Type::none) {
+      const size_t count = m_reserve_count;
+      m_reserve_count = 0;
+      reserve(count);
+    }
+  }
+
+  size_t get_position(size_t offset) const {
+    if (m_head == 0) {
+      return offset;
+    }
+    const size_t position = m_head + offset;
+    return position < m_capacity ? position : position - m_capacity;
+  }
+
+  void reserve_for_append(size_t count);
+
+  template <typename T>
+  ChartJsDataColumn &
+  assign(var::Vector<T> &list, var::Vector<T> &&values, Type type) {
+    clear();
+    if (m_capacity) {
+      return append(values.data(), values.count());
+    }
+    m_type = type;
+    m_sequence += values.count();
+    list = std::move(values);
+    return *this;
+  }
+
+  template <typename T> void push(var::Vector<T> &list, T value) {
+    m_sequence++;
+    if (m_capacity) {
+      if (list.count() == m_capacity) {
+        list.at(m_head) = value;
+        m_head = m_head + 1 < m_capacity ? m_head + 1 : 0;
+        return;
+      }
+      // copies of the column do not keep the reserved storage
+      if (list.count() == 0) {
+        list.reserve(m_capacity);
+      }
+    }
+    list.push_back(value);
+  }
+};
+
+// Reduces the columnar points of a dataset to about sample_count() points
+// when the dataset is serialized. Buckets hold an equal number of samples
+// which matches the pixel columns of a regularly sampled series.
+// Algorithm::rdp instead keeps the points needed so that no point is
+// further than epsilon() from the simplified line, in any x order (such
+// as scatter data). It keeps points with a non-finite x or y as gaps and
+// simplifies the runs between them separately. The bucket algorithms keep
+// the first point of each non-finite run in a bucket as a gap and select
+// among the finite points.
+class ChartJsDecimation {
+public:
+  enum class Algorithm {
+    none,
+    // largest-triangle-three-buckets: keeps the visual shape
+    lttb,
+    // minimum and maximum of each bucket
+    min_max,
+    // first, last, minimum and maximum of each bucket (M4)
+    first_last_min_max,
+    // Ramer-Douglas-Peucker with a maximum error of epsilon()
+    rdp
+  };
+
+  using Callback = void (*)(void *context, size_t offset);
+
+  bool is_active(size_t point_count) const {
+    if (algorithm() == Algorithm::rdp) {
+      return epsilon() > 0.0 && point_count > 2;
+    }
+    return algorithm() != Algorithm::none && sample_count() > 0 &&
+           point_count > sample_count();
+  }
+
+  bool operator==(const ChartJsDecimation &a) const {
+    return algorithm() == a.algorithm() && sample_count() == a.sample_count()
+           && epsilon() == a.epsilon() && x_scale() == a.x_scale()
+           && y_scale() == a.y_scale();
+  }
+  bool operator!=(const ChartJsDecimation &a) const { return !(*this == a); }
+
+  // calls callback with the offset of each point to keep in ascending
+  // order (every offset is passed if the decimation is not active)
+  const ChartJsDecimation &select(const ChartJsDataColumn &x_column,
+                                  const ChartJsDataColumn &y_column,
+                                  size_t point_count, void *context,
+                                  Callback callback) const;
+
+private:
+  API_AF(ChartJsDecimation, Algorithm, algorithm, Algorithm::none);
+  API_AF(ChartJsDecimation, size_t, sample_count, 0);
+  // the rdp error in data units, or in pixels with x_scale() and
+  // y_scale() set to the pixels per unit of each axis
+  API_AF(ChartJsDecimation, double, epsilon, 0.0);
+  API_AF(ChartJsDecimation, double, x_scale, 1.0);
+  API_AF(ChartJsDecimation, double, y_scale, 1.0);
+
+  void select_lttb(const ChartJsDataColumn &x_column,
+                   const ChartJsDataColumn &y_column, size_t point_count,
+                   void *context, Callback callback) const;
+  void select_rdp(const ChartJsDataColumn &x_column,
+                  const ChartJsDataColumn &y_column, size_t point_count,
+                  void *context, Callback callback) const;
+  void select_bucket_extremes(const ChartJsDataColumn &y_column,
+                              size_t point_count, size_t bucket_count,
+                              bool is_first_last, void *context,
+                              Callback callback) const;
+};
+
+class ChartJsDataSet;
+
+// Derives a series from the y values of the columnar points of a
+// dataset, such as a moving average or a trend line over the raw points.
+// Set on a dataset with ChartJsDataSet::set_transform(), the derived
+// values replace y when the points are serialized; they are calculated a
+// block at a time as the points are written and are not stored (a
+// decimation selects from the source points). create_dataset() stores
+// them in a new dataset instead. x is the point x, or the offset of the
+// point if the dataset has no x values. Non-finite y values are skipped,
+// a derived value that is not defined (a rate at the first point or
+// across equal x) is written as null.
+class ChartJsTransform {
+public:
+  enum class Function {
+    none,
+    // mean of the finite values of the last window_size() points
+    moving_average,
+    // each finite value moves the average alpha() of the way to it
+    exponential_average,
+    // change of y per x_unit() of x since the previous point
+    rate,
+    // sum of the finite values up to the point
+    cumulative_sum,
+    // the least squares line through the points evaluated at each x
+    linear_fit
+  };
+
+  static ChartJsTransform create_moving_average(u32 window_size) {
+    return ChartJsTransform()
+      .set_function(Function::moving_average)
+      .set_window_size(window_size);
+  }
+
+  static ChartJsTransform create_exponential_average(double alpha) {
+    return ChartJsTransform()
+      .set_function(Function::exponential_average)
+      .set_alpha(alpha);
+  }
+
+  // x_unit of 1000 on a time axis (milliseconds) is the rate per second
+  static ChartJsTransform create_rate(double x_unit = 1.0) {
+    return ChartJsTransform().set_function(Function::rate).set_x_unit(x_unit);
+  }
+
+  static ChartJsTransform create_cumulative_sum() {
+    return ChartJsTransform().set_function(Function::cumulative_sum);
+  }
+
+  static ChartJsTransform create_linear_fit() {
+    return ChartJsTransform().set_function(Function::linear_fit);
+  }
+
+  bool is_active() const {
+    return function() != Function::none
+           && (function() != Function::moving_average || window_size() > 0);
+  }
+
+  bool operator==(const ChartJsTransform &a) const {
+    return function() == a.function() && window_size() == a.window_size()
+           && alpha() == a.alpha() && x_unit() == a.x_unit();
+  }
+  bool operator!=(const ChartJsTransform &a) const { return !(*this == a); }
+
+  // a dataset with the x values of source and the derived y values as
+  // real64 (the properties are not copied)
+  ChartJsDataSet create_dataset(const ChartJsDataSet &source) const;
+
+  // Calculates the derived values of the first point_count points a
+  // block at a time. The columns must not change while it is used.
+  class Evaluator {
+  public:
+    static constexpr size_t block_size = 64;
+
+    Evaluator(const ChartJsTransform &transform,
+              const ChartJsDataColumn &x_column,
+              const ChartJsDataColumn &y_column, size_t point_count);
+
+    // the derived value at offset, offsets passed to successive calls
+    // must not decrease
+    double at(size_t offset) {
+      while (offset >= m_offset + m_count && calculate_next()) {
+      }
+      return m_value_list[offset - m_offset];
+    }
+
+    // calculates the block after the current one, false after the last
+    bool calculate_next();
+
+    // the first offset and the values of the current block
+    size_t offset() const { return m_offset; }
+    size_t count() const { return m_count; }
+    const double *value_list() const { return m_value_list; }
+
+  private:
+    const ChartJsTransform &m_transform;
+    const ChartJsDataColumn &m_x_column;
+    const ChartJsDataColumn &m_y_column;
+    const size_t m_point_count;
+    size_t m_offset = 0;
+    size_t m_count = 0;
+    // the running sum or average and the number of values in it
+    double m_sum = 0.0;
+    size_t m_sum_count = 0;
+    double m_previous_x = NAN;
+    double m_previous_y = NAN;
+    // linear_fit is m_intercept + m_slope * (x - m_origin)
+    double m_origin = 0.0;
+    double m_slope = 0.0;
+    double m_intercept = NAN;
+    double m_value_list[block_size];
+
+    // x and y of count points from offset, the rest of the block is nan
+    void load(size_t offset, size_t count, double *x_list,
+              double *y_list) const;
+    void calculate_fit();
+  };
+
+private:
+  API_AF(ChartJsTransform, Function, function, Function::none);
+  API_AF(ChartJsTransform, u32, window_size, 0);
+  API_AF(ChartJsTransform, double, alpha, 0.0);
+  API_AF(ChartJsTransform, double, x_unit, 1.0);
+};
+
+// Points read from storage the caller owns (a ring buffer, a database
+// cursor, a sensor array) while a dataset is serialized, so they are not
+// copied into the dataset. The callback copies the points from offset
+// (at most block_size) to x_list and y_list (as Value::integer for an
+// integer64 or timestamp type, Value::real otherwise) and returns the
+// number copied, 0 after the last point. Within a serialization the
+// offsets do not decrease (a point may be read again), each serialization
+// starts from 0. The storage must not change during a serialization and
+// is read from a worker thread if the writer has a thread count (and by
+// several threads at once if copies of the dataset are written in
+// parallel).
+//
+//   dataset.set_point_source(ChartJsPointSource::create_y(samples));
+//
+// The points follow the columnar points and are written as JSON points
+// whatever the data encoding, they are not decimated or transformed.
+// x_type() and y_type() (deduced by the range sources) select how values
+// are written as for a column: real32 as the shortest float, integer64
+// as an integer and real64 as the shortest double.
+class ChartJsPointSource {
+public:
+  static constexpr size_t block_size = 64;
+
+  // a value read from a source: integer if the type of its axis is
+  // integer64 or timestamp (exact beyond 2^53), real otherwise
+  union Value {
+    double real;
+    s64 integer;
+  };
+
+  using Callback = size_t (*)(void *context, size_t offset, Value *x_list,
+                              Value *y_list);
+
+  // Where a read loop is in a source (the iterator of a range source).
+  // Each serialization reads with its own cursor, so copies of a dataset
+  // and writer threads can read the same source at once.
+  class Cursor {
+  public:
+    Cursor() = default;
+    Cursor(const Cursor &a) { copy(a); }
+    Cursor &operator=(const Cursor &a) {
+      if (this != &a) {
+        reset();
+        copy(a);
+      }
+      return *this;
+    }
+    ~Cursor() { reset(); }
+
+    // the next read starts again from the first point
+    void reset() {
+      if (m_operations != nullptr) {
+        m_operations->destroy(m_iterator);
+        m_operations = nullptr;
+      }
+      m_state = nullptr;
+      m_offset = 0;
+    }
+
+  private:
+    friend ChartJsPointSource;
+
+    struct Operations {
+      void (*copy)(void *destination, const void *source);
+      void (*destroy)(void *iterator);
+    };
+
+    // the range the iterator is in
+    const void *m_state = nullptr;
+    const Operations *m_operations = nullptr;
+    size_t m_offset = 0;
+    alignas(std::max_align_t) unsigned char m_iterator[4 * sizeof(void *)];
+
+    void copy(const Cursor &a) {
+      m_state = a.m_state;
+      m_operations = a.m_operations;
+      m_offset = a.m_offset;
+      if (m_operations != nullptr) {
+        m_operations->copy(m_iterator, a.m_iterator);
+      }
+    }
+  };
+
+  ChartJsPointSource() {}
+  // x_list is not read unless is_xy
+  ChartJsPointSource(void *context, Callback callback, bool is_xy)
+    : m_context(context), m_callback(callback), m_is_xy(is_xy) {}
+
+  ChartJsPointSource &set_x_type(ChartJsDataColumn::Type value) {
+    m_x_type = value;
+    return *this;
+  }
+  ChartJsPointSource &set_y_type(ChartJsDataColumn::Type value) {
+    m_y_type = value;
+    return *this;
+  }
+  ChartJsDataColumn::Type x_type() const { return m_x_type; }
+  ChartJsDataColumn::Type y_type() const { return m_y_type; }
+
+  // the elements of a forward range as y values (get_y(element) is the
+  // value), the range must outlive the datasets using the source
+  template <typename Range, typename GetY>
+  static ChartJsPointSource create_y(const Range &range, GetY get_y) {
+    return create<false>(range, get_y, get_y);
+  }
+  // a temporary range would not outlive the source
+  template <typename Range, typename GetY>
+  static ChartJsPointSource create_y(const Range &&range, GetY get_y) = delete;
+
+  // elements convertible to double (integers are written exactly)
+  template <typename Range>
+  static ChartJsPointSource create_y(const Range &range) {
+    using Element = typename std::decay<decltype(*std::begin(range))>::type;
+    return create_y(range, &get_element<Element>);
+  }
+  template <typename Range>
+  static ChartJsPointSource create_y(const Range &&range) = delete;
+
+  // the elements of a forward range as points
+  template <typename Range, typename GetX, typename GetY>
+  static ChartJsPointSource
+  create_xy(const Range &range, GetX get_x, GetY get_y) {
+    return create<true>(range, get_x, get_y);
+  }
+  template <typename Range, typename GetX, typename GetY>
+  static ChartJsPointSource
+  create_xy(const Range &&range, GetX get_x, GetY get_y) = delete;
+
+  bool is_valid() const {
+    return m_callback != nullptr || m_range_read != nullptr;
+  }
+  bool is_xy() const { return m_is_xy; }
+
+  // reads the block at offset, cursor is kept by the caller between the
+  // reads of a serialization
+  size_t
+  read(Cursor &cursor, size_t offset, Value *x_list, Value *y_list) const {
+    return m_range_read != nullptr
+             ? m_range_read(m_state.get(), cursor, offset, x_list, y_list)
+             : m_callback(m_context, offset, x_list, y_list);
+  }
+
+  // the points as elements of the current array
+  const ChartJsPointSource &write(ChartJsWriter &writer) const;
+  const ChartJsPointSource &
+  write_point(ChartJsWriter &writer, Value x, Value y) const;
+  const ChartJsPointSource &append(json::JsonArray &array) const;
+
+private:
+  using RangeRead = size_t (*)(const void *state, Cursor &cursor,
+                               size_t offset, Value *x_list, Value *y_list);
+
+  // reads a range with the iterator kept in the cursor so a forward range
+  // is traversed once per serialization, the state itself is not changed
+  template <typename Range, typename GetX, typename GetY, bool IsXy>
+  struct RangeState {
+    using Iterator = decltype(std::begin(std::declval<const Range &>()));
+    static_assert(sizeof(Iterator) <= sizeof(Cursor::m_iterator)
+                    && alignof(Iterator) <= alignof(std::max_align_t),
+                  "the range iterator does not fit in a cursor");
+
+    RangeState(const Range &range, GetX get_x, GetY get_y)
+      : range(range), get_x(get_x), get_y(get_y) {}
+
+    const Range &range;
+    GetX get_x;
+    GetY get_y;
+
+    static void copy_iterator(void *destination, const void *source) {
+      new (destination) Iterator(*reinterpret_cast<const Iterator *>(source));
+    }
+
+    static void destroy_iterator(void *iterator) {
+      reinterpret_cast<Iterator *>(iterator)->~Iterator();
+    }
+
+    static size_t read(const void *context, Cursor &cursor, size_t offset,
+                       Value *x_list, Value *y_list) {
+      static const typename Cursor::Operations operations
+        = {copy_iterator, destroy_iterator};
+      const RangeState *state = reinterpret_cast<const RangeState *>(context);
+      if (cursor.m_state != state || offset < cursor.m_offset) {
+        cursor.reset();
+        new (cursor.m_iterator) Iterator(std::begin(state->range));
+        cursor.m_operations = &operations;
+        cursor.m_state = state;
+      }
+      Iterator &iterator = *reinterpret_cast<Iterator *>(cursor.m_iterator);
+      const auto end = std::end(state->range);
+      while (cursor.m_offset < offset && iterator != end) {
+        ++iterator;
+        ++cursor.m_offset;
+      }
+      // the cursor stays on offset, it can be read again
+      Iterator position = iterator;
+      size_t result = 0;
+      while (result < block_size && position != end) {
+        if (IsXy) {
+          set_value(x_list[result], state->get_x(*position));
+        }
+        set_value(y_list[result], state->get_y(*position));
+        ++position;
+        ++result;
+      }
+      return result;
+    }
+  };
+
+  void *m_context = nullptr;
+  Callback m_callback = nullptr;
+  bool m_is_xy = false;
+  ChartJsDataColumn::Type m_x_type = ChartJsDataColumn::Type::real64;
+  ChartJsDataColumn::Type m_y_type = ChartJsDataColumn::Type::real64;
+  // a range source, the state is shared by copies and only read
+  RangeRead m_range_read = nullptr;
+  std::shared_ptr<const void> m_state;
+
+  template <bool IsXy, typename Range, typename GetX, typename GetY>
+  static ChartJsPointSource
+  create(const Range &range, GetX get_x, GetY get_y) {
+    using State = RangeState<Range, GetX, GetY, IsXy>;
+    using Element = decltype(*std::begin(range));
+    ChartJsPointSource result;
+    result.m_is_xy = IsXy;
+    result.m_x_type = get_type<decltype(get_x(std::declval<Element>()))>();
+    result.m_y_type = get_type<decltype(get_y(std::declval<Element>()))>();
+    result.m_range_read = &State::read;
+    result.m_state = std::make_shared<const State>(range, get_x, get_y);
+    return result;
+  }
+
+  template <typename T> static ChartJsDataColumn::Type get_type() {
+    using Value = typename std::decay<T>::type;
+    if (std::is_integral<Value>::value) {
+      return ChartJsDataColumn::Type::integer64;
+    }
+    return std::is_same<Value, float>::value
+             ? ChartJsDataColumn::Type::real32
+             : ChartJsDataColumn::Type::real64;
+  }
+
+  template <typename T> static void set_value(Value &value, const T &element) {
+    set_value(value, element, std::is_integral<T>());
+  }
+  template <typename T>
+  static void set_value(Value &value, const T &element, std::true_type) {
+    value.integer = s64(element);
+  }
+  template <typename T>
+  static void set_value(Value &value, const T &element, std::false_type) {
+    value.real = double(element);
+  }
+
+  static bool is_integer(ChartJsDataColumn::Type type) {
+    return type == ChartJsDataColumn::Type::integer64
+           || type == ChartJsDataColumn::Type::timestamp;
+  }
+  static void
+  write_value(ChartJsWriter &writer, ChartJsDataColumn::Type type, Value value);
+  static json::JsonValue to_value(ChartJsDataColumn::Type type, Value value);
+
+  template <typename T> static T get_element(const T &value) { return value; }
+};
+
+// accessors for ChartJsDataSet properties, any change (or non-const
+// access) invalidates the cached serialized properties
+#define CHARTJS_PROPERTY_AF(c, t, v, iv)                                       \
+public:                                                                        \
+  t v() const { return m_##v; }                                                \
+  c &set_##v(t value) {                                                        \
+    m_##v = value;                                                             \
+    invalidate_properties();                                                   \
+    return *this;                                                              \
+  }                                                                            \
+                                                                               \
+private:                                                                       \
+  t m_##v = iv
+
+#define CHARTJS_PROPERTY_AB(c, v, iv)                                          \
+public:                                                                        \
+  bool is_##v() const { return m_is_##v; }                                     \
+  c &set_##v(bool value = true) {                                              \
+    m_is_##v = value;                                                          \
+    invalidate_properties();                                                   \
+    return *this;                                                              \
+  }                                                                            \
+                                                                               \
+private:                                                                       \
+  bool m_is_##v = iv
+
+#define CHARTJS_PROPERTY_AC(c, t, v)                                           \
+public:                                                                        \
+  const t &v() const { return m_##v; }                                         \
+  t &v() {                                                                     \
+    invalidate_properties();                                                   \
+    return m_##v;                                                              \
+  }                                                                            \
+  c &set_##v(const t &value) {                                                 \
+    m_##v = value;                                                             \
+    invalidate_properties();                                                   \
+    return *this;                                                              \
+  }                                                                            \
+  c &set_##v(t &&value) {                                                      \
+    m_##v = std::move(value);                                                  \
+    invalidate_properties();                                                   \
+    return *this;                                                              \
+  }                                                                            \
+                                                                               \
+private:                                                                       \
+  t m_##v
+
+#define CHARTJS_PROPERTY_AS(c, v)                                              \
+public:                                                                        \
+  var::StringView v() const { return m_##v.string_view(); }                   \
+  c &set_##v(const var::StringView value) {                                    \
+    m_##v = var::String(value);                                                \
+    invalidate_properties();                                                   \
+    return *this;                                                              \
+  }                                                                            \
+                                                                               \
+private:                                                                       \
+  var::String m_##v
+
 class ChartJsDataSet {
 public:
   ChartJsDataSet() {}
@@ -213,61 +1131,370 @@ public:
 
   enum class BorderCapStyle { butt, round, square };
 
-  ChartJsDataSet &append(const json::JsonValue &value) {
-    data().push_back(value);
+  // how the columnar points are serialized, points in data() are always
+  // in the data array
+  enum class DataEncoding {
+    // in the data array
+    json,
+    // in "encodedData" as base64 little-endian typed arrays
+    base64,
+    // in "encodedData" as offsets into the writer's sidecar (base64 if the
+    // writer has no sidecar)
+    sidecar
+  };
+
+  // the value is copied to the heap if a ChartJsArena::Scope is active
+  ChartJsDataSet &append(const json::JsonValue &value);
+
+  // Columnar points are stored as contiguous x/y arrays and only
+  // converted to JSON when serialized. A dataset with only a y column
+  // serializes as plain values (like appending JsonReal), a dataset with
+  // both x and y serializes as {"x":..,"y":..} objects (like appending
+  // ChartJsRealDataPoint::to_object()). Columnar points follow any
+  // values in data().
+  ChartJsDataSet &append_point(float y) {
+    m_y_column.append(y);
     return *this;
   }
 
-  json::JsonObject to_object() const;
+  ChartJsDataSet &append_point(double y) {
+    m_y_column.append(y);
+    return *this;
+  }
 
-  var::Vector<json::JsonValue> &data() { return m_data; }
+  ChartJsDataSet &append_point(s64 y) {
+    m_y_column.append(y);
+    return *this;
+  }
+
+  ChartJsDataSet &append_point(float x, float y) {
+    return append_column_point(x, y);
+  }
+
+  ChartJsDataSet &append_point(double x, double y) {
+    return append_column_point(x, y);
+  }
+
+  ChartJsDataSet &append_point(s64 x, s64 y) {
+    return append_column_point(x, y);
+  }
+
+  // label points (like ChartJsStringDataPoint) are stored as the ids of
+  // the column label tables, see ChartJsDataColumn::set_label_table()
+  // (a point with a value its column ignores is dropped, x and y stay
+  // aligned)
+  ChartJsDataSet &append_point(var::StringView x, var::StringView y) {
+    return append_column_point(x, y);
+  }
+
+  ChartJsDataSet &append_point(var::StringView x, double y) {
+    return append_column_point(x, y);
+  }
+
+  ChartJsDataSet &append_points(const float *y_values, size_t count) {
+    m_y_column.append(y_values, count);
+    return *this;
+  }
+
+  ChartJsDataSet &append_points(const double *y_values, size_t count) {
+    m_y_column.append(y_values, count);
+    return *this;
+  }
+
+  ChartJsDataSet &append_points(const s64 *y_values, size_t count) {
+    m_y_column.append(y_values, count);
+    return *this;
+  }
+
+  ChartJsDataSet &append_points(const float *x_values, const float *y_values,
+                                size_t count) {
+    if (is_label_point()) {
+      for (size_t i = 0; i < count; i++) {
+        append_column_point(x_values[i], y_values[i]);
+      }
+      return *this;
+    }
+    m_x_column.append(x_values, count);
+    m_y_column.append(y_values, count);
+    return *this;
+  }
+
+  ChartJsDataSet &append_points(const double *x_values,
+                                const double *y_values, size_t count) {
+    if (is_label_point()) {
+      for (size_t i = 0; i < count; i++) {
+        append_column_point(x_values[i], y_values[i]);
+      }
+      return *this;
+    }
+    m_x_column.append(x_values, count);
+    m_y_column.append(y_values, count);
+    return *this;
+  }
+
+  ChartJsDataSet &append_points(const s64 *x_values, const s64 *y_values,
+                                size_t count) {
+    if (is_label_point()) {
+      for (size_t i = 0; i < count; i++) {
+        append_column_point(x_values[i], y_values[i]);
+      }
+      return *this;
+    }
+    m_x_column.append(x_values, count);
+    m_y_column.append(y_values, count);
+    return *this;
+  }
+
+  // a dataset that keeps the last capacity points, appending to a full
+  // dataset drops the oldest point without allocating
+  static ChartJsDataSet
+  create_rolling(size_t capacity,
+                 ChartJsDataColumn::Type y_type = ChartJsDataColumn::Type::real32,
+                 ChartJsDataColumn::Type x_type = ChartJsDataColumn::Type::none) {
+    ChartJsDataSet result;
+    result.y_column().set_capacity(capacity, y_type);
+    if (x_type != ChartJsDataColumn::Type::none) {
+      result.x_column().set_capacity(capacity, x_type);
+    }
+    return result;
+  }
+
+  // takes the storage of the vectors, the points are not copied
+  template <typename T>
+  ChartJsDataSet &assign_points(var::Vector<T> &&y_values) {
+    m_x_column.clear();
+    m_y_column.assign(std::move(y_values));
+    return *this;
+  }
+
+  template <typename T>
+  ChartJsDataSet &assign_points(var::Vector<T> &&x_values,
+                                var::Vector<T> &&y_values) {
+    m_x_column.assign(std::move(x_values));
+    m_y_column.assign(std::move(y_values));
+    return *this;
+  }
+
+  ChartJsDataSet &reserve_points(size_t count) {
+    m_x_column.reserve(count);
+    m_y_column.reserve(count);
+    return *this;
+  }
+
+  // number of columnar points (values in data() are not counted)
+  size_t point_count() const {
+    if (x_column().is_empty()) {
+      return y_column().count();
+    }
+    return x_column().count() < y_column().count() ? x_column().count()
+                                                   : y_column().count();
+  }
+
+  bool is_point_xy() const { return !x_column().is_empty(); }
+
+  json::JsonValue point_to_value(size_t offset) const;
+  const ChartJsDataSet &write_point(ChartJsWriter &writer,
+                                    size_t offset) const;
+
+  json::JsonObject to_object() const;
+  const ChartJsDataSet &write(ChartJsWriter &writer) const;
+
+  // the dataset properties without the data
+  json::JsonObject properties_to_object() const;
+  // hash of the serialized properties, changes when a property changes
+  u32 calculate_properties_hash() const;
+
+  // The non-const accessors count a modification because the caller can
+  // change any value through them (the append methods are tracked by the
+  // column sequence instead).
+  var::Vector<json::JsonValue> &data() {
+    m_modification_count++;
+    return m_data;
+  }
   const var::Vector<json::JsonValue> &data() const { return m_data; }
 
+  ChartJsDataColumn &x_column() {
+    m_modification_count++;
+    return m_x_column;
+  }
+  const ChartJsDataColumn &x_column() const { return m_x_column; }
+  ChartJsDataColumn &y_column() {
+    m_modification_count++;
+    return m_y_column;
+  }
+  const ChartJsDataColumn &y_column() const { return m_y_column; }
+
+  // number of times data(), x_column() or y_column() was returned for
+  // editing
+  u32 modification_count() const { return m_modification_count; }
+
+  // unique to each constructed dataset and kept by copies, so a dataset
+  // assigned over another one in the list can be told apart
+  u32 identity() const { return m_identity; }
+
 private:
-  API_AC(ChartJsDataSet, ChartJsColor, background_color);
-  API_AF(ChartJsDataSet, BorderCapStyle, border_cap_style,
-         BorderCapStyle::butt);
-  API_AC(ChartJsDataSet, ChartJsColor, border_color);
-  API_AC(ChartJsDataSet, var::Vector<s32>, border_dash_list);
-  API_AF(ChartJsDataSet, float, border_dash_offset, 0.0f);
-  API_AF(ChartJsDataSet, BorderJoinStyle, border_join_style,
-         BorderJoinStyle::miter);
-  API_AF(ChartJsDataSet, float, border_width, 3.0f);
-  API_AF(ChartJsDataSet, CubicInterpolationMode, cubic_interpolation_mode,
-         CubicInterpolationMode::default_);
-  API_AB(ChartJsDataSet, fill, true);
+  friend class ChartJsChunkWriter;
+  friend class ChartJsDashboard;
+
+  CHARTJS_PROPERTY_AC(ChartJsDataSet, ChartJsColor, background_color);
+  CHARTJS_PROPERTY_AF(ChartJsDataSet, BorderCapStyle, border_cap_style,
+                      BorderCapStyle::butt);
+  CHARTJS_PROPERTY_AC(ChartJsDataSet, ChartJsColor, border_color);
+  CHARTJS_PROPERTY_AC(ChartJsDataSet, var::Vector<s32>, border_dash_list);
+  CHARTJS_PROPERTY_AF(ChartJsDataSet, float, border_dash_offset, 0.0f);
+  CHARTJS_PROPERTY_AF(ChartJsDataSet, BorderJoinStyle, border_join_style,
+                      BorderJoinStyle::miter);
+  CHARTJS_PROPERTY_AF(ChartJsDataSet, float, border_width, 3.0f);
+  CHARTJS_PROPERTY_AF(ChartJsDataSet, CubicInterpolationMode,
+                      cubic_interpolation_mode,
+                      CubicInterpolationMode::default_);
+  CHARTJS_PROPERTY_AB(ChartJsDataSet, fill, true);
   // clip
-  API_AC(ChartJsDataSet, ChartJsColor, hover_background_color);
-  API_AF(ChartJsDataSet, BorderCapStyle, hover_border_cap_style,
-         BorderCapStyle::butt);
-  API_AC(ChartJsDataSet, ChartJsColor, hover_border_color);
-  API_AC(ChartJsDataSet, var::Vector<s32>, hover_border_dash_list);
-  API_AF(ChartJsDataSet, float, hover_border_dash_offset, 0.0f);
-  API_AF(ChartJsDataSet, BorderJoinStyle, hover_border_join_style,
-         BorderJoinStyle::undefined);
-  API_AF(ChartJsDataSet, float, hover_border_width, HUGE_VALF);
-  API_AS(ChartJsDataSet, label);
-  API_AF(ChartJsDataSet, float, line_tension, 0.4f);
-  API_AF(ChartJsDataSet, int, order, 0);
-  API_AC(ChartJsDataSet, ChartJsColor, point_background_color);
-  API_AC(ChartJsDataSet, ChartJsColor, point_border_color);
-  API_AF(ChartJsDataSet, float, point_border_width, 1.0f);
-  API_AF(ChartJsDataSet, float, point_hit_radius, 1.0f);
-  API_AC(ChartJsDataSet, ChartJsColor, point_hover_background_color);
-  API_AC(ChartJsDataSet, ChartJsColor, point_hover_border_color);
-  API_AF(ChartJsDataSet, float, point_hover_border_width, 1.0f);
-  API_AF(ChartJsDataSet, float, point_hover_radius, 4.0f);
-  API_AF(ChartJsDataSet, float, point_radius, 3.0f);
-  API_AF(ChartJsDataSet, float, point_rotation, 0.0f);
-  API_AF(ChartJsDataSet, PointStyle, point_style, PointStyle::circle);
-  API_AB(ChartJsDataSet, show_line, true);
-  API_AB(ChartJsDataSet, span_gaps, true);
-  API_AF(ChartJsDataSet, SteppedLine, stepped_line, SteppedLine::no);
-  API_AS(ChartJsDataSet, x_axis_id);
-  API_AS(ChartJsDataSet, y_axis_id);
+  CHARTJS_PROPERTY_AC(ChartJsDataSet, ChartJsColor, hover_background_color);
+  CHARTJS_PROPERTY_AF(ChartJsDataSet, BorderCapStyle, hover_border_cap_style,
+                      BorderCapStyle::butt);
+  CHARTJS_PROPERTY_AC(ChartJsDataSet, ChartJsColor, hover_border_color);
+  CHARTJS_PROPERTY_AC(ChartJsDataSet, var::Vector<s32>, hover_border_dash_list);
+  CHARTJS_PROPERTY_AF(ChartJsDataSet, float, hover_border_dash_offset, 0.0f);
+  CHARTJS_PROPERTY_AF(ChartJsDataSet, BorderJoinStyle, hover_border_join_style,
+                      BorderJoinStyle::undefined);
+  CHARTJS_PROPERTY_AF(ChartJsDataSet, float, hover_border_width, HUGE_VALF);
+  CHARTJS_PROPERTY_AS(ChartJsDataSet, label);
+  CHARTJS_PROPERTY_AF(ChartJsDataSet, float, line_tension, 0.4f);
+  CHARTJS_PROPERTY_AF(ChartJsDataSet, int, order, 0);
+  CHARTJS_PROPERTY_AC(ChartJsDataSet, ChartJsColor, point_background_color);
+  CHARTJS_PROPERTY_AC(ChartJsDataSet, ChartJsColor, point_border_color);
+  CHARTJS_PROPERTY_AF(ChartJsDataSet, float, point_border_width, 1.0f);
+  CHARTJS_PROPERTY_AF(ChartJsDataSet, float, point_hit_radius, 1.0f);
+  CHARTJS_PROPERTY_AC(ChartJsDataSet, ChartJsColor,
+                      point_hover_background_color);
+  CHARTJS_PROPERTY_AC(ChartJsDataSet, ChartJsColor, point_hover_border_color);
+  CHARTJS_PROPERTY_AF(ChartJsDataSet, float, point_hover_border_width, 1.0f);
+  CHARTJS_PROPERTY_AF(ChartJsDataSet, float, point_hover_radius, 4.0f);
+  CHARTJS_PROPERTY_AF(ChartJsDataSet, float, point_radius, 3.0f);
+  CHARTJS_PROPERTY_AF(ChartJsDataSet, float, point_rotation, 0.0f);
+  CHARTJS_PROPERTY_AF(ChartJsDataSet, PointStyle, point_style,
+                      PointStyle::circle);
+  CHARTJS_PROPERTY_AB(ChartJsDataSet, show_line, true);
+  CHARTJS_PROPERTY_AB(ChartJsDataSet, span_gaps, true);
+  CHARTJS_PROPERTY_AF(ChartJsDataSet, SteppedLine, stepped_line,
+                      SteppedLine::no);
+  CHARTJS_PROPERTY_AS(ChartJsDataSet, x_axis_id);
+  CHARTJS_PROPERTY_AS(ChartJsDataSet, y_axis_id);
+
+  API_AC(ChartJsDataSet, ChartJsDecimation, decimation);
+  // replaces the y values of the points when they are serialized
+  API_AC(ChartJsDataSet, ChartJsTransform, transform);
+  // points written after the columnar points
+  API_AC(ChartJsDataSet, ChartJsPointSource, point_source);
+  // applies to the properties and points when written with ChartJsWriter
+  API_AC(ChartJsDataSet, ChartJsRealFormat, real_format);
+  API_AF(ChartJsDataSet, DataEncoding, data_encoding, DataEncoding::json);
 
   Type m_type = Type::string;
   var::Vector<json::JsonValue> m_data;
+  u32 m_modification_count = 0;
+  u32 m_identity = create_identity();
+  ChartJsDataColumn m_x_column;
+  ChartJsDataColumn m_y_column;
+
+  // the serialized properties are cached until a property changes
+  // moves without throwing so datasets are moved rather than copied
+  // (with their points) when a dataset list grows
+  class PropertiesObject {
+  public:
+    PropertiesObject() = default;
+    PropertiesObject(const PropertiesObject &) = default;
+    PropertiesObject &operator=(const PropertiesObject &) = default;
+    PropertiesObject(PropertiesObject &&a) noexcept {
+      std::swap(value, a.value);
+    }
+    PropertiesObject &operator=(PropertiesObject &&a) noexcept {
+      std::swap(value, a.value);
+      return *this;
+    }
+
+    json::JsonObject value;
+  };
+
+  mutable PropertiesObject m_properties_object;
+  mutable var::String m_properties_fragment;
+  mutable u32 m_properties_hash = 0;
+  mutable ChartJsRealFormat m_properties_real_format;
+  mutable bool m_is_properties_object_valid = false;
+  mutable bool m_is_properties_fragment_valid = false;
+
+  void invalidate_properties() {
+    m_is_properties_object_valid = false;
+    m_is_properties_fragment_valid = false;
+  }
+
+  static u32 create_identity();
+
+  template <typename X, typename Y>
+  ChartJsDataSet &append_column_point(X x, Y y) {
+    if (m_x_column.is_appendable(x) && m_y_column.is_appendable(y)) {
+      m_x_column.append(x);
+      m_y_column.append(y);
+    }
+    return *this;
+  }
+
+  // label columns ignore values that are not ids so the points are
+  // appended one at a time
+  bool is_label_point() const {
+    return m_x_column.type() == ChartJsDataColumn::Type::label
+           || m_y_column.type() == ChartJsDataColumn::Type::label;
+  }
+
+  const json::JsonObject &get_properties_object() const;
+  void copy_properties_object(json::JsonObject &result) const;
+  const var::String &
+  get_properties_fragment(const ChartJsRealFormat &format) const;
+
+  template <class Output> void insert_properties(Output &output) const;
+
+  // the value of "data" (the json values followed by the points unless
+  // the points are encoded)
+  json::JsonArray data_to_array() const;
+  const ChartJsDataSet &write_data(ChartJsWriter &writer) const;
+
+  // a point with y from the transform
+  json::JsonValue point_to_value(size_t offset, double y) const;
+  const ChartJsDataSet &
+  write_point(ChartJsWriter &writer, size_t offset, double y) const;
+
+  // implemented in ChartJsEncoding.cpp
+  json::JsonObject encoded_data_to_object() const;
+  const ChartJsDataSet &write_encoded_data(ChartJsWriter &writer) const;
+
+  // where ChartJsChunkWriter is in the base64 of an encoded column so the
+  // values written to earlier buffers are not encoded again
+  struct EncodedColumnCursor {
+    u8 array_type = 0;
+    // the bytes of the last value that don't fill a base64 group
+    u8 pending_size = 0;
+    u8 pending[2] = {};
+    // the last value of an Int32Delta column
+    s64 previous = 0;
+    // the number of values written
+    size_t count = 0;
+  };
+
+  // writes the column object up to the base64 values and resets cursor,
+  // false if the column is written whole (as a timestamp step)
+  bool write_encoded_column_head(ChartJsWriter &writer,
+                                 const ChartJsDataColumn &column,
+                                 EncodedColumnCursor &cursor) const;
+  // writes the whole base64 groups of the value at offset (evaluator has
+  // the derived values of a transformed dataset)
+  void write_encoded_value(ChartJsWriter &writer,
+                           const ChartJsDataColumn &column, size_t offset,
+                           ChartJsTransform::Evaluator *evaluator,
+                           EncodedColumnCursor &cursor) const;
+  // writes the pending bytes of the column, the caller closes the string
+  void write_encoded_column_tail(ChartJsWriter &writer,
+                                 const EncodedColumnCursor &cursor) const;
 
   static var::StringView get_point_style_string(PointStyle value);
   static var::StringView
@@ -277,6 +1504,11 @@ private:
   static var::StringView get_border_cap_style_string(BorderCapStyle value);
 };
 
+#undef CHARTJS_PROPERTY_AF
+#undef CHARTJS_PROPERTY_AB
+#undef CHARTJS_PROPERTY_AC
+#undef CHARTJS_PROPERTY_AS
+
 class ChartJsData {
 public:
   ChartJsData() {}
@@ -286,9 +1518,84 @@ public:
     return *this;
   }
 
+  ChartJsData &append(ChartJsDataSet &&data_set) {
+    m_dataset_list.push_back(std::move(data_set));
+    return *this;
+  }
+
+  // appends an empty dataset to fill in place (the reference is valid
+  // until the next dataset is appended)
+  ChartJsDataSet &emplace_dataset() {
+    m_dataset_list.push_back(ChartJsDataSet());
+    return m_dataset_list.back();
+  }
+
+  // keeps the last capacity labels so labels roll forward in lockstep
+  // with datasets created using ChartJsDataSet::create_rolling()
+  ChartJsData &set_label_capacity(size_t capacity) {
+    reset_label_head();
+    m_label_capacity = capacity;
+    if (m_label_table) {
+      m_label_id_list.reserve(capacity);
+    } else {
+      m_label_list.reserve(capacity);
+    }
+    return *this;
+  }
+
+  size_t label_capacity() const { return m_label_capacity; }
+  // number of labels ever passed to append_label()
+  u64 label_sequence() const { return m_label_sequence; }
+
+  // Stores the labels as ids of table (the labels so far are interned),
+  // label_list() is empty and label_id_list() has the ids. Charts with
+  // the same categories can share a table. nullptr stores the labels as
+  // strings again.
+  ChartJsData &set_label_table(const std::shared_ptr<ChartJsLabelTable> &table);
+  const std::shared_ptr<ChartJsLabelTable> &label_table() const {
+    return m_label_table;
+  }
+
+  ChartJsData &append_label(var::StringView label) {
+    m_label_sequence++;
+    if (m_label_table) {
+      push_label(m_label_id_list, m_label_table->intern(label));
+    } else {
+      push_label(m_label_list, label);
+    }
+    return *this;
+  }
+
+  size_t label_count() const {
+    return m_label_table ? m_label_id_list.count() : m_label_list.count();
+  }
+
+  // labels in order (label_list() is in storage order)
+  var::StringView label_at(size_t offset) const {
+    if (m_label_table) {
+      return m_label_table->at(label_id_at(offset));
+    }
+    return m_label_list.at(get_label_position(offset)).string_view();
+  }
+
+  u32 label_id_at(size_t offset) const {
+    return m_label_id_list.at(get_label_position(offset));
+  }
+
+  json::JsonArray labels_to_array() const {
+    if (m_label_head == 0 && !m_label_table) {
+      return json::JsonArray(m_label_list);
+    }
+    json::JsonArray result;
+    for (size_t i = 0; i < label_count(); i++) {
+      result.append(json::JsonString(label_at(i)));
+    }
+    return result;
+  }
+
   json::JsonObject to_object() const {
     json::JsonObject result;
-    result.insert("labels", json::JsonArray(m_label_list));
+    result.insert("labels", labels_to_array());
     json::JsonArray dataset_array;
     for (const auto &dataset : m_dataset_list) {
       dataset_array.append(dataset.to_object());
@@ -297,12 +1604,83 @@ public:
     return result;
   }
 
-  var::StringList &label_list() { return m_label_list; }
+  // with ChartJsWriter::thread_count() > 1, the datasets are serialized
+  // in parallel and written in order, the output is the same (datasets
+  // with json values in data() are serialized on the calling thread)
+  const ChartJsData &write(ChartJsWriter &writer) const;
+
+  // the labels are put in order so they can be edited directly, a rolling
+  // list must stay within label_capacity()
+  var::StringList &label_list() {
+    reset_label_head();
+    m_modification_count++;
+    return m_label_list;
+  }
   const var::StringList &label_list() const { return m_label_list; }
+  const var::Vector<u32> &label_id_list() const { return m_label_id_list; }
+  // number of times label_list() was returned for editing
+  u32 modification_count() const { return m_modification_count; }
+
+  var::Vector<ChartJsDataSet> &dataset_list() { return m_dataset_list; }
+  const var::Vector<ChartJsDataSet> &dataset_list() const {
+    return m_dataset_list;
+  }
 
 private:
   var::StringList m_label_list;
+  std::shared_ptr<ChartJsLabelTable> m_label_table;
+  var::Vector<u32> m_label_id_list;
   var::Vector<ChartJsDataSet> m_dataset_list;
+  size_t m_label_capacity = 0;
+  size_t m_label_head = 0;
+  u64 m_label_sequence = 0;
+  u32 m_modification_count = 0;
+
+  size_t get_label_position(size_t offset) const {
+    const size_t position = m_label_head + offset;
+    return position < label_count() ? position : position - label_count();
+  }
+
+  void push_label(var::Vector<u32> &list, u32 value) {
+    if (m_label_capacity && list.count() == m_label_capacity) {
+      list.at(m_label_head) = value;
+      advance_label_head();
+      return;
+    }
+    list.push_back(value);
+  }
+
+  void push_label(var::StringList &list, var::StringView value) {
+    if (m_label_capacity && list.count() == m_label_capacity) {
+      // the oldest label keeps its storage so rolling does not allocate
+      list.at(m_label_head).clear().append(value);
+      advance_label_head();
+      return;
+    }
+    list.push_back(var::String(value));
+  }
+
+  void advance_label_head() {
+    m_label_head = m_label_head + 1 < m_label_capacity ? m_label_head + 1 : 0;
+  }
+
+  // rotates the storage so the oldest label is first
+  void reset_label_head() {
+    if (m_label_head == 0) {
+      return;
+    }
+    if (m_label_table) {
+      std::rotate(m_label_id_list.begin(),
+                  m_label_id_list.begin() + m_label_head,
+                  m_label_id_list.end());
+    } else {
+      std::rotate(m_label_list.begin(), m_label_list.begin() + m_label_head,
+                  m_label_list.end());
+    }
+    m_label_head = 0;
+  }
+
+  void write_datasets_parallel(ChartJsWriter &writer) const;
 };
 
 class ChartJsAxisTicks {
@@ -314,16 +1692,26 @@ public:
       return json::JsonObject()
           .insert("stepSize", json::JsonReal(step_size()))
           .insert("min", json::JsonReal(minimum()))
-          .insert("max", json::JsonInteger(maximum()));
+          .insert("max", json::JsonReal(maximum()));
     }
 
     return json::JsonObject();
   }
 
+  // a step of 1, 2 or 5 times a power of 10 giving about tick_count
+  // steps, with minimum and maximum rounded out to a multiple of the step
+  static ChartJsAxisTicks
+  create_linear(double minimum, double maximum, size_t tick_count = 10);
+
+  // the powers of 10 around minimum and maximum (greater than 0), the
+  // step is not used by logarithmic axes
+  static ChartJsAxisTicks create_logarithmic(double minimum, double maximum);
+
 private:
-  API_AF(ChartJsAxisTicks, float, minimum, 0);
-  API_AF(ChartJsAxisTicks, float, maximum, 0);
-  API_AF(ChartJsAxisTicks, float, step_size, 0);
+  // doubles so bounds such as millisecond timestamps are exact
+  API_AF(ChartJsAxisTicks, double, minimum, 0.0);
+  API_AF(ChartJsAxisTicks, double, maximum, 0.0);
+  API_AF(ChartJsAxisTicks, double, step_size, 0.0);
 };
 
 class ChartJsScaleLabel {
@@ -374,6 +1762,11 @@ private:
   API_AS(ChartJsAxis, id);
   API_AB(ChartJsAxis, stacked, false);
   API_AC(ChartJsAxis, Type, type);
+  // the ticks of a linear or logarithmic axis are set by
+  // ChartJsScales::calculate_ranges()
+  API_AB(ChartJsAxis, auto_range, false);
+  // the number of steps an auto range linear axis is divided into (about)
+  API_AF(ChartJsAxis, u16, tick_count, 10);
 
   static var::StringView type_to_string(Type value) {
     switch (value) {
@@ -397,11 +1790,37 @@ public:
     return *this;
   }
 
+  ChartJsScales &append_x_axis(ChartJsAxis &&axis) {
+    x_axes().push_back(std::move(axis));
+    return *this;
+  }
+
   ChartJsScales &append_y_axis(const ChartJsAxis &axis) {
     y_axes().push_back(axis);
     return *this;
   }
 
+  ChartJsScales &append_y_axis(ChartJsAxis &&axis) {
+    y_axes().push_back(std::move(axis));
+    return *this;
+  }
+
+  ChartJsScales &set_x_axes(var::Vector<ChartJsAxis> &&value) {
+    m_x_axes = std::move(value);
+    return *this;
+  }
+
+  ChartJsScales &set_y_axes(var::Vector<ChartJsAxis> &&value) {
+    m_y_axes = std::move(value);
+    return *this;
+  }
+
+  // sets the ticks of every auto range axis to cover the points of the
+  // datasets bound to it (by x_axis_id() and y_axis_id(), a dataset
+  // without an id is bound to the first axis); each column is scanned
+  // once, the values of a stacked axis are not summed
+  ChartJsScales &calculate_ranges(const ChartJsData &data);
+
   json::JsonObject to_object() const {
     json::JsonObject result;
 
@@ -420,6 +1839,13 @@ private:
   API_AC(ChartJsScales, var::Vector<ChartJsAxis>, x_axes);
   API_AC(ChartJsScales, var::Vector<ChartJsAxis>, y_axes);
 
+  static constexpr size_t no_axis = static_cast<size_t>(-1);
+
+  static size_t get_axis_index(const var::Vector<ChartJsAxis> &axes,
+                               var::StringView id);
+  static void update_ticks(var::Vector<ChartJsAxis> &axes,
+                           const var::Vector<ChartJsRange> &range_list);
+
   json::JsonArray axes_to_array(const var::Vector<ChartJsAxis> &axes) const {
     json::JsonArray result;
     for (const auto &axis : axes) {
@@ -467,33 +1893,85 @@ private:
   API_AF(ChartJsLegend, Align, align, Align::center);
 };
 
+class ChartJsOptions;
+
+// Frozen options shared by many charts. Each top level option is
+// serialized once when the template is created, copies share the same
+// state and charts reference it with ChartJsOptions::set_template(). The
+// template is not changed after construction so it can be written from
+// several threads.
+class ChartJsOptionsTemplate {
+public:
+  ChartJsOptionsTemplate() {}
+  // the options are serialized with format (writers with another format
+  // write the options from the tree)
+  explicit ChartJsOptionsTemplate(
+    const ChartJsOptions &options,
+    const ChartJsRealFormat &format
+    = ChartJsRealFormat().set_style(ChartJsRealFormat::Style::shortest));
+
+  bool is_valid() const { return m_shared != nullptr; }
+  size_t count() const { return is_valid() ? m_shared->entry_list.count() : 0; }
+
+private:
+  friend ChartJsOptions;
+
+  struct Entry {
+    var::String key;
+    json::JsonValue value;
+    // "key":value
+    var::String fragment;
+  };
+
+  struct Shared {
+    var::Vector<Entry> entry_list;
+    ChartJsRealFormat format;
+    u32 hash;
+  };
+
+  std::shared_ptr<const Shared> m_shared;
+};
+
 class ChartJsOptions {
 public:
   ChartJsOptions() {}
   json::JsonObject to_object() const {
     json::JsonObject result;
-    result.copy(m_value, json::JsonValue::IsDeepCopy::yes);
+    result.copy(to_shared_object(), json::JsonValue::IsDeepCopy::yes);
     return result;
   }
 
-  ChartJsOptions &set_property(const char *key, const json::JsonValue &value) {
-    m_value.insert(key, value);
+  // the options without copying the tree (values of the template and
+  // object() are shared), copy it to change it
+  json::JsonObject to_shared_object() const;
+
+  const ChartJsOptions &write(ChartJsWriter &writer) const;
+
+  // the options are the members of the template followed by the options
+  // set on this object, which replace template members with the same key
+  ChartJsOptions &set_template(const ChartJsOptionsTemplate &value) {
+    m_template = value;
     return *this;
   }
+  const ChartJsOptionsTemplate &options_template() const { return m_template; }
+
+  // hash of the serialized options, changes when an option changes
+  u32 calculate_hash() const;
+
+  ChartJsOptions &set_property(const char *key, const json::JsonValue &value) {
+    return insert(key, value);
+  }
 
   ChartJsOptions &set_scales(const ChartJsScales &value) {
-    m_value.insert("scales", value.to_object());
-    return *this;
+    return insert("scales", value.to_object());
   }
 
   ChartJsOptions &set_legend(const ChartJsLegend &value) {
-    m_value.insert("legend", value.to_object());
-    return *this;
+    return insert("legend", value.to_object());
   }
 
   ChartJsOptions &set_title(const ChartJsTitle &value) {
-    m_value.insert("title", value.to_object());
-    return *this;
+    return insert("title", value.to_object());
   }
 
   static ChartJsOptions create_time(const char *unit, var::StringView format) {
@@ -505,10 +1983,15 @@ public:
     return result;
   }
 
-  const json::JsonObject &object() { return m_value; }
+  // the options set on this object (not including the template)
+  const json::JsonObject &object() const { return m_value; }
 
 private:
   json::JsonObject m_value;
+  ChartJsOptionsTemplate m_template;
+
+  // the value is copied to the heap if a ChartJsArena::Scope is active
+  ChartJsOptions &insert(const char *key, const json::JsonValue &value);
 };
 
 class ChartJs {
@@ -527,26 +2010,111 @@ public:
   json::JsonObject to_object() const {
     json::JsonObject result;
     result.insert("type", json::JsonString(convert_type_to_string(m_type)));
-
     result.insert("options", options().to_object());
-
     result.insert("data", data().to_object());
+    return result;
+  }
 
+  // same as to_object() but the options tree is shared with options()
+  // (and its template) rather than copied, copy it to change it
+  json::JsonObject to_shared_object() const {
+    json::JsonObject result;
+    result.insert("type", json::JsonString(convert_type_to_string(m_type)));
+    result.insert("options", options().to_shared_object());
+    result.insert("data", data().to_object());
     return result;
   }
 
+  // writes the same JSON as to_object() (compact) without building it
+  const ChartJs &write(ChartJsWriter &writer) const {
+    writer.begin_object().insert("type", convert_type_to_string(m_type));
+    options().write(writer.write_key("options"));
+    data().write(writer.write_key("data"));
+    writer.end_object();
+    return *this;
+  }
+
+  const ChartJs &write(const fs::FileObject &file) const {
+    ChartJsWriter writer(file);
+    write(writer);
+    return *this;
+  }
+
+  // Returns the changes since a generation returned by an earlier call
+  // and records the current state as the latest generation():
+  //
+  // {"generation":g,"since":s,"options":{..},
+  //  "labels":{"remove":n,"append":[..]} (or "labels":[..]),
+  //  "datasets":[{"index":i,"remove":n,"append":[..],"properties":{..}},
+  //              {"index":i,"dataset":{..}}]}
+  //
+  // Members are only present if they changed. "remove" drops points from
+  // the front, "append" adds points to the back. Labels edited through
+  // label_list() are sent whole. A dataset that was replaced in
+  // dataset_list(), whose data(), x_column() or y_column() was returned
+  // for editing, or that is decimated, transformed or has a point source,
+  // is sent whole (every call with a point source is a new generation).
+  // If since_generation is no longer in the history, the result is
+  // {"generation":g,"reset":to_object()}.
+  json::JsonObject to_delta(u32 since_generation);
+
+  u32 generation() const {
+    return m_snapshot_list.count() ? m_snapshot_list.back().generation : 0;
+  }
+
+  static constexpr size_t snapshot_history_size = 8;
+
   ChartJsData &data() { return m_data; }
   const ChartJsData &data() const { return m_data; }
 
+  ChartJs &set_data(ChartJsData &&value) {
+    m_data = std::move(value);
+    return *this;
+  }
+
   ChartJsOptions &options() { return m_options; }
   const ChartJsOptions &options() const { return m_options; }
 
+  ChartJs &set_options(ChartJsOptions &&value) {
+    m_options = std::move(value);
+    return *this;
+  }
+
 private:
+  friend class ChartJsChunkWriter;
+  friend class ChartJsDashboard;
+
   API_AF(ChartJs, Type, type, Type::line);
 
   ChartJsData m_data;
   ChartJsOptions m_options;
 
+  struct DataSetSnapshot {
+    u32 identity;
+    u64 point_sequence;
+    size_t point_count;
+    size_t data_count;
+    u32 modification_count;
+    u32 properties_hash;
+    // the points of a source are not tracked, they may change any time
+    bool is_point_source;
+  };
+
+  struct Snapshot {
+    u32 generation;
+    Type type;
+    u32 options_hash;
+    u64 label_sequence;
+    size_t label_count;
+    u32 label_modification_count;
+    var::Vector<DataSetSnapshot> dataset_list;
+  };
+
+  var::Vector<Snapshot> m_snapshot_list;
+
+  Snapshot create_snapshot() const;
+  static bool is_equal(const Snapshot &a, const Snapshot &b);
+
   static var::StringView convert_type_to_string(Type value);
 };
 
@@ -0,0 +1,248 @@
+// Copyright 2020-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef CHARTAPI_CHART_CHARTJSAGGREGATION_HPP
+#define CHARTAPI_CHART_CHARTJSAGGREGATION_HPP
+
+#include "ChartJs.hpp"
+
+namespace chart {
+
+// Streaming quantile estimate with a bounded relative error. Values are
+// counted in logarithmically spaced bins so any quantile is within
+// relative_accuracy() of a value that was appended, as long as the bins
+// were not collapsed (see is_collapsed()). Sketches with the same
+// accuracy can be merged.
+class ChartJsQuantileSketch {
+public:
+  // bins are collapsed (starting with the values closest to zero) beyond
+  // this many per sign
+  static constexpr size_t maximum_bin_count = 2048;
+
+  explicit ChartJsQuantileSketch(double relative_accuracy = 0.01);
+
+  ChartJsQuantileSketch &append(double value);
+  ChartJsQuantileSketch &append(const float *values, size_t count);
+  ChartJsQuantileSketch &append(const double *values, size_t count);
+  ChartJsQuantileSketch &merge(const ChartJsQuantileSketch &sketch);
+  ChartJsQuantileSketch &clear();
+
+  // value at quantile (0.0 to 1.0), NAN if the sketch is empty
+  double quantile(double value) const;
+
+  u64 count() const { return m_count; }
+  bool is_empty() const { return m_count == 0; }
+  double minimum() const { return m_minimum; }
+  double maximum() const { return m_maximum; }
+  double relative_accuracy() const { return m_relative_accuracy; }
+
+  // true once values spanning more than maximum_bin_count bins (of one
+  // sign) were appended: the bins closest to zero were merged and
+  // quantiles that fall in them are no longer within relative_accuracy()
+  bool is_collapsed() const {
+    return m_positive.is_collapsed() || m_negative.is_collapsed();
+  }
+
+private:
+  // counts of bins first_bin, first_bin + 1, ...
+  class Store {
+  public:
+    void add(s32 bin, u64 count);
+    void merge(const Store &store);
+    void clear() {
+      m_count_list.clear();
+      m_first_bin = 0;
+      m_total = 0;
+      m_is_collapsed = false;
+    }
+
+    u64 total() const { return m_total; }
+    bool is_collapsed() const { return m_is_collapsed; }
+    s32 first_bin() const { return m_first_bin; }
+    const var::Vector<u64> &count_list() const { return m_count_list; }
+
+  private:
+    var::Vector<u64> m_count_list;
+    s32 m_first_bin = 0;
+    u64 m_total = 0;
+    bool m_is_collapsed = false;
+  };
+
+  double m_relative_accuracy;
+  double m_gamma;
+  double m_log_gamma;
+  Store m_positive;
+  Store m_negative;
+  u64 m_zero_count = 0;
+  u64 m_count = 0;
+  double m_minimum = 0.0;
+  double m_maximum = 0.0;
+
+  s32 get_bin(double magnitude) const;
+  double get_bin_value(s32 bin) const;
+  double get_rank_value(u64 rank) const;
+};
+
+// Counts values in equal width bins between minimum() and maximum().
+// Values outside the range are counted in underflow() and overflow(), NAN
+// is ignored.
+class ChartJsHistogram {
+public:
+  ChartJsHistogram(double minimum, double maximum, size_t bin_count);
+
+  ChartJsHistogram &append(double value) {
+    if (value >= m_minimum && value < m_maximum) {
+      size_t bin = size_t((value - m_minimum) * m_scale);
+      // rounding can place values just below maximum past the last bin
+      m_bin_list.at(bin < m_bin_list.count() ? bin : m_bin_list.count() - 1)++;
+    } else if (value < m_minimum) {
+      m_underflow++;
+    } else if (value >= m_maximum) {
+      m_overflow++;
+    }
+    return *this;
+  }
+
+  ChartJsHistogram &append(const float *values, size_t count);
+  ChartJsHistogram &append(const double *values, size_t count);
+  ChartJsHistogram &clear();
+
+  double minimum() const { return m_minimum; }
+  double maximum() const { return m_maximum; }
+  size_t bin_count() const { return m_bin_list.count(); }
+  double bin_width() const { return (m_maximum - m_minimum) / bin_count(); }
+  const var::Vector<u64> &bin_list() const { return m_bin_list; }
+  u64 underflow() const { return m_underflow; }
+  u64 overflow() const { return m_overflow; }
+
+  // one count per bin, for a category axis with the labels from
+  // append_labels()
+  ChartJsDataSet create_dataset() const;
+  // the count of each bin at the bin center, for a linear axis
+  ChartJsDataSet create_point_dataset() const;
+  // appends a label per bin ("0-10") to data
+  const ChartJsHistogram &append_labels(ChartJsData &data) const;
+
+  // labels and the count dataset
+  ChartJsData create_data() const {
+    ChartJsData result;
+    append_labels(result);
+    result.append(create_dataset());
+    return result;
+  }
+
+private:
+  double m_minimum;
+  double m_maximum;
+  double m_scale;
+  var::Vector<u64> m_bin_list;
+  u64 m_underflow = 0;
+  u64 m_overflow = 0;
+};
+
+// Rolls (timestamp, value) samples up into fixed width time buckets with
+// one dataset per statistic. Timestamps are milliseconds since the epoch
+// (as used by ChartJsAxis::Type::time) and buckets start at origin() plus
+// a multiple of width() so they line up with minutes, hours or days (UTC)
+// for those widths. Timestamps must be non-decreasing, an earlier sample
+// is counted in the current bucket. Empty buckets have no point.
+class ChartJsTimeAggregation {
+public:
+  enum class Statistic { count, sum, mean, minimum, maximum, quantile };
+
+  static constexpr s64 second = 1000;
+  static constexpr s64 minute = 60 * second;
+  static constexpr s64 hour = 60 * minute;
+  static constexpr s64 day = 24 * hour;
+
+  // Statistics are added before the first sample. Adding one after
+  // samples were appended starts over when the next bucket opens: the
+  // datasets and bucket_count() are cleared (the buckets so far are
+  // dropped as with clear()).
+  ChartJsTimeAggregation &add_statistic(Statistic value) {
+    m_statistic_list.push_back({value, 0.0});
+    return *this;
+  }
+
+  // for example add_quantile(0.95) for p95 (uses a ChartJsQuantileSketch
+  // per bucket)
+  ChartJsTimeAggregation &add_quantile(double value) {
+    m_statistic_list.push_back({Statistic::quantile, value});
+    return *this;
+  }
+
+  ChartJsTimeAggregation &append(s64 timestamp, double value);
+  ChartJsTimeAggregation &append(const s64 *timestamps, const float *values,
+                                 size_t count);
+  ChartJsTimeAggregation &append(const s64 *timestamps, const double *values,
+                                 size_t count);
+
+  // closes the current bucket, later samples start a new bucket
+  ChartJsTimeAggregation &flush();
+  ChartJsTimeAggregation &clear();
+
+  // bucket count so far (excluding the open bucket)
+  size_t bucket_count() const { return m_bucket_count; }
+
+  // the datasets (one per statistic in the order added) labeled "mean",
+  // "p95", ... with x at the start of each bucket, flush() first to
+  // include the open bucket
+  const var::Vector<ChartJsDataSet> &dataset_list() const {
+    return m_dataset_list;
+  }
+
+  // flushes and appends the datasets to data
+  ChartJsTimeAggregation &append_datasets(ChartJsData &data);
+
+  ChartJsData create_data() {
+    ChartJsData result;
+    append_datasets(result);
+    return result;
+  }
+
+  // the chart.js time unit matching width(), nullptr if none does
+  static const char *get_unit(s64 width);
+
+private:
+  API_AF(ChartJsTimeAggregation, s64, width, minute);
+  API_AF(ChartJsTimeAggregation, s64, origin, 0);
+  API_AF(ChartJsTimeAggregation, double, relative_accuracy, 0.01);
+
+  struct StatisticEntry {
+    Statistic statistic;
+    double quantile;
+  };
+
+  var::Vector<StatisticEntry> m_statistic_list;
+  var::Vector<ChartJsDataSet> m_dataset_list;
+  ChartJsQuantileSketch m_sketch;
+  bool m_is_quantile = false;
+
+  // the open bucket
+  s64 m_bucket_start = 0;
+  u64 m_count = 0;
+  double m_sum = 0.0;
+  double m_minimum = 0.0;
+  double m_maximum = 0.0;
+  size_t m_bucket_count = 0;
+
+  s64 get_bucket_start(s64 timestamp) const;
+  void open(s64 timestamp);
+  void accumulate(double value) {
+    if (m_count == 0) {
+      m_minimum = value;
+      m_maximum = value;
+    } else {
+      m_minimum = value < m_minimum ? value : m_minimum;
+      m_maximum = value > m_maximum ? value : m_maximum;
+    }
+    m_count++;
+    m_sum += value;
+    if (m_is_quantile) {
+      m_sketch.append(value);
+    }
+  }
+};
+
+} // namespace chart
+
+#endif // CHARTAPI_CHART_CHARTJSAGGREGATION_HPP
@@ -0,0 +1,103 @@
+// Copyright 2020-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef CHARTAPI_CHART_CHARTJSARENA_HPP
+#define CHARTAPI_CHART_CHARTJSARENA_HPP
+
+#include <var/View.hpp>
+
+namespace chart {
+
+// Bump allocator for the JSON nodes of a chart. While a Scope is active
+// every jansson allocation (each JsonValue, key and string created by
+// to_object()) comes from the arena and freeing is a no-op, so the tree
+// is released all at once with the arena. Blocks are taken from the heap
+// as needed (each twice the size of the last) or the arena uses a caller
+// provided buffer and never allocates, which keeps long running targets
+// from fragmenting the heap.
+class ChartJsArena {
+public:
+  static constexpr size_t default_block_size = 16384;
+  // every allocation is aligned to this
+  static constexpr size_t alignment = 16;
+
+  explicit ChartJsArena(size_t block_size = default_block_size);
+  // allocates from buffer only, allocations that do not fit come from the
+  // heap and are counted in overflow_count()
+  explicit ChartJsArena(var::View buffer);
+  ~ChartJsArena();
+
+  ChartJsArena(const ChartJsArena &) = delete;
+  ChartJsArena &operator=(const ChartJsArena &) = delete;
+
+  // nullptr if a buffer arena is full
+  void *allocate(size_t size);
+  bool contains(const void *pointer) const;
+
+  // everything allocated so far is released, the first block is kept
+  ChartJsArena &reset();
+
+  size_t used() const { return m_used; }
+  size_t capacity() const { return m_capacity; }
+  size_t block_count() const { return m_block_count; }
+  size_t overflow_count() const { return m_overflow_count; }
+
+  // Routes jansson allocations to arena until destroyed. JSON values
+  // created in the scope must be released before the arena (build,
+  // serialize with ChartJsWriter and destroy the chart inside the scope).
+  // Values given to ChartJsDataSet::append() and the ChartJsOptions
+  // setters are copied to the heap because the dataset or options can
+  // outlive the scope (values pushed directly into data() are not).
+  // Scopes nest, jansson must not be used by other threads meanwhile
+  // (ChartJsData::write() does not use threads while a scope is active).
+  class Scope {
+  public:
+    explicit Scope(ChartJsArena &arena);
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    friend ChartJsArena;
+    ChartJsArena &m_arena;
+    Scope *m_previous;
+  };
+
+  // routes jansson allocations back to the heap until destroyed (for
+  // values that outlive the active scope)
+  class HeapScope {
+  public:
+    HeapScope();
+    ~HeapScope();
+
+    HeapScope(const HeapScope &) = delete;
+    HeapScope &operator=(const HeapScope &) = delete;
+  };
+
+  // arena of the innermost scope, nullptr if none is active
+  static ChartJsArena *active();
+
+private:
+  struct Block {
+    Block *next;
+    u8 *data;
+    size_t size;
+    size_t used;
+  };
+
+  Block *m_block = nullptr;
+  Block m_buffer_block;
+  bool m_is_buffer = false;
+  size_t m_next_block_size;
+  size_t m_block_count = 0;
+  size_t m_used = 0;
+  size_t m_capacity = 0;
+  size_t m_overflow_count = 0;
+
+  Block *create_block(size_t size);
+  void release_blocks(Block *last);
+};
+
+} // namespace chart
+
+#endif // CHARTAPI_CHART_CHARTJSARENA_HPP
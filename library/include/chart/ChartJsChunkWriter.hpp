@@ -0,0 +1,155 @@
+// Copyright 2020-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef CHARTAPI_CHART_CHARTJSCHUNKWRITER_HPP
+#define CHARTAPI_CHART_CHARTJSCHUNKWRITER_HPP
+
+#include <var/View.hpp>
+
+#include "ChartJs.hpp"
+
+namespace chart {
+
+// Serializes a chart into caller buffers a part at a time, for example to
+// send it over serial or USB from a target with little heap:
+//
+//   ChartJsChunkWriter chunk_writer(chart);
+//   char buffer[64];
+//   while (const size_t size = chunk_writer.write(var::View(buffer))) {
+//     send(buffer, size);
+//   }
+//
+// The output is the same as ChartJs::write() and no JSON tree is built.
+// Labels, dataset properties, points and encoded data are written without
+// allocating. The options are written from the jansson tree they are
+// stored in, which allocates the list of its keys (and the members of an
+// options template written with a different real format), unless they
+// are passed pre-serialized with set_options_fragment(). The state is a
+// cursor into the chart, so the RAM used is sizeof(ChartJsChunkWriter)
+// plus a ChartJsWriter on the stack during write(). The chart must not
+// change until is_complete(). A value that does not fit in the rest of a
+// buffer is written again from its start and the bytes already passed on
+// are skipped, so the cost of a value split across buffers is paid once
+// per buffer. Decimated datasets are decimated and the derived values of
+// transformed datasets are calculated again for each buffer they span. A
+// point source is read again from the first point of each buffer (a
+// range source continues from the iterator kept in the writer).
+class ChartJsChunkWriter {
+public:
+  explicit ChartJsChunkWriter(const ChartJs &chart) : m_chart(chart) {}
+
+  // fills buffer with the next part of the chart and returns the number
+  // of bytes written (less than the buffer size only for the last part,
+  // 0 once complete)
+  size_t write(var::View buffer);
+
+  bool is_complete() const { return m_stage == Stage::complete; }
+  // bytes written so far
+  size_t size() const { return m_size; }
+
+  // starts again from the beginning of the chart
+  ChartJsChunkWriter &restart() {
+    m_stage = Stage::head;
+    m_index = 0;
+    m_point = 0;
+    m_source_point = 0;
+    m_source_cursor.reset();
+    m_column = 0;
+    m_encoded = ChartJsDataSet::EncodedColumnCursor();
+    m_item_offset = 0;
+    m_size = 0;
+    return *this;
+  }
+
+  // the options as written by ChartJsOptions::write() (serialized once, for
+  // example at startup or into flash), it must outlive the writer
+  var::StringView options_fragment() const { return m_options_fragment; }
+  ChartJsChunkWriter &set_options_fragment(var::StringView value) {
+    m_options_fragment = value;
+    return *this;
+  }
+
+private:
+  // reals are written with the shortest representation if inherit
+  API_AC(ChartJsChunkWriter, ChartJsRealFormat, real_format);
+
+  enum class Stage {
+    head,
+    options,
+    labels,
+    label,
+    datasets,
+    dataset,
+    value,
+    point,
+    source_point,
+    dataset_tail,
+    encoded_column,
+    encoded_value,
+    encoded_column_tail,
+    encoded_tail,
+    tail,
+    complete
+  };
+
+  // the destination of the current buffer
+  struct Output {
+    char *data;
+    size_t capacity;
+    size_t length;
+    // bytes of the current item written to earlier buffers
+    size_t skip;
+    size_t produced;
+    bool is_truncated;
+  };
+
+  const ChartJs &m_chart;
+  Stage m_stage = Stage::head;
+  // the label or dataset
+  size_t m_index = 0;
+  // the value or selected point of the dataset
+  size_t m_point = 0;
+  // the point of the dataset point source and the position in it
+  size_t m_source_point = 0;
+  ChartJsPointSource::Cursor m_source_cursor;
+  // the encoded column (0 for x, 1 for y) and the position in it
+  u8 m_column = 0;
+  ChartJsDataSet::EncodedColumnCursor m_encoded;
+  // bytes of the current item written to earlier buffers
+  size_t m_item_offset = 0;
+  size_t m_size = 0;
+  var::StringView m_options_fragment;
+
+  ChartJsRealFormat get_format() const {
+    return real_format().resolve(
+      ChartJsRealFormat().set_style(ChartJsRealFormat::Style::shortest));
+  }
+
+  // writes an item (a value with its separator) with function, false if
+  // the rest of the item is for the next buffer
+  template <typename Function> bool write_part(Output &output, Function function);
+  bool write_item(Output &output);
+  bool write_points(Output &output);
+  bool write_source_points(Output &output);
+  bool write_encoded_values(Output &output);
+  void next_encoded_column();
+  void next_dataset();
+
+  const ChartJsDataColumn &
+  get_encoded_column(const ChartJsDataSet &dataset) const {
+    return m_column ? dataset.y_column() : dataset.x_column();
+  }
+
+  static Stage get_points_next_stage(const ChartJsDataSet &dataset) {
+    return dataset.point_source().is_valid() ? Stage::source_point
+                                             : Stage::dataset_tail;
+  }
+
+  static void write_output(void *context, const char *data, size_t size);
+  static void write_literal(Output &output, var::StringView value) {
+    write_output(&output, value.data(), value.length());
+  }
+};
+
+} // namespace chart
+
+#endif // CHARTAPI_CHART_CHARTJSCHUNKWRITER_HPP
@@ -0,0 +1,97 @@
+// Copyright 2020-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef CHARTAPI_CHART_CHARTJSDASHBOARD_HPP
+#define CHARTAPI_CHART_CHARTJSDASHBOARD_HPP
+
+#include "ChartJs.hpp"
+
+namespace chart {
+
+// Many charts in one document. Label lists and dataset points that are
+// the same in several charts are written once and referenced by index:
+//
+// {"labels":[[..],..],"data":[[..],{..},..],
+//  "charts":[{"type":"line","options":{..},
+//             "data":{"labels":0,"datasets":[{..,"data":1}]}},..]}
+//
+// A chart's "labels" is an index into "labels". A dataset "data" is an
+// index into "data" (a dataset with encoded points has "data":[] and
+// "encodedData" is the index of the encoded object). Datasets with json
+// values in data(), a point source or without points are written in
+// place. Replacing each index with the referenced value gives the
+// ChartJs::to_object() of every chart. Datasets share points when the
+// columns hold the same values and the decimation, transform, real
+// format and encoding are the same.
+class ChartJsDashboard {
+public:
+  ChartJsDashboard() {}
+
+  ChartJsDashboard &append(const ChartJs &chart) {
+    m_chart_list.push_back(chart);
+    return *this;
+  }
+
+  ChartJsDashboard &append(ChartJs &&chart) {
+    m_chart_list.push_back(std::move(chart));
+    return *this;
+  }
+
+  // appends an empty chart to fill in place (the reference is valid until
+  // the next chart is appended)
+  ChartJs &emplace_chart() {
+    m_chart_list.push_back(ChartJs());
+    return m_chart_list.back();
+  }
+
+  var::Vector<ChartJs> &chart_list() { return m_chart_list; }
+  const var::Vector<ChartJs> &chart_list() const { return m_chart_list; }
+
+  json::JsonObject to_object() const;
+
+  // writes the same JSON as to_object() (compact) in one pass, the points
+  // of a shared dataset are serialized once
+  const ChartJsDashboard &write(ChartJsWriter &writer) const;
+
+  const ChartJsDashboard &write(const fs::FileObject &file) const {
+    ChartJsWriter writer(file);
+    write(writer);
+    return *this;
+  }
+
+  // number of entries in "labels" and "data"
+  size_t label_list_count() const { return create_plan().label_list.count(); }
+  size_t data_count() const { return create_plan().data_list.count(); }
+
+private:
+  // datasets written in place have no index
+  static constexpr size_t no_index = static_cast<size_t>(-1);
+
+  struct LabelEntry {
+    u64 hash;
+    // the first chart data with the labels
+    const ChartJsData *data;
+  };
+
+  struct DataEntry {
+    u64 hash;
+    // the first dataset with the value of "data"
+    const ChartJsDataSet *dataset;
+  };
+
+  struct Plan {
+    var::Vector<LabelEntry> label_list;
+    var::Vector<DataEntry> data_list;
+    // per chart
+    var::Vector<size_t> label_index_list;
+    // per dataset of every chart in order
+    var::Vector<size_t> data_index_list;
+  };
+
+  var::Vector<ChartJs> m_chart_list;
+
+  Plan create_plan() const;
+};
+
+} // namespace chart
+
+#endif // CHARTAPI_CHART_CHARTJSDASHBOARD_HPP
@@ -0,0 +1,76 @@
+// Copyright 2020-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef CHARTAPI_CHART_CHARTJSLEVELOFDETAIL_HPP
+#define CHARTAPI_CHART_CHARTJSLEVELOFDETAIL_HPP
+
+#include "ChartJs.hpp"
+
+namespace chart {
+
+// Multi-resolution index of a series. Level k holds the minimum, maximum
+// and mean of each run of 2^k samples and is updated as samples are
+// appended. Samples must be appended with non-decreasing x values.
+class ChartJsLevelOfDetail {
+public:
+  enum class Aggregate {
+    // one point per run at the mean x/y of the run
+    mean,
+    // the minimum and maximum sample of each run at their own x
+    min_max
+  };
+
+  class Query {
+    API_AF(Query, double, minimum, 0.0);
+    API_AF(Query, double, maximum, 0.0);
+    // the result has between resolution and 2 * resolution runs
+    API_AF(Query, size_t, resolution, 1000);
+    API_AF(Query, Aggregate, aggregate, Aggregate::min_max);
+  };
+
+  ChartJsLevelOfDetail &append(double x, double y);
+  ChartJsLevelOfDetail &append(const double *x_values, const double *y_values,
+                               size_t count);
+
+  // appends the points of the x range of query to dataset, the cost
+  // depends on the number of points returned rather than the number of
+  // samples in the range
+  const ChartJsLevelOfDetail &query(const Query &options,
+                                    ChartJsDataSet &dataset) const;
+
+  ChartJsDataSet create_dataset(const Query &options) const {
+    ChartJsDataSet result;
+    query(options, result);
+    return result;
+  }
+
+  size_t count() const { return m_x.count(); }
+  size_t level_count() const { return m_level_list.count() + 1; }
+
+  ChartJsLevelOfDetail &clear() {
+    m_x.clear();
+    m_y.clear();
+    m_level_list.clear();
+    return *this;
+  }
+
+private:
+  struct Run {
+    double minimum;
+    double maximum;
+    double sum;
+    u32 minimum_offset;
+    u32 maximum_offset;
+  };
+
+  var::Vector<double> m_x;
+  var::Vector<double> m_y;
+  // m_level_list.at(k - 1) is level k
+  var::Vector<var::Vector<Run>> m_level_list;
+
+  size_t lower_bound(double x) const;
+  size_t upper_bound(double x) const;
+};
+
+} // namespace chart
+
+#endif // CHARTAPI_CHART_CHARTJSLEVELOFDETAIL_HPP
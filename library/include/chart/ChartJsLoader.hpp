@@ -0,0 +1,77 @@
+// Copyright 2020-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef CHARTAPI_CHART_CHARTJSLOADER_HPP
+#define CHARTAPI_CHART_CHARTJSLOADER_HPP
+
+#include <fs/File.hpp>
+
+#include "ChartJs.hpp"
+
+namespace chart {
+
+// Fills ChartJsData from CSV text or packed little-endian binary records.
+// Only the selected columns are converted and the points are appended to
+// columnar datasets in batches. Files are memory mapped where the
+// platform supports it and are otherwise read through a fixed buffer, so
+// the file never has to fit in memory.
+class ChartJsLoader : public api::ExecutionContext {
+public:
+  enum class Format { csv, binary };
+
+  // type of each field of a binary record
+  enum class Field { u8, s8, u16, s16, u32, s32, u64, s64, real32, real64 };
+
+  static constexpr size_t none = static_cast<size_t>(-1);
+  // size of the read buffer when the file is not mapped (a csv line or a
+  // binary record must fit)
+  static constexpr size_t buffer_size = 4096;
+  // points are passed to the datasets in batches of this many rows
+  static constexpr size_t batch_size = 64;
+
+  ChartJsLoader &add_y_column(size_t column) {
+    m_y_column_list.push_back(column);
+    return *this;
+  }
+
+  ChartJsLoader &add_field(Field value) {
+    m_field_list.push_back(value);
+    return *this;
+  }
+
+  // appends one dataset per y column (labeled from the csv header) to
+  // data, the label column is appended to the data labels
+  ChartJsLoader &load(var::View contents, ChartJsData &data);
+  ChartJsLoader &load(const fs::FileObject &file, ChartJsData &data);
+  ChartJsLoader &load(var::StringView path, ChartJsData &data);
+
+  static size_t get_field_size(Field value);
+
+  // parses a decimal number, NAN if text is not a number
+  static double parse_real(var::StringView text);
+
+private:
+  API_AF(ChartJsLoader, Format, format, Format::csv);
+  API_AF(ChartJsLoader, char, delimiter, ',');
+  // the first csv line names the columns
+  API_AB(ChartJsLoader, header, true);
+  API_AF(ChartJsLoader, size_t, x_column, none);
+  // csv only, binary records are numeric
+  API_AF(ChartJsLoader, size_t, label_column, none);
+  // first data row to load and the number of rows (0 to load all)
+  API_AF(ChartJsLoader, size_t, first_row, 0);
+  API_AF(ChartJsLoader, size_t, row_count, 0);
+  // storage of the dataset columns (timestamp stores x packed and y as
+  // real64), label is an error (labels come from label_column())
+  API_AF(ChartJsLoader, ChartJsDataColumn::Type, type,
+         ChartJsDataColumn::Type::real32);
+  // all columns except the x and label columns if empty
+  API_AC(ChartJsLoader, var::Vector<size_t>, y_column_list);
+  // the layout of a binary record
+  API_AC(ChartJsLoader, var::Vector<Field>, field_list);
+
+  size_t get_record_size() const;
+};
+
+} // namespace chart
+
+#endif // CHARTAPI_CHART_CHARTJSLOADER_HPP
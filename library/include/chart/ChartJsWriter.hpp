@@ -0,0 +1,218 @@
+// Copyright 2020-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef CHARTAPI_CHART_CHARTJSWRITER_HPP
+#define CHARTAPI_CHART_CHARTJSWRITER_HPP
+
+#include <api/api.hpp>
+#include <fs/File.hpp>
+#include <json/Json.hpp>
+
+namespace chart {
+
+// How ChartJsWriter formats reals
+class ChartJsRealFormat {
+public:
+  enum class Style {
+    // the format of the enclosing writer (shortest for a writer)
+    inherit,
+    // 17 significant digits, the same output as jansson
+    exact,
+    // the fewest digits that read back as the same float (or double)
+    shortest,
+    // precision digits after the decimal point, trailing zeros dropped
+    fixed,
+    // precision significant digits
+    significant
+  };
+
+  const ChartJsRealFormat &resolve(const ChartJsRealFormat &parent) const {
+    return style() == Style::inherit ? parent : *this;
+  }
+
+  bool operator==(const ChartJsRealFormat &a) const {
+    return style() == a.style() && precision() == a.precision();
+  }
+
+  bool operator!=(const ChartJsRealFormat &a) const { return !(*this == a); }
+
+  // formats value and returns the length (0 if it does not fit or is not
+  // finite), a real always includes a '.' or an exponent like jansson's
+  // output
+  size_t format(char *buffer, size_t capacity, double value) const;
+  size_t format(char *buffer, size_t capacity, float value) const;
+
+private:
+  API_AF(ChartJsRealFormat, Style, style, Style::inherit);
+  API_AF(ChartJsRealFormat, u8, precision, 6);
+
+  size_t format(char *buffer, size_t capacity, double value,
+                bool is_float) const;
+};
+
+// Writes compact JSON directly to a file (or a callback) through a small
+// fixed buffer without building the jansson tree first. Reals use the
+// shortest representation by default, with ChartJsRealFormat::Style::exact
+// the output is the same as json::JsonDocument with Option::compact
+// applied to the equivalent json::JsonValue.
+class ChartJsWriter : public api::ExecutionContext {
+public:
+  static constexpr size_t buffer_size = 256;
+  static constexpr size_t maximum_depth = 32;
+
+  // receives each full buffer and the rest on flush()
+  using Callback = void (*)(void *context, const char *data, size_t size);
+
+  explicit ChartJsWriter(const fs::FileObject &file) : m_file(&file) {}
+  ChartJsWriter(void *context, Callback callback)
+      : m_context(context), m_callback(callback) {}
+  ~ChartJsWriter() { flush(); }
+
+  ChartJsWriter(const ChartJsWriter &) = delete;
+  ChartJsWriter &operator=(const ChartJsWriter &) = delete;
+
+  ChartJsWriter &begin_object();
+  ChartJsWriter &end_object();
+  ChartJsWriter &begin_array();
+  ChartJsWriter &end_array();
+
+  // writes the key of the next member of the current object
+  ChartJsWriter &write_key(var::StringView key);
+
+  ChartJsWriter &write_string(var::StringView value);
+  ChartJsWriter &write_real(double value);
+  ChartJsWriter &write_real(float value);
+  ChartJsWriter &write_integer(s64 value);
+  ChartJsWriter &write_bool(bool value);
+  ChartJsWriter &write_null();
+
+  // serializes an existing jansson value (with the exact format the size
+  // of the value is allocated temporarily), integers keep their 64 bits
+  // and a real that a float holds exactly (as ChartJs stores reals) is
+  // written as a float, any other as a double
+  ChartJsWriter &write_value(const json::JsonValue &value);
+
+  // writes pre-serialized members of the current object (such as the
+  // content of an object written by another ChartJsWriter without the
+  // braces) or a pre-serialized element of the current array
+  ChartJsWriter &write_fragment(var::StringView members);
+
+  // writes a base64 string of data passed in parts, every part except the
+  // last must be a multiple of 3 bytes
+  ChartJsWriter &begin_base64() {
+    begin_value();
+    return write_character('"');
+  }
+  ChartJsWriter &write_base64(const void *data, size_t size);
+  ChartJsWriter &end_base64() { return write_character('"'); }
+
+  // binary data written next to the JSON (such as typed arrays of
+  // ChartJsDataSet::DataEncoding::sidecar), nullptr if none
+  const fs::FileObject *sidecar() const { return m_sidecar; }
+  ChartJsWriter &set_sidecar(const fs::FileObject *value) {
+    m_sidecar = value;
+    m_sidecar_size = 0;
+    return *this;
+  }
+  ChartJsWriter &write_sidecar(const void *data, size_t size);
+  // number of bytes passed to the sidecar (the offset of the next write)
+  size_t sidecar_size() const { return m_sidecar_size; }
+
+  ChartJsWriter &write_string_list(const var::StringList &list);
+  ChartJsWriter &write_integer_list(const var::Vector<s32> &list);
+
+  ChartJsWriter &insert(var::StringView key, var::StringView value) {
+    return write_key(key).write_string(value);
+  }
+
+  ChartJsWriter &insert(var::StringView key, const json::JsonValue &value) {
+    return write_key(key).write_value(value);
+  }
+
+  ChartJsWriter &insert_real(var::StringView key, double value) {
+    return write_key(key).write_real(value);
+  }
+
+  ChartJsWriter &insert_real(var::StringView key, float value) {
+    return write_key(key).write_real(value);
+  }
+
+  ChartJsWriter &insert_integer(var::StringView key, s64 value) {
+    return write_key(key).write_integer(value);
+  }
+
+  ChartJsWriter &insert_bool(var::StringView key, bool value) {
+    return write_key(key).write_bool(value);
+  }
+
+  ChartJsWriter &insert_integer_list(var::StringView key,
+                                     const var::Vector<s32> &list) {
+    return write_key(key).write_integer_list(list);
+  }
+
+  ChartJsWriter &flush();
+
+  const ChartJsRealFormat &real_format() const { return m_real_format; }
+  ChartJsWriter &set_real_format(const ChartJsRealFormat &value) {
+    m_real_format = value;
+    return *this;
+  }
+
+  // number of threads that serialize ChartJsData datasets, each dataset
+  // is buffered in memory when this is more than one
+  u32 thread_count() const { return m_thread_count; }
+  ChartJsWriter &set_thread_count(u32 value) {
+    m_thread_count = value;
+    return *this;
+  }
+
+  // total number of bytes passed to the file
+  size_t size() const { return m_size; }
+
+  // formats value the same way jansson dumps a real, returns the length
+  static size_t format_real(char *buffer, size_t capacity, double value);
+
+  // json::JsonInteger takes an int and json::JsonValue::to_integer() and
+  // to_real() return an int and a float, these keep the 64 bits of a
+  // jansson integer and the double of a real
+  static json::JsonValue create_integer(s64 value);
+  static s64 get_integer(const json::JsonValue &value);
+  static double get_real(const json::JsonValue &value);
+
+private:
+  const fs::FileObject *m_file = nullptr;
+  void *m_context = nullptr;
+  Callback m_callback = nullptr;
+  char m_buffer[buffer_size];
+  size_t m_length = 0;
+  size_t m_size = 0;
+  size_t m_depth = 0;
+  u32 m_has_member = 0;
+  bool m_is_after_key = false;
+  ChartJsRealFormat m_real_format
+    = ChartJsRealFormat().set_style(ChartJsRealFormat::Style::shortest);
+  u32 m_thread_count = 1;
+  const fs::FileObject *m_sidecar = nullptr;
+  size_t m_sidecar_size = 0;
+
+  ChartJsWriter &write_raw(const char *value, size_t length);
+  ChartJsWriter &write_raw(var::StringView value) {
+    return write_raw(value.data(), value.length());
+  }
+  ChartJsWriter &write_escaped(var::StringView value);
+  ChartJsWriter &write_tree(const json::JsonValue &value);
+  ChartJsWriter &write_character(char value) {
+    if (m_length == buffer_size) {
+      flush();
+    }
+    m_buffer[m_length++] = value;
+    return *this;
+  }
+
+  void begin_value();
+  ChartJsWriter &push();
+  ChartJsWriter &pop();
+};
+
+} // namespace chart
+
+#endif // CHARTAPI_CHART_CHARTJSWRITER_HPP
@@ -1,32 +1,210 @@
 // Copyright 2020-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
 
+#include <thread/Mutex.hpp>
+#include <thread/Thread.hpp>
+
 #include "chart/ChartJs.hpp"
+#include "chart/ChartJsArena.hpp"
 
 using namespace chart;
 using namespace var;
 
+namespace {
+// adapts json::JsonObject to the insert interface of ChartJsWriter so
+// properties are listed once for both serializers
+class JsonObjectOutput {
+public:
+  explicit JsonObjectOutput(json::JsonObject &object) : m_object(object) {}
+
+  JsonObjectOutput &insert(StringView key, StringView value) {
+    m_object.insert(key, json::JsonString(value));
+    return *this;
+  }
+
+  JsonObjectOutput &insert_real(StringView key, float value) {
+    m_object.insert(key, json::JsonReal(value));
+    return *this;
+  }
+
+  JsonObjectOutput &insert_integer(StringView key, int value) {
+    m_object.insert(key, json::JsonInteger(value));
+    return *this;
+  }
+
+  JsonObjectOutput &insert_bool(StringView key, bool value) {
+    m_object.insert_bool(key, value);
+    return *this;
+  }
+
+  JsonObjectOutput &insert_integer_list(StringView key,
+                                        const Vector<s32> &list) {
+    m_object.insert(key, json::JsonArray(list));
+    return *this;
+  }
+
+private:
+  json::JsonObject &m_object;
+};
+
+// FNV-1a hash of serialized output
+const u32 fnv_offset_basis = 2166136261UL;
+
+void update_fnv_hash(void *context, const char *data, size_t size) {
+  u32 *hash = reinterpret_cast<u32 *>(context);
+  for (size_t i = 0; i < size; i++) {
+    *hash = (*hash ^ u8(data[i])) * 16777619UL;
+  }
+}
+
+void append_string(void *context, const char *data, size_t size) {
+  reinterpret_cast<String *>(context)->append(StringView(data, size));
+}
+
+// serializes datasets into their own buffers, the workers take the next
+// dataset in order until none are left
+//
+// Values in data() are jansson nodes (shared by copies of a dataset and
+// reference counted without atomics) and the exact format builds jansson
+// arrays, so datasets with values are written by write_serial() on the
+// calling thread before the workers start.
+class DataSetJob {
+public:
+  DataSetJob(const Vector<ChartJsDataSet> &dataset_list,
+             const ChartJsRealFormat &real_format)
+    : m_dataset_list(dataset_list), m_real_format(real_format) {
+    m_output_list.resize(dataset_list.count());
+  }
+
+  static void *work(void *context) {
+    reinterpret_cast<DataSetJob *>(context)->execute();
+    return nullptr;
+  }
+
+  static bool is_serial(const ChartJsDataSet &dataset) {
+    return dataset.data().count() > 0;
+  }
+
+  // returns the number of datasets left for the workers
+  size_t write_serial() {
+    size_t result = 0;
+    for (size_t offset = 0; offset < m_dataset_list.count(); offset++) {
+      if (is_serial(m_dataset_list.at(offset))) {
+        write(offset);
+      } else {
+        result++;
+      }
+    }
+    return result;
+  }
+
+  void execute() {
+    while (true) {
+      m_mutex.lock();
+      const size_t offset = m_next++;
+      m_mutex.unlock();
+      if (offset >= m_dataset_list.count()) {
+        return;
+      }
+      if (!is_serial(m_dataset_list.at(offset))) {
+        write(offset);
+      }
+    }
+  }
+
+  String &output(size_t offset) { return m_output_list.at(offset); }
+
+private:
+  void write(size_t offset) {
+    ChartJsWriter writer(&m_output_list.at(offset), append_string);
+    writer.set_real_format(m_real_format);
+    m_dataset_list.at(offset).write(writer);
+  }
+
+  const Vector<ChartJsDataSet> &m_dataset_list;
+  const ChartJsRealFormat m_real_format;
+  Vector<String> m_output_list;
+  thread::Mutex m_mutex;
+  size_t m_next = 0;
+};
+} // namespace
+
 ChartJs::ChartJs() {}
 
+namespace {
+constexpr ChartJsColor standard_palette[ChartJsColor::standard_palette_count]
+  = {ChartJsColor("9BA4B2"), ChartJsColor("F1D651"), ChartJsColor("9F5D6B"),
+     ChartJsColor("343D68"), ChartJsColor("94BFDE"), ChartJsColor("AA3C55"),
+     ChartJsColor("255C35"), ChartJsColor("AA9E9B"), ChartJsColor("38323D"),
+     ChartJsColor("84817E"), ChartJsColor("A19B9A"), ChartJsColor("88BCAA"),
+     ChartJsColor("787FCC"), ChartJsColor("2F6192"), ChartJsColor("A2795B"),
+     ChartJsColor("2C1B2E")};
+
+char *write_decimal(char *cursor, u8 value) {
+  if (value >= 100) {
+    *cursor++ = char('0' + value / 100);
+  }
+  if (value >= 10) {
+    *cursor++ = char('0' + (value / 10) % 10);
+  }
+  *cursor++ = char('0' + value % 10);
+  return cursor;
+}
+} // namespace
+
 ChartJsColor::ChartJsColor(StringView hex_code) {
 
   if (hex_code.length() != 6) {
     return;
   }
 
+  const char *hex = hex_code.data();
+  for (size_t i = 0; i < 6; i++) {
+    if (get_hex_digit(hex[i]) < 0) {
+      return;
+    }
+  }
+
   set_valid();
+  m_red = get_hex_byte(hex[0], hex[1]);
+  m_green = get_hex_byte(hex[2], hex[3]);
+  m_blue = get_hex_byte(hex[4], hex[5]);
+}
 
-  m_red = hex_code.get_substring_with_length(2).to_unsigned_long(
-      String::Base::hexadecimal);
+size_t ChartJsColor::to_buffer(char (&buffer)[string_size]) const {
+  char *cursor = buffer;
+  const char prefix[] = "rgba(";
+  for (size_t i = 0; i < sizeof(prefix) - 1; i++) {
+    *cursor++ = prefix[i];
+  }
+  cursor = write_decimal(cursor, m_red);
+  *cursor++ = ',';
+  cursor = write_decimal(cursor, m_green);
+  *cursor++ = ',';
+  cursor = write_decimal(cursor, m_blue);
+  *cursor++ = ',';
 
-  m_green = hex_code
-                .get_substring(
-                    StringView::GetSubstring().set_position(2).set_length(2))
-                .to_unsigned_long(StringView::Base::hexadecimal);
+  // alpha / 255 rounded to hundredths, matches %0.2f for all 256 values
+  const u32 hundredths = (u32(m_alpha) * 100 + 127) / 255;
+  *cursor++ = char('0' + hundredths / 100);
+  *cursor++ = '.';
+  *cursor++ = char('0' + (hundredths / 10) % 10);
+  *cursor++ = char('0' + hundredths % 10);
+  *cursor++ = ')';
+  *cursor = '\0';
+  return size_t(cursor - buffer);
+}
 
-  m_blue = hex_code
-               .get_substring(
-                   StringView::GetSubstring().set_position(4).set_length(2))
-               .to_unsigned_long(StringView::Base::hexadecimal);
+ChartJsColor ChartJsColor::get_standard(u32 idx) {
+  return standard_palette[idx % standard_palette_count];
+}
+
+var::Vector<ChartJsColor> ChartJsColor::create_standard_palette() {
+  var::Vector<ChartJsColor> result;
+  result.reserve(standard_palette_count);
+  for (const auto &color : standard_palette) {
+    result.push_back(color);
+  }
+  return result;
 }
 
 var::StringView ChartJs::convert_type_to_string(Type value) {
@@ -128,132 +306,758 @@ ChartJsDataSet::get_border_cap_style_string(BorderCapStyle value) {
   return "butt";
 }
 
-json::JsonObject ChartJsDataSet::to_object() const {
-  json::JsonObject result;
-
+template <class Output>
+void ChartJsDataSet::insert_properties(Output &output) const {
   if (background_color().is_valid()) {
-    result.insert("backgroundColor",
-                  json::JsonString(background_color().to_string().string_view()));
+    output.insert("backgroundColor",
+                  background_color().to_string().string_view());
   }
 
-  result.insert("borderCapStyle", json::JsonString(get_border_cap_style_string(
-                                      border_cap_style())));
+  output.insert("borderCapStyle",
+                get_border_cap_style_string(border_cap_style()));
 
   if (border_color().is_valid()) {
-    result.insert("borderColor", json::JsonString(border_color().to_string().string_view()));
+    output.insert("borderColor", border_color().to_string().string_view());
   }
 
   if (border_dash_list().count()) {
-    result.insert("borderDash", json::JsonArray(border_dash_list()));
+    output.insert_integer_list("borderDash", border_dash_list());
   }
 
-  result.insert("borderDashOffset", json::JsonReal(border_dash_offset()));
-  result.insert(
-      "borderJoinStyle",
-      json::JsonString(get_border_join_style_string(border_join_style())));
-  result.insert("borderWidth", json::JsonReal(border_width()));
-  result.insert("cubicInterpolationMode",
-                json::JsonString(get_cubic_interpolation_mode_string(
-                    cubic_interpolation_mode())));
+  output.insert_real("borderDashOffset", border_dash_offset());
+  output.insert("borderJoinStyle",
+                get_border_join_style_string(border_join_style()));
+  output.insert_real("borderWidth", border_width());
+  output.insert("cubicInterpolationMode",
+                get_cubic_interpolation_mode_string(cubic_interpolation_mode()));
   // clip
-  result.insert_bool("fill", is_fill());
+  output.insert_bool("fill", is_fill());
 
   if (hover_background_color().is_valid()) {
-    result.insert("hoverBackgroundColor",
-                  json::JsonString(hover_background_color().to_string().string_view()));
+    output.insert("hoverBackgroundColor",
+                  hover_background_color().to_string().string_view());
   }
-  result.insert(
-      "hoverBorderCapStyle",
-      json::JsonString(get_border_cap_style_string(hover_border_cap_style())));
+  output.insert("hoverBorderCapStyle",
+                get_border_cap_style_string(hover_border_cap_style()));
 
   if (hover_border_color().is_valid()) {
-    result.insert("hoverBorderColor",
-                  json::JsonString(hover_border_color().to_string().string_view()));
+    output.insert("hoverBorderColor",
+                  hover_border_color().to_string().string_view());
   }
 
   if (hover_border_dash_list().count()) {
-    result.insert("hoverBorderDash", json::JsonArray(hover_border_dash_list()));
+    output.insert_integer_list("hoverBorderDash", hover_border_dash_list());
   }
 
   if (hover_border_dash_offset() != HUGE_VALF) {
-    result.insert("hoverBorderDashOffset",
-                  json::JsonReal(hover_border_dash_offset()));
+    output.insert_real("hoverBorderDashOffset", hover_border_dash_offset());
   }
 
   if (hover_border_join_style() != BorderJoinStyle::undefined) {
-    result.insert("hoverBorderJoinStyle",
-                  json::JsonString(
-                      get_border_join_style_string(hover_border_join_style())));
+    output.insert("hoverBorderJoinStyle",
+                  get_border_join_style_string(hover_border_join_style()));
   }
 
   if (hover_border_width() != HUGE_VALF) {
-    result.insert("hoverBorderWidth", json::JsonReal(hover_border_width()));
+    output.insert_real("hoverBorderWidth", hover_border_width());
   }
 
   if (!label().is_empty()) {
-    result.insert("label", json::JsonString(label()));
+    output.insert("label", label());
   }
 
-  result.insert("lineTension", json::JsonReal(line_tension()));
-  result.insert("order", json::JsonInteger(order()));
+  output.insert_real("lineTension", line_tension());
+  output.insert_integer("order", order());
 
   if (point_background_color().is_valid()) {
-    result.insert("pointBackgroundColor",
-                  json::JsonString(point_background_color().to_string().string_view()));
+    output.insert("pointBackgroundColor",
+                  point_background_color().to_string().string_view());
   }
 
   if (point_border_color().is_valid()) {
-    result.insert("pointBorderColor",
-                  json::JsonString(point_border_color().to_string().string_view()));
+    output.insert("pointBorderColor",
+                  point_border_color().to_string().string_view());
   }
 
-  result.insert("pointBorderWidth", json::JsonReal(point_border_width()));
-  result.insert("pointHitRadius", json::JsonReal(point_hit_radius()));
+  output.insert_real("pointBorderWidth", point_border_width());
+  output.insert_real("pointHitRadius", point_hit_radius());
 
   if (point_hover_background_color().is_valid()) {
-    result.insert("pointHoverBackgroundColor",
-                  json::JsonString(point_hover_background_color().to_string().string_view()));
+    output.insert("pointHoverBackgroundColor",
+                  point_hover_background_color().to_string().string_view());
   }
 
   if (point_hover_border_color().is_valid()) {
-    result.insert("pointHoverBorderColor",
-                  json::JsonString(point_hover_border_color().to_string().string_view()));
+    output.insert("pointHoverBorderColor",
+                  point_hover_border_color().to_string().string_view());
   }
 
-  result.insert("pointHoverRadius", json::JsonReal(point_hover_radius()));
-  result.insert("pointRadius", json::JsonReal(point_radius()));
-  result.insert("pointRotation", json::JsonReal(point_rotation()));
-  result.insert("pointStyle",
-                json::JsonString(get_point_style_string(point_style())));
+  output.insert_real("pointHoverRadius", point_hover_radius());
+  output.insert_real("pointRadius", point_radius());
+  output.insert_real("pointRotation", point_rotation());
+  output.insert("pointStyle", get_point_style_string(point_style()));
 
-  result.insert_bool("showLine", is_show_line());
-  result.insert_bool("spanGaps", is_span_gaps());
+  output.insert_bool("showLine", is_show_line());
+  output.insert_bool("spanGaps", is_span_gaps());
 
   {
     const var::StringView stepped_line_value =
         get_stepped_line_string(stepped_line());
     if (stepped_line_value == "true") {
-      result.insert_bool("steppedLine", true);
+      output.insert_bool("steppedLine", true);
     } else if (stepped_line_value == "false") {
-      result.insert_bool("steppedLine", false);
+      output.insert_bool("steppedLine", false);
     } else {
-      result.insert("steppedLine", json::JsonString(stepped_line_value));
+      output.insert("steppedLine", stepped_line_value);
     }
   }
 
   if (!x_axis_id().is_empty()) {
-    result.insert("xAxisID", json::JsonString(x_axis_id()));
+    output.insert("xAxisID", x_axis_id());
   }
 
   if (!y_axis_id().is_empty()) {
-    result.insert("xAxisID", json::JsonString(y_axis_id()));
+    output.insert("yAxisID", y_axis_id());
+  }
+}
+
+// the chunk writer writes the properties without caching them
+template void
+ChartJsDataSet::insert_properties<ChartJsWriter>(ChartJsWriter &output) const;
+
+u32 ChartJsDataSet::create_identity() {
+  // datasets can be constructed on any thread
+  static thread::Mutex mutex;
+  static u32 count = 0;
+  mutex.lock();
+  const u32 result = ++count;
+  mutex.unlock();
+  return result;
+}
+
+ChartJsDataSet &ChartJsDataSet::append(const json::JsonValue &value) {
+  if (ChartJsArena::active() == nullptr) {
+    m_data.push_back(value);
+    return *this;
+  }
+  // the dataset can outlive the arena of the scope
+  ChartJsArena::HeapScope heap_scope;
+  json::JsonValue copy;
+  copy.copy(value, json::JsonValue::IsDeepCopy::yes);
+  m_data.push_back(copy);
+  return *this;
+}
+
+json::JsonObject ChartJsDataSet::to_object() const {
+  json::JsonObject result;
+  copy_properties_object(result);
+  result.insert("data", data_to_array());
+  if (data_encoding() != DataEncoding::json && point_count()) {
+    result.insert("encodedData", encoded_data_to_object());
   }
+  return result;
+}
 
-  json::JsonArray data_array;
+json::JsonArray ChartJsDataSet::data_to_array() const {
+  json::JsonArray result;
   for (const auto &data : m_data) {
-    data_array.append(data);
+    result.append(data);
+  }
+  if (data_encoding() == DataEncoding::json) {
+    ChartJsTransform::Evaluator evaluator(
+      transform(), x_column(), y_column(), point_count());
+    struct Context {
+      const ChartJsDataSet *self;
+      json::JsonArray *data_array;
+      ChartJsTransform::Evaluator *evaluator;
+    } context
+      = {this, &result, transform().is_active() ? &evaluator : nullptr};
+    decimation().select(
+      x_column(), y_column(), point_count(), &context,
+      [](void *context, size_t offset) {
+        Context *c = reinterpret_cast<Context *>(context);
+        c->data_array->append(
+          c->evaluator
+            ? c->self->point_to_value(offset, c->evaluator->at(offset))
+            : c->self->point_to_value(offset));
+      });
+  }
+  if (point_source().is_valid()) {
+    point_source().append(result);
   }
-  result.insert("data", data_array);
+  return result;
+}
 
+json::JsonObject ChartJsDataSet::properties_to_object() const {
+  json::JsonObject result;
+  copy_properties_object(result);
   return result;
 }
+
+u32 ChartJsDataSet::calculate_properties_hash() const {
+  // hashed as written by a writer with the default format
+  get_properties_fragment(real_format().resolve(
+    ChartJsRealFormat().set_style(ChartJsRealFormat::Style::shortest)));
+  return m_properties_hash;
+}
+
+void ChartJsDataSet::copy_properties_object(json::JsonObject &result) const {
+  if (ChartJsArena::active() != nullptr) {
+    // a cached object would outlive the arena of the scope
+    JsonObjectOutput output(result);
+    insert_properties(output);
+    return;
+  }
+  result.copy(get_properties_object(), json::JsonValue::IsDeepCopy::yes);
+}
+
+const json::JsonObject &ChartJsDataSet::get_properties_object() const {
+  if (!m_is_properties_object_valid) {
+    m_properties_object.value = json::JsonObject();
+    JsonObjectOutput output(m_properties_object.value);
+    insert_properties(output);
+    m_is_properties_object_valid = true;
+  }
+  return m_properties_object.value;
+}
+
+const var::String &
+ChartJsDataSet::get_properties_fragment(const ChartJsRealFormat &format) const {
+  if (!m_is_properties_fragment_valid || m_properties_real_format != format) {
+    String result;
+    {
+      ChartJsWriter writer(&result, append_string);
+      writer.set_real_format(format).begin_object();
+      insert_properties(writer);
+      writer.end_object();
+    }
+
+    // drop the braces, the members are inserted into the dataset object
+    m_properties_fragment = String(result.string_view().get_substring(
+      StringView::GetSubstring().set_position(1).set_length(
+        result.length() - 2)));
+
+    m_properties_hash = fnv_offset_basis;
+    update_fnv_hash(&m_properties_hash, m_properties_fragment.cstring(),
+                    m_properties_fragment.length());
+    m_properties_real_format = format;
+    m_is_properties_fragment_valid = true;
+  }
+  return m_properties_fragment;
+}
+
+const ChartJsData &ChartJsData::write(ChartJsWriter &writer) const {
+  writer.begin_object().write_key("labels").begin_array();
+  for (size_t i = 0; i < label_count(); i++) {
+    writer.write_string(label_at(i));
+  }
+  writer.end_array().write_key("datasets").begin_array();
+  // sidecar offsets depend on the order the datasets are written and the
+  // arena allocator of a scope is not thread safe
+  if (writer.thread_count() > 1 && m_dataset_list.count() > 1
+      && writer.sidecar() == nullptr && ChartJsArena::active() == nullptr) {
+    write_datasets_parallel(writer);
+  } else {
+    for (const auto &dataset : m_dataset_list) {
+      dataset.write(writer);
+    }
+  }
+  writer.end_array().end_object();
+  return *this;
+}
+
+void ChartJsData::write_datasets_parallel(ChartJsWriter &writer) const {
+  DataSetJob job(m_dataset_list, writer.real_format());
+  const size_t parallel_count = job.write_serial();
+
+  // the calling thread is one of the workers
+  const size_t thread_count = writer.thread_count() < parallel_count
+                                ? writer.thread_count()
+                                : parallel_count;
+  Vector<thread::Thread> thread_list;
+  thread_list.reserve(thread_count ? thread_count - 1 : 0);
+  for (size_t i = 1; i < thread_count; i++) {
+    thread_list.push_back(thread::Thread(
+      thread::Thread::Attributes().set_joinable(),
+      thread::Thread::Construct().set_argument(&job).set_function(
+        DataSetJob::work)));
+  }
+  job.execute();
+  for (auto &thread : thread_list) {
+    thread.join();
+  }
+
+  // concatenated in order, each buffer is released once it is written
+  for (size_t i = 0; i < m_dataset_list.count(); i++) {
+    writer.write_fragment(job.output(i).string_view());
+    job.output(i) = String();
+  }
+}
+
+ChartJsOptionsTemplate::ChartJsOptionsTemplate(
+  const ChartJsOptions &options,
+  const ChartJsRealFormat &format) {
+  // a template is shared by charts that can outlive an arena scope
+  ChartJsArena::HeapScope heap_scope;
+  std::shared_ptr<Shared> shared = std::make_shared<Shared>();
+  shared->format = format;
+  shared->hash = fnv_offset_basis;
+
+  const json::JsonObject object = options.to_object();
+  const StringList key_list = object.get_key_list();
+  shared->entry_list.reserve(key_list.count());
+  for (const auto &key : key_list) {
+    Entry entry;
+    entry.key = key;
+    entry.value = object.at(key.string_view());
+    String result;
+    {
+      ChartJsWriter writer(&result, append_string);
+      writer.set_real_format(format).begin_object().insert(
+        key.string_view(), entry.value);
+      writer.end_object();
+    }
+    // drop the braces, the member is inserted into the options object
+    entry.fragment = String(result.string_view().get_substring(
+      StringView::GetSubstring().set_position(1).set_length(
+        result.length() - 2)));
+    update_fnv_hash(
+      &shared->hash, entry.fragment.cstring(), entry.fragment.length());
+    shared->entry_list.push_back(std::move(entry));
+  }
+
+  m_shared = std::move(shared);
+}
+
+ChartJsOptions &ChartJsOptions::insert(const char *key,
+                                       const json::JsonValue &value) {
+  if (ChartJsArena::active() == nullptr) {
+    m_value.insert(key, value);
+    return *this;
+  }
+  // the options can outlive the arena of the scope, the object also grows
+  // its table on the heap
+  ChartJsArena::HeapScope heap_scope;
+  json::JsonValue copy;
+  copy.copy(value, json::JsonValue::IsDeepCopy::yes);
+  m_value.insert(key, copy);
+  return *this;
+}
+
+json::JsonObject ChartJsOptions::to_shared_object() const {
+  if (!m_template.is_valid()) {
+    return m_value;
+  }
+
+  json::JsonObject result;
+  for (const auto &entry : m_template.m_shared->entry_list) {
+    if (!m_value.at(entry.key.string_view()).is_valid()) {
+      result.insert(entry.key.string_view(), entry.value);
+    }
+  }
+  for (const auto &key : m_value.get_key_list()) {
+    result.insert(key.string_view(), m_value.at(key.string_view()));
+  }
+  return result;
+}
+
+const ChartJsOptions &ChartJsOptions::write(ChartJsWriter &writer) const {
+  if (!m_template.is_valid()) {
+    writer.write_value(m_value);
+    return *this;
+  }
+
+  // the template members were serialized with one format
+  const bool is_fragment
+    = writer.real_format() == m_template.m_shared->format;
+  writer.begin_object();
+  for (const auto &entry : m_template.m_shared->entry_list) {
+    if (m_value.at(entry.key.string_view()).is_valid()) {
+      continue;
+    }
+    if (is_fragment) {
+      writer.write_fragment(entry.fragment.string_view());
+    } else {
+      writer.insert(entry.key.string_view(), entry.value);
+    }
+  }
+  for (const auto &key : m_value.get_key_list()) {
+    writer.insert(key.string_view(), m_value.at(key.string_view()));
+  }
+  writer.end_object();
+  return *this;
+}
+
+u32 ChartJsOptions::calculate_hash() const {
+  // the template hash covers its members without writing them
+  u32 result = m_template.is_valid() ? m_template.m_shared->hash
+                                     : fnv_offset_basis;
+  {
+    ChartJsWriter writer(&result, update_fnv_hash);
+    writer.write_value(m_value);
+  }
+  return result;
+}
+
+const ChartJsDataSet &ChartJsDataSet::write(ChartJsWriter &writer) const {
+  const ChartJsRealFormat parent_format = writer.real_format();
+  const ChartJsRealFormat format = real_format().resolve(parent_format);
+  writer.set_real_format(format).begin_object().write_fragment(
+    get_properties_fragment(format).string_view());
+  write_data(writer.write_key("data"));
+  if (data_encoding() != DataEncoding::json && point_count()) {
+    write_encoded_data(writer.write_key("encodedData"));
+  }
+  writer.end_object().set_real_format(parent_format);
+  return *this;
+}
+
+const ChartJsDataSet &ChartJsDataSet::write_data(ChartJsWriter &writer) const {
+  writer.begin_array();
+  for (const auto &data : m_data) {
+    writer.write_value(data);
+  }
+  if (data_encoding() == DataEncoding::json) {
+    ChartJsTransform::Evaluator evaluator(
+      transform(), x_column(), y_column(), point_count());
+    struct Context {
+      const ChartJsDataSet *self;
+      ChartJsWriter *writer;
+      ChartJsTransform::Evaluator *evaluator;
+    } context
+      = {this, &writer, transform().is_active() ? &evaluator : nullptr};
+    decimation().select(
+      x_column(), y_column(), point_count(), &context,
+      [](void *context, size_t offset) {
+        Context *c = reinterpret_cast<Context *>(context);
+        if (c->evaluator) {
+          c->self->write_point(*c->writer, offset, c->evaluator->at(offset));
+        } else {
+          c->self->write_point(*c->writer, offset);
+        }
+      });
+  }
+  if (point_source().is_valid()) {
+    point_source().write(writer);
+  }
+  writer.end_array();
+  return *this;
+}
+
+const ChartJsDataSet &ChartJsDataSet::write_point(ChartJsWriter &writer,
+                                                  size_t offset) const {
+  if (is_point_xy()) {
+    writer.begin_object().write_key("x");
+    x_column().write(writer, offset);
+    writer.write_key("y");
+    y_column().write(writer, offset);
+    writer.end_object();
+  } else {
+    y_column().write(writer, offset);
+  }
+  return *this;
+}
+
+json::JsonValue ChartJsDataSet::point_to_value(size_t offset) const {
+  if (is_point_xy()) {
+    return json::JsonObject()
+        .insert("x", x_column().to_value(offset))
+        .insert("y", y_column().to_value(offset));
+  }
+  return y_column().to_value(offset);
+}
+
+const ChartJsDataSet &
+ChartJsDataSet::write_point(ChartJsWriter &writer, size_t offset,
+                            double y) const {
+  if (is_point_xy()) {
+    writer.begin_object().write_key("x");
+    x_column().write(writer, offset);
+    writer.write_key("y").write_real(y).end_object();
+  } else {
+    writer.write_real(y);
+  }
+  return *this;
+}
+
+json::JsonValue ChartJsDataSet::point_to_value(size_t offset, double y) const {
+  // jansson cannot represent inf/nan, chart.js treats null as a gap
+  const json::JsonValue value = std::isfinite(y)
+                                  ? json::JsonValue(json::JsonReal(y))
+                                  : json::JsonValue(json::JsonNull());
+  if (is_point_xy()) {
+    return json::JsonObject()
+        .insert("x", x_column().to_value(offset))
+        .insert("y", value);
+  }
+  return value;
+}
+
+ChartJsDataColumn &ChartJsDataColumn::append(float value) {
+  set_type_if_none(Type::real32);
+  switch (m_type) {
+  case Type::none:
+  case Type::real32:
+    push(m_real32, value);
+    break;
+  case Type::real64:
+    push(m_real64, double(value));
+    break;
+  case Type::integer64:
+    push(m_integer64, s64(value));
+    break;
+  case Type::label:
+    push_label_id(s64(value));
+    break;
+  case Type::timestamp:
+    push_timestamp(s64(value));
+    break;
+  }
+  return *this;
+}
+
+ChartJsDataColumn &ChartJsDataColumn::append(double value) {
+  set_type_if_none(Type::real64);
+  switch (m_type) {
+  case Type::none:
+  case Type::real64:
+    push(m_real64, value);
+    break;
+  case Type::real32:
+    push(m_real32, float(value));
+    break;
+  case Type::integer64:
+    push(m_integer64, s64(value));
+    break;
+  case Type::label:
+    push_label_id(s64(value));
+    break;
+  case Type::timestamp:
+    push_timestamp(s64(value));
+    break;
+  }
+  return *this;
+}
+
+ChartJsDataColumn &ChartJsDataColumn::append(s64 value) {
+  set_type_if_none(Type::integer64);
+  switch (m_type) {
+  case Type::none:
+  case Type::integer64:
+    push(m_integer64, value);
+    break;
+  case Type::label:
+    push_label_id(value);
+    break;
+  case Type::real32:
+    push(m_real32, float(value));
+    break;
+  case Type::real64:
+    push(m_real64, double(value));
+    break;
+  case Type::timestamp:
+    push_timestamp(value);
+    break;
+  }
+  return *this;
+}
+
+ChartJsDataColumn &ChartJsDataColumn::append(const float *values,
+                                             size_t count) {
+  set_type_if_none(Type::real32);
+  reserve_for_append(count);
+  for (size_t i = 0; i < count; i++) {
+    append(values[i]);
+  }
+  return *this;
+}
+
+ChartJsDataColumn &ChartJsDataColumn::append(const double *values,
+                                             size_t count) {
+  set_type_if_none(Type::real64);
+  reserve_for_append(count);
+  for (size_t i = 0; i < count; i++) {
+    append(values[i]);
+  }
+  return *this;
+}
+
+ChartJsDataColumn &ChartJsDataColumn::append(const s64 *values,
+                                             size_t count) {
+  set_type_if_none(Type::integer64);
+  reserve_for_append(count);
+  for (size_t i = 0; i < count; i++) {
+    append(values[i]);
+  }
+  return *this;
+}
+
+void ChartJsDataColumn::reserve_for_append(size_t count) {
+  // an exact reserve on every call would copy the column each time a
+  // batch is appended, later batches use the growth of push_back()
+  if (this->count() == 0) {
+    reserve(count);
+  }
+}
+
+ChartJsDataColumn &ChartJsDataColumn::reserve(size_t count) {
+  if (m_capacity && count > m_capacity) {
+    count = m_capacity;
+  }
+  switch (m_type) {
+  case Type::none:
+    m_reserve_count = count;
+    break;
+  case Type::real32:
+    m_real32.reserve(count);
+    break;
+  case Type::real64:
+    m_real64.reserve(count);
+    break;
+  case Type::integer64:
+  case Type::label:
+    m_integer64.reserve(count);
+    break;
+  case Type::timestamp:
+    // the packed size depends on the values
+    break;
+  }
+  return *this;
+}
+
+ChartJsDataColumn &ChartJsDataColumn::set_capacity(size_t capacity,
+                                                   Type type) {
+  clear();
+  // replacing the oldest value of packed timestamps would repack the column
+  m_type = type == Type::timestamp ? Type::integer64 : type;
+  m_capacity = capacity;
+  reserve(capacity);
+  return *this;
+}
+
+ChartJsDataColumn &ChartJsDataColumn::clear() {
+  // a rolling column keeps its type and storage
+  if (m_capacity == 0) {
+    m_type = Type::none;
+  }
+  m_head = 0;
+  m_real32.clear();
+  m_real64.clear();
+  m_integer64.clear();
+  m_timestamp_count = 0;
+  m_regular_count = 0;
+  m_delta_list.clear();
+  m_checkpoint_list.clear();
+  m_cursor_offset = 0;
+  return *this;
+}
+
+void ChartJsDataColumn::push_timestamp(s64 value) {
+  m_sequence++;
+  const size_t offset = m_timestamp_count++;
+  if (offset == 0) {
+    m_first = value;
+    m_step = 0;
+    m_regular_count = 1;
+  } else if (offset == 1) {
+    m_step = value - m_first;
+    m_regular_count = 2;
+  } else if (m_regular_count == offset && value - m_last == m_step) {
+    m_regular_count++;
+  } else {
+    const size_t irregular_offset = offset - m_regular_count;
+    if (irregular_offset % timestamp_checkpoint_interval == 0) {
+      m_checkpoint_list.push_back({m_last, m_delta_list.count()});
+    }
+    // zigzag so small differences of either sign take one byte
+    const s64 difference = value - m_last - m_step;
+    u64 bits = (u64(difference) << 1) ^ u64(difference >> 63);
+    while (bits >= 0x80) {
+      m_delta_list.push_back(u8(bits | 0x80));
+      bits >>= 7;
+    }
+    m_delta_list.push_back(u8(bits));
+  }
+  m_last = value;
+}
+
+s64 ChartJsDataColumn::get_irregular_timestamp(size_t offset) const {
+  const size_t irregular_offset = offset - m_regular_count;
+  const TimestampCheckpoint &checkpoint = m_checkpoint_list.at(
+    irregular_offset / timestamp_checkpoint_interval);
+  // the value of m_cursor_offset is m_cursor_value and the entry of the
+  // next value is at m_cursor_position
+  size_t current
+    = offset - irregular_offset % timestamp_checkpoint_interval - 1;
+  s64 value = checkpoint.value;
+  size_t position = checkpoint.position;
+  if (m_cursor_offset >= current && m_cursor_offset <= offset
+      && m_cursor_offset >= m_regular_count) {
+    current = m_cursor_offset;
+    value = m_cursor_value;
+    position = m_cursor_position;
+  }
+
+  while (current < offset) {
+    u64 bits = 0;
+    u32 shift = 0;
+    u8 byte;
+    do {
+      byte = m_delta_list.at(position++);
+      bits |= u64(byte & 0x7f) << shift;
+      shift += 7;
+    } while (byte & 0x80);
+    value += m_step + s64((bits >> 1) ^ (~(bits & 1) + 1));
+    current++;
+  }
+
+  m_cursor_offset = current;
+  m_cursor_value = value;
+  m_cursor_position = position;
+  return value;
+}
+
+json::JsonValue ChartJsDataColumn::to_value(size_t offset) const {
+  if (m_type == Type::label) {
+    return json::JsonString(label_at(offset));
+  }
+
+  if (is_integer()) {
+    return ChartJsWriter::create_integer(integer_at(offset));
+  }
+
+  // jansson cannot represent inf/nan, chart.js treats null as a gap
+  const double value = at(offset);
+  if (!std::isfinite(value)) {
+    return json::JsonNull();
+  }
+
+  if (m_type == Type::real32) {
+    return json::JsonReal(m_real32.at(get_position(offset)));
+  }
+  return json::JsonReal(value);
+}
+
+const ChartJsDataColumn &ChartJsDataColumn::write(ChartJsWriter &writer,
+                                                  size_t offset) const {
+  switch (m_type) {
+  case Type::none:
+    break;
+  case Type::real32:
+    writer.write_real(m_real32.at(get_position(offset)));
+    break;
+  case Type::real64:
+    writer.write_real(m_real64.at(get_position(offset)));
+    break;
+  case Type::integer64:
+    writer.write_integer(m_integer64.at(get_position(offset)));
+    break;
+  case Type::timestamp:
+    writer.write_integer(timestamp_at(offset));
+    break;
+  case Type::label:
+    writer.write_string(label_at(offset));
+    break;
+  }
+  return *this;
+}
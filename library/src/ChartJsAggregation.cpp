@@ -0,0 +1,426 @@
+// Copyright 2020-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <cmath>
+
+#include "chart/ChartJsAggregation.hpp"
+
+using namespace chart;
+using namespace var;
+
+namespace {
+// magnitudes below this are counted as zero by the quantile sketch
+constexpr double minimum_magnitude = 1e-300;
+} // namespace
+
+ChartJsQuantileSketch::ChartJsQuantileSketch(double relative_accuracy)
+  : m_relative_accuracy(relative_accuracy),
+    m_gamma((1.0 + relative_accuracy) / (1.0 - relative_accuracy)),
+    m_log_gamma(log(m_gamma)) {}
+
+ChartJsQuantileSketch &ChartJsQuantileSketch::append(double value) {
+  if (std::isnan(value)) {
+    return *this;
+  }
+
+  if (m_count == 0) {
+    m_minimum = value;
+    m_maximum = value;
+  } else {
+    m_minimum = value < m_minimum ? value : m_minimum;
+    m_maximum = value > m_maximum ? value : m_maximum;
+  }
+  m_count++;
+
+  if (value > minimum_magnitude) {
+    m_positive.add(get_bin(value), 1);
+  } else if (value < -minimum_magnitude) {
+    m_negative.add(get_bin(-value), 1);
+  } else {
+    m_zero_count++;
+  }
+  return *this;
+}
+
+ChartJsQuantileSketch &ChartJsQuantileSketch::append(const float *values,
+                                                     size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    append(double(values[i]));
+  }
+  return *this;
+}
+
+ChartJsQuantileSketch &ChartJsQuantileSketch::append(const double *values,
+                                                     size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    append(values[i]);
+  }
+  return *this;
+}
+
+ChartJsQuantileSketch &
+ChartJsQuantileSketch::merge(const ChartJsQuantileSketch &sketch) {
+  if (sketch.is_empty()) {
+    return *this;
+  }
+  if (is_empty()) {
+    m_minimum = sketch.minimum();
+    m_maximum = sketch.maximum();
+  } else {
+    m_minimum = sketch.minimum() < m_minimum ? sketch.minimum() : m_minimum;
+    m_maximum = sketch.maximum() > m_maximum ? sketch.maximum() : m_maximum;
+  }
+  m_positive.merge(sketch.m_positive);
+  m_negative.merge(sketch.m_negative);
+  m_zero_count += sketch.m_zero_count;
+  m_count += sketch.m_count;
+  return *this;
+}
+
+ChartJsQuantileSketch &ChartJsQuantileSketch::clear() {
+  m_positive.clear();
+  m_negative.clear();
+  m_zero_count = 0;
+  m_count = 0;
+  m_minimum = 0.0;
+  m_maximum = 0.0;
+  return *this;
+}
+
+double ChartJsQuantileSketch::quantile(double value) const {
+  if (m_count == 0) {
+    return NAN;
+  }
+  if (value <= 0.0) {
+    return m_minimum;
+  }
+  if (value >= 1.0) {
+    return m_maximum;
+  }
+
+  // the bin value can be just outside the range that was appended
+  const double result = get_rank_value(u64(value * double(m_count - 1)));
+  return result < m_minimum ? m_minimum
+                            : (result > m_maximum ? m_maximum : result);
+}
+
+double ChartJsQuantileSketch::get_rank_value(u64 rank) const {
+  u64 total = 0;
+
+  // the most negative values are in the highest negative bins
+  const Vector<u64> &negative_list = m_negative.count_list();
+  for (size_t i = negative_list.count(); i > 0; i--) {
+    total += negative_list.at(i - 1);
+    if (total > rank) {
+      return -get_bin_value(m_negative.first_bin() + s32(i - 1));
+    }
+  }
+
+  total += m_zero_count;
+  if (total > rank) {
+    return 0.0;
+  }
+
+  const Vector<u64> &positive_list = m_positive.count_list();
+  for (size_t i = 0; i < positive_list.count(); i++) {
+    total += positive_list.at(i);
+    if (total > rank) {
+      return get_bin_value(m_positive.first_bin() + s32(i));
+    }
+  }
+  return m_maximum;
+}
+
+s32 ChartJsQuantileSketch::get_bin(double magnitude) const {
+  return s32(ceil(log(magnitude) / m_log_gamma));
+}
+
+double ChartJsQuantileSketch::get_bin_value(s32 bin) const {
+  // the bin holds (gamma^(bin-1), gamma^bin], this is within
+  // relative_accuracy() of both ends
+  return 2.0 * pow(m_gamma, bin) / (m_gamma + 1.0);
+}
+
+void ChartJsQuantileSketch::Store::add(s32 bin, u64 count) {
+  if (m_count_list.count() == 0) {
+    m_first_bin = bin;
+    m_count_list.push_back(0);
+  }
+
+  const s32 last_bin = m_first_bin + s32(m_count_list.count()) - 1;
+  if (bin < m_first_bin) {
+    // values closer to zero than the collapsed range join the first bin
+    const s32 lowest_bin = last_bin - s32(maximum_bin_count) + 1;
+    if (bin < lowest_bin) {
+      bin = lowest_bin;
+      m_is_collapsed = true;
+    }
+    if (bin < m_first_bin) {
+      const size_t shift = size_t(m_first_bin - bin);
+      Vector<u64> count_list;
+      count_list.reserve(m_count_list.count() + shift);
+      count_list.resize(shift);
+      for (const u64 value : m_count_list) {
+        count_list.push_back(value);
+      }
+      for (size_t i = 0; i < shift; i++) {
+        count_list.at(i) = 0;
+      }
+      m_count_list = std::move(count_list);
+      m_first_bin = bin;
+    }
+  } else if (bin > last_bin) {
+    m_count_list.resize(size_t(bin - m_first_bin) + 1);
+    for (size_t i = size_t(last_bin - m_first_bin) + 1;
+         i < m_count_list.count();
+         i++) {
+      m_count_list.at(i) = 0;
+    }
+    if (m_count_list.count() > maximum_bin_count) {
+      // collapse the bins closest to zero into the new first bin
+      const size_t collapse_count = m_count_list.count() - maximum_bin_count;
+      u64 collapsed = 0;
+      for (size_t i = 0; i < collapse_count; i++) {
+        collapsed += m_count_list.at(i);
+      }
+      m_count_list.remove(0, collapse_count);
+      m_count_list.at(0) += collapsed;
+      m_first_bin += s32(collapse_count);
+      m_is_collapsed = true;
+    }
+  }
+
+  m_count_list.at(size_t(bin - m_first_bin)) += count;
+  m_total += count;
+}
+
+void ChartJsQuantileSketch::Store::merge(const Store &store) {
+  m_is_collapsed = m_is_collapsed || store.is_collapsed();
+  for (size_t i = 0; i < store.count_list().count(); i++) {
+    if (store.count_list().at(i)) {
+      add(store.first_bin() + s32(i), store.count_list().at(i));
+    }
+  }
+}
+
+ChartJsHistogram::ChartJsHistogram(double minimum, double maximum,
+                                   size_t bin_count)
+  : m_minimum(minimum), m_maximum(maximum),
+    m_scale(maximum > minimum ? bin_count / (maximum - minimum) : 0.0) {
+  m_bin_list.resize(bin_count ? bin_count : 1);
+  clear();
+}
+
+ChartJsHistogram &ChartJsHistogram::append(const float *values,
+                                           size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    append(double(values[i]));
+  }
+  return *this;
+}
+
+ChartJsHistogram &ChartJsHistogram::append(const double *values,
+                                           size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    append(values[i]);
+  }
+  return *this;
+}
+
+ChartJsHistogram &ChartJsHistogram::clear() {
+  for (u64 &count : m_bin_list) {
+    count = 0;
+  }
+  m_underflow = 0;
+  m_overflow = 0;
+  return *this;
+}
+
+ChartJsDataSet ChartJsHistogram::create_dataset() const {
+  ChartJsDataSet result;
+  result.y_column().reserve(bin_count());
+  for (const u64 count : m_bin_list) {
+    result.append_point(s64(count));
+  }
+  return result;
+}
+
+ChartJsDataSet ChartJsHistogram::create_point_dataset() const {
+  ChartJsDataSet result;
+  result.reserve_points(bin_count());
+  const double width = bin_width();
+  for (size_t i = 0; i < bin_count(); i++) {
+    result.append_point(m_minimum + (i + 0.5) * width,
+                        double(m_bin_list.at(i)));
+  }
+  return result;
+}
+
+const ChartJsHistogram &
+ChartJsHistogram::append_labels(ChartJsData &data) const {
+  const double width = bin_width();
+  for (size_t i = 0; i < bin_count(); i++) {
+    data.append_label(GeneralString()
+                        .format("%g-%g", m_minimum + i * width,
+                                m_minimum + (i + 1) * width)
+                        .string_view());
+  }
+  return *this;
+}
+
+ChartJsTimeAggregation &ChartJsTimeAggregation::append(s64 timestamp,
+                                                       double value) {
+  if (std::isnan(value)) {
+    return *this;
+  }
+  if (m_count == 0 || timestamp >= m_bucket_start + width()) {
+    open(timestamp);
+  }
+  accumulate(value);
+  return *this;
+}
+
+ChartJsTimeAggregation &ChartJsTimeAggregation::append(const s64 *timestamps,
+                                                       const float *values,
+                                                       size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    append(timestamps[i], double(values[i]));
+  }
+  return *this;
+}
+
+ChartJsTimeAggregation &ChartJsTimeAggregation::append(const s64 *timestamps,
+                                                       const double *values,
+                                                       size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    append(timestamps[i], values[i]);
+  }
+  return *this;
+}
+
+ChartJsTimeAggregation &ChartJsTimeAggregation::flush() {
+  if (m_count == 0) {
+    return *this;
+  }
+
+  for (size_t i = 0; i < m_statistic_list.count(); i++) {
+    const StatisticEntry &entry = m_statistic_list.at(i);
+    double value = 0.0;
+    switch (entry.statistic) {
+    case Statistic::count:
+      value = double(m_count);
+      break;
+    case Statistic::sum:
+      value = m_sum;
+      break;
+    case Statistic::mean:
+      value = m_sum / double(m_count);
+      break;
+    case Statistic::minimum:
+      value = m_minimum;
+      break;
+    case Statistic::maximum:
+      value = m_maximum;
+      break;
+    case Statistic::quantile:
+      value = m_sketch.quantile(entry.quantile);
+      break;
+    }
+    ChartJsDataSet &dataset = m_dataset_list.at(i);
+    dataset.x_column().append(m_bucket_start);
+    dataset.y_column().append(value);
+  }
+
+  m_bucket_count++;
+  m_count = 0;
+  m_sum = 0.0;
+  m_sketch.clear();
+  return *this;
+}
+
+ChartJsTimeAggregation &ChartJsTimeAggregation::clear() {
+  m_dataset_list.clear();
+  m_bucket_count = 0;
+  m_count = 0;
+  m_sum = 0.0;
+  m_sketch.clear();
+  return *this;
+}
+
+ChartJsTimeAggregation &
+ChartJsTimeAggregation::append_datasets(ChartJsData &data) {
+  flush();
+  for (const ChartJsDataSet &dataset : m_dataset_list) {
+    data.append(dataset);
+  }
+  return *this;
+}
+
+const char *ChartJsTimeAggregation::get_unit(s64 width) {
+  switch (width) {
+  case 1:
+    return "millisecond";
+  case second:
+    return "second";
+  case minute:
+    return "minute";
+  case hour:
+    return "hour";
+  case day:
+    return "day";
+  case 7 * day:
+    return "week";
+  }
+  return nullptr;
+}
+
+s64 ChartJsTimeAggregation::get_bucket_start(s64 timestamp) const {
+  const s64 offset = timestamp - origin();
+  // round toward negative infinity for timestamps before origin
+  s64 bucket = offset / width();
+  if (offset % width() < 0) {
+    bucket--;
+  }
+  return origin() + bucket * width();
+}
+
+void ChartJsTimeAggregation::open(s64 timestamp) {
+  if (m_dataset_list.count() != m_statistic_list.count()) {
+    // the first bucket or a statistic was added since the last bucket
+    // (the buckets so far are dropped, see add_statistic())
+    m_dataset_list.clear();
+    m_bucket_count = 0;
+    m_is_quantile = false;
+    for (const StatisticEntry &entry : m_statistic_list) {
+      ChartJsDataSet dataset;
+      switch (entry.statistic) {
+      case Statistic::count:
+        dataset.set_label("count");
+        break;
+      case Statistic::sum:
+        dataset.set_label("sum");
+        break;
+      case Statistic::mean:
+        dataset.set_label("mean");
+        break;
+      case Statistic::minimum:
+        dataset.set_label("minimum");
+        break;
+      case Statistic::maximum:
+        dataset.set_label("maximum");
+        break;
+      case Statistic::quantile:
+        dataset.set_label(
+          NumberString(entry.quantile * 100.0, "p%g").string_view());
+        m_is_quantile = true;
+        break;
+      }
+      // regular buckets cost the same at any count
+      dataset.x_column().set_type(ChartJsDataColumn::Type::timestamp);
+      m_dataset_list.push_back(dataset);
+    }
+    m_sketch = ChartJsQuantileSketch(relative_accuracy());
+  }
+
+  flush();
+  m_bucket_start = get_bucket_start(timestamp);
+}
@@ -0,0 +1,163 @@
+// Copyright 2020-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <cstdlib>
+
+#include <json/Json.hpp>
+
+#include "chart/ChartJsArena.hpp"
+
+using namespace chart;
+
+namespace {
+ChartJsArena::Scope *scope = nullptr;
+// number of active heap scopes
+size_t heap_scope_count = 0;
+// the jansson functions before the outermost scope
+json_malloc_t heap_malloc = nullptr;
+json_free_t heap_free = nullptr;
+
+size_t get_aligned(size_t size) {
+  return (size + ChartJsArena::alignment - 1) & ~(ChartJsArena::alignment - 1);
+}
+} // namespace
+
+ChartJsArena::ChartJsArena(size_t block_size)
+  : m_next_block_size(get_aligned(block_size ? block_size : 1)) {}
+
+ChartJsArena::ChartJsArena(var::View buffer)
+  : m_is_buffer(true), m_next_block_size(0) {
+  // the start of the buffer is aligned so allocations are too
+  const size_t skip
+    = (alignment - reinterpret_cast<size_t>(buffer.to_u8()) % alignment)
+      % alignment;
+  m_buffer_block.next = nullptr;
+  m_buffer_block.data = buffer.to_u8() + skip;
+  m_buffer_block.size = buffer.size() > skip ? buffer.size() - skip : 0;
+  m_buffer_block.used = 0;
+  m_block = &m_buffer_block;
+  m_block_count = 1;
+  m_capacity = m_buffer_block.size;
+}
+
+ChartJsArena::~ChartJsArena() { release_blocks(nullptr); }
+
+void *ChartJsArena::allocate(size_t size) {
+  size = get_aligned(size ? size : 1);
+  if (m_block == nullptr || m_block->size - m_block->used < size) {
+    if (m_is_buffer) {
+      return nullptr;
+    }
+    while (m_next_block_size < size) {
+      m_next_block_size *= 2;
+    }
+    if (create_block(m_next_block_size) == nullptr) {
+      return nullptr;
+    }
+    m_next_block_size *= 2;
+  }
+
+  void *result = m_block->data + m_block->used;
+  m_block->used += size;
+  m_used += size;
+  return result;
+}
+
+bool ChartJsArena::contains(const void *pointer) const {
+  const u8 *value = reinterpret_cast<const u8 *>(pointer);
+  // the newest (and largest) block is first
+  for (const Block *block = m_block; block != nullptr; block = block->next) {
+    if (value >= block->data && value < block->data + block->size) {
+      return true;
+    }
+  }
+  return false;
+}
+
+ChartJsArena &ChartJsArena::reset() {
+  Block *first = m_block;
+  while (first != nullptr && first->next != nullptr) {
+    first = first->next;
+  }
+  release_blocks(first);
+  if (first != nullptr) {
+    first->used = 0;
+    m_block = first;
+    m_block_count = 1;
+    m_capacity = first->size;
+  }
+  m_used = 0;
+  m_overflow_count = 0;
+  return *this;
+}
+
+ChartJsArena::Block *ChartJsArena::create_block(size_t size) {
+  // the header and data are one allocation
+  const size_t header_size = get_aligned(sizeof(Block));
+  u8 *memory = reinterpret_cast<u8 *>(malloc(header_size + size));
+  if (memory == nullptr) {
+    return nullptr;
+  }
+  Block *block = reinterpret_cast<Block *>(memory);
+  block->next = m_block;
+  block->data = memory + header_size;
+  block->size = size;
+  block->used = 0;
+  m_block = block;
+  m_block_count++;
+  m_capacity += size;
+  return block;
+}
+
+void ChartJsArena::release_blocks(Block *last) {
+  while (m_block != nullptr && m_block != last) {
+    Block *next = m_block->next;
+    if (m_block != &m_buffer_block) {
+      free(m_block);
+    }
+    m_block = next;
+  }
+}
+
+ChartJsArena::Scope::Scope(ChartJsArena &arena)
+  : m_arena(arena), m_previous(scope) {
+  if (m_previous == nullptr) {
+    json_get_alloc_funcs(&heap_malloc, &heap_free);
+    json_set_alloc_funcs(
+      [](size_t size) -> void * {
+        if (heap_scope_count) {
+          return heap_malloc(size);
+        }
+        void *result = scope->m_arena.allocate(size);
+        if (result == nullptr) {
+          scope->m_arena.m_overflow_count++;
+          return heap_malloc(size);
+        }
+        return result;
+      },
+      [](void *pointer) {
+        for (const Scope *item = scope; item != nullptr;
+             item = item->m_previous) {
+          if (item->m_arena.contains(pointer)) {
+            return;
+          }
+        }
+        heap_free(pointer);
+      });
+  }
+  scope = this;
+}
+
+ChartJsArena::Scope::~Scope() {
+  scope = m_previous;
+  if (scope == nullptr) {
+    json_set_alloc_funcs(heap_malloc, heap_free);
+  }
+}
+
+ChartJsArena::HeapScope::HeapScope() { heap_scope_count++; }
+
+ChartJsArena::HeapScope::~HeapScope() { heap_scope_count--; }
+
+ChartJsArena *ChartJsArena::active() {
+  return scope != nullptr ? &scope->m_arena : nullptr;
+}
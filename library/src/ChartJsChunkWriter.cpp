@@ -0,0 +1,445 @@
+// Copyright 2020-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <cstring>
+
+#include "chart/ChartJsChunkWriter.hpp"
+
+using namespace chart;
+
+size_t ChartJsChunkWriter::write(var::View buffer) {
+  Output output
+    = {reinterpret_cast<char *>(buffer.to_u8()), buffer.size(), 0, 0, 0, false};
+  while (m_stage != Stage::complete && output.length < output.capacity) {
+    bool is_written;
+    if (m_stage == Stage::point) {
+      is_written = write_points(output);
+    } else if (m_stage == Stage::source_point) {
+      is_written = write_source_points(output);
+    } else if (m_stage == Stage::encoded_value) {
+      is_written = write_encoded_values(output);
+    } else {
+      is_written = write_item(output);
+    }
+    if (!is_written) {
+      break;
+    }
+  }
+  m_size += output.length;
+  return output.length;
+}
+
+template <typename Function>
+bool ChartJsChunkWriter::write_part(Output &output, Function function) {
+  const size_t start = output.length;
+  output.skip = m_item_offset;
+  output.produced = 0;
+  output.is_truncated = false;
+  {
+    ChartJsWriter writer(&output, write_output);
+    writer.set_real_format(get_format());
+    function(writer);
+  }
+  if (output.is_truncated) {
+    m_item_offset += output.length - start;
+    return false;
+  }
+  m_item_offset = 0;
+  return true;
+}
+
+bool ChartJsChunkWriter::write_item(Output &output) {
+  const ChartJsData &data = m_chart.data();
+  switch (m_stage) {
+  case Stage::head:
+    if (!write_part(output, [&](ChartJsWriter &) {
+          write_literal(output, "{\"type\":\"");
+          write_literal(output, ChartJs::convert_type_to_string(m_chart.type()));
+          write_literal(output, "\",\"options\":");
+        })) {
+      return false;
+    }
+    m_stage = Stage::options;
+    return true;
+
+  case Stage::options:
+    if (!write_part(output, [&](ChartJsWriter &writer) {
+          if (m_options_fragment.length()) {
+            write_literal(output, m_options_fragment);
+          } else {
+            m_chart.options().write(writer);
+          }
+        })) {
+      return false;
+    }
+    m_stage = Stage::labels;
+    return true;
+
+  case Stage::labels:
+    if (!write_part(output, [&](ChartJsWriter &) {
+          write_literal(output, ",\"data\":{\"labels\":[");
+        })) {
+      return false;
+    }
+    m_index = 0;
+    m_stage = data.label_count() ? Stage::label : Stage::datasets;
+    return true;
+
+  case Stage::label:
+    if (!write_part(output, [&](ChartJsWriter &writer) {
+          if (m_index) {
+            write_literal(output, ",");
+          }
+          writer.write_string(data.label_at(m_index));
+        })) {
+      return false;
+    }
+    if (++m_index == data.label_count()) {
+      m_stage = Stage::datasets;
+    }
+    return true;
+
+  case Stage::datasets:
+    if (!write_part(output, [&](ChartJsWriter &) {
+          write_literal(output, "],\"datasets\":[");
+        })) {
+      return false;
+    }
+    m_index = 0;
+    m_stage = data.dataset_list().count() ? Stage::dataset : Stage::tail;
+    return true;
+
+  default:
+    break;
+  }
+
+  if (m_stage == Stage::tail) {
+    if (!write_part(
+          output, [&](ChartJsWriter &) { write_literal(output, "]}}"); })) {
+      return false;
+    }
+    m_stage = Stage::complete;
+    return true;
+  }
+
+  const ChartJsDataSet &dataset = data.dataset_list().at(m_index);
+  const ChartJsRealFormat format = dataset.real_format().resolve(get_format());
+  switch (m_stage) {
+  case Stage::dataset:
+    if (!write_part(output, [&](ChartJsWriter &writer) {
+          if (m_index) {
+            write_literal(output, ",");
+          }
+          writer.set_real_format(format).begin_object();
+          // the cached properties if they are current, otherwise they are
+          // written directly rather than cached on the heap
+          if (dataset.m_is_properties_fragment_valid
+              && dataset.m_properties_real_format == format) {
+            writer.write_fragment(dataset.m_properties_fragment.string_view());
+          } else {
+            dataset.insert_properties(writer);
+          }
+          writer.write_key("data").begin_array();
+        })) {
+      return false;
+    }
+    m_point = 0;
+    m_stage = dataset.data().count() ? Stage::value : Stage::point;
+    return true;
+
+  case Stage::value:
+    if (!write_part(output, [&](ChartJsWriter &writer) {
+          if (m_point) {
+            write_literal(output, ",");
+          }
+          writer.set_real_format(format).write_value(
+            dataset.data().at(m_point));
+        })) {
+      return false;
+    }
+    if (++m_point == dataset.data().count()) {
+      m_point = 0;
+      m_stage = Stage::point;
+    }
+    return true;
+
+  case Stage::dataset_tail: {
+    const bool is_encoded
+      = dataset.data_encoding() != ChartJsDataSet::DataEncoding::json
+        && dataset.point_count();
+    if (!write_part(output, [&](ChartJsWriter &) {
+          write_literal(output, "]");
+          write_literal(output, is_encoded ? ",\"encodedData\":{" : "}");
+        })) {
+      return false;
+    }
+    if (is_encoded) {
+      m_column = dataset.is_point_xy() ? 0 : 1;
+      m_stage = Stage::encoded_column;
+    } else {
+      next_dataset();
+    }
+    return true;
+  }
+
+  case Stage::encoded_column: {
+    ChartJsDataSet::EncodedColumnCursor cursor;
+    bool is_values = false;
+    if (!write_part(output, [&](ChartJsWriter &writer) {
+          if (m_column && dataset.is_point_xy()) {
+            write_literal(output, ",");
+          }
+          write_literal(output, m_column ? "\"y\":" : "\"x\":");
+          is_values = dataset.write_encoded_column_head(
+            writer.set_real_format(format), get_encoded_column(dataset),
+            cursor);
+        })) {
+      return false;
+    }
+    m_encoded = cursor;
+    if (is_values) {
+      m_stage = Stage::encoded_value;
+    } else {
+      next_encoded_column();
+    }
+    return true;
+  }
+
+  case Stage::encoded_column_tail:
+    if (!write_part(output, [&](ChartJsWriter &writer) {
+          dataset.write_encoded_column_tail(writer, m_encoded);
+          writer.flush();
+          write_literal(output, "\"}");
+        })) {
+      return false;
+    }
+    next_encoded_column();
+    return true;
+
+  case Stage::encoded_tail:
+    if (!write_part(output, [&](ChartJsWriter &writer) {
+          write_literal(output, ",\"count\":");
+          writer.write_integer(s64(m_encoded.count)).flush();
+          write_literal(output, "}}");
+        })) {
+      return false;
+    }
+    next_dataset();
+    return true;
+
+  default:
+    break;
+  }
+  return true;
+}
+
+bool ChartJsChunkWriter::write_points(Output &output) {
+  const ChartJsDataSet &dataset = m_chart.data().dataset_list().at(m_index);
+  if (dataset.data_encoding() != ChartJsDataSet::DataEncoding::json) {
+    m_stage = get_points_next_stage(dataset);
+    return true;
+  }
+
+  const ChartJsRealFormat format = dataset.real_format().resolve(get_format());
+  const size_t value_count = dataset.data().count();
+  auto write_point = [&](size_t offset) {
+    return write_part(output, [&](ChartJsWriter &writer) {
+      if (value_count + m_point) {
+        write_literal(output, ",");
+      }
+      dataset.write_point(writer.set_real_format(format), offset);
+    });
+  };
+
+  if (!dataset.decimation().is_active(dataset.point_count())
+      && !dataset.transform().is_active()) {
+    while (m_point < dataset.point_count()) {
+      if (output.length == output.capacity || !write_point(m_point)) {
+        return false;
+      }
+      m_point++;
+    }
+  } else {
+    // the selection and the derived values are not random access, they
+    // are calculated again and the points written to earlier buffers are
+    // skipped
+    ChartJsTransform::Evaluator evaluator(
+      dataset.transform(), dataset.x_column(), dataset.y_column(),
+      dataset.point_count());
+    auto write_derived_point = [&](size_t offset) {
+      return write_part(output, [&](ChartJsWriter &writer) {
+        if (value_count + m_point) {
+          write_literal(output, ",");
+        }
+        dataset.write_point(
+          writer.set_real_format(format), offset, evaluator.at(offset));
+      });
+    };
+    struct Context {
+      ChartJsChunkWriter *self;
+      Output *output;
+      decltype(write_point) *write;
+      decltype(write_derived_point) *write_derived;
+      size_t index;
+      bool is_derived;
+      bool is_full;
+    } context = {this,
+                 &output,
+                 &write_point,
+                 &write_derived_point,
+                 0,
+                 dataset.transform().is_active(),
+                 false};
+    dataset.decimation().select(
+      dataset.x_column(), dataset.y_column(), dataset.point_count(), &context,
+      [](void *context, size_t offset) {
+        Context *c = reinterpret_cast<Context *>(context);
+        if (c->index++ < c->self->m_point || c->is_full) {
+          return;
+        }
+        if (c->output->length == c->output->capacity
+            || !(c->is_derived ? (*c->write_derived)(offset)
+                               : (*c->write)(offset))) {
+          c->is_full = true;
+          return;
+        }
+        c->self->m_point++;
+      });
+    if (context.is_full) {
+      return false;
+    }
+  }
+
+  m_stage = get_points_next_stage(dataset);
+  return true;
+}
+
+bool ChartJsChunkWriter::write_source_points(Output &output) {
+  const ChartJsDataSet &dataset = m_chart.data().dataset_list().at(m_index);
+  const ChartJsPointSource &source = dataset.point_source();
+  const ChartJsRealFormat format = dataset.real_format().resolve(get_format());
+  // m_point is the number of columnar points written
+  const size_t previous_count = dataset.data().count() + m_point;
+
+  // the block is read again from the first point of each buffer
+  ChartJsPointSource::Value x_list[ChartJsPointSource::block_size];
+  ChartJsPointSource::Value y_list[ChartJsPointSource::block_size];
+  while (const size_t count
+         = source.read(m_source_cursor, m_source_point, x_list, y_list)) {
+    for (size_t i = 0; i < count; i++) {
+      if (output.length == output.capacity
+          || !write_part(output, [&](ChartJsWriter &writer) {
+               if (previous_count + m_source_point) {
+                 write_literal(output, ",");
+               }
+               source.write_point(
+                 writer.set_real_format(format), x_list[i], y_list[i]);
+             })) {
+        return false;
+      }
+      m_source_point++;
+    }
+  }
+
+  m_stage = Stage::dataset_tail;
+  return true;
+}
+
+bool ChartJsChunkWriter::write_encoded_values(Output &output) {
+  const ChartJsDataSet &dataset = m_chart.data().dataset_list().at(m_index);
+  const ChartJsDataColumn &column = get_encoded_column(dataset);
+  // the cursor advances only once the whole value is written
+  auto write_value = [&](size_t offset,
+                         ChartJsTransform::Evaluator *evaluator) {
+    ChartJsDataSet::EncodedColumnCursor cursor;
+    if (!write_part(output, [&](ChartJsWriter &writer) {
+          cursor = m_encoded;
+          dataset.write_encoded_value(writer, column, offset, evaluator,
+                                      cursor);
+        })) {
+      return false;
+    }
+    m_encoded = cursor;
+    return true;
+  };
+
+  if (!dataset.decimation().is_active(dataset.point_count())
+      && !dataset.transform().is_active()) {
+    while (m_encoded.count < dataset.point_count()) {
+      if (output.length == output.capacity
+          || !write_value(m_encoded.count, nullptr)) {
+        return false;
+      }
+    }
+  } else {
+    // the values written to earlier buffers are selected (and derived)
+    // again but not encoded
+    ChartJsTransform::Evaluator evaluator(
+      dataset.transform(), dataset.x_column(), dataset.y_column(),
+      dataset.point_count());
+    struct Context {
+      ChartJsChunkWriter *self;
+      Output *output;
+      decltype(write_value) *write;
+      ChartJsTransform::Evaluator *evaluator;
+      size_t index;
+      bool is_full;
+    } context = {this, &output, &write_value, &evaluator, 0, false};
+    dataset.decimation().select(
+      dataset.x_column(), dataset.y_column(), dataset.point_count(), &context,
+      [](void *context, size_t offset) {
+        Context *c = reinterpret_cast<Context *>(context);
+        if (c->index++ < c->self->m_encoded.count || c->is_full) {
+          return;
+        }
+        if (c->output->length == c->output->capacity
+            || !(*c->write)(offset, c->evaluator)) {
+          c->is_full = true;
+        }
+      });
+    if (context.is_full) {
+      return false;
+    }
+  }
+
+  m_stage = Stage::encoded_column_tail;
+  return true;
+}
+
+void ChartJsChunkWriter::next_encoded_column() {
+  if (m_column == 0) {
+    m_column = 1;
+    m_stage = Stage::encoded_column;
+  } else {
+    m_stage = Stage::encoded_tail;
+  }
+}
+
+void ChartJsChunkWriter::next_dataset() {
+  m_point = 0;
+  m_source_point = 0;
+  m_source_cursor.reset();
+  m_stage = ++m_index < m_chart.data().dataset_list().count() ? Stage::dataset
+                                                              : Stage::tail;
+}
+
+void ChartJsChunkWriter::write_output(void *context,
+                                      const char *data,
+                                      size_t size) {
+  Output *output = reinterpret_cast<Output *>(context);
+  // the start of the item was written to an earlier buffer
+  size_t offset = 0;
+  if (output->produced < output->skip) {
+    offset = output->skip - output->produced;
+    offset = offset < size ? offset : size;
+  }
+  output->produced += size;
+
+  const size_t available = output->capacity - output->length;
+  size_t length = size - offset;
+  if (length > available) {
+    length = available;
+    output->is_truncated = true;
+  }
+  memcpy(output->data + output->length, data + offset, length);
+  output->length += length;
+}
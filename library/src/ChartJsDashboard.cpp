@@ -0,0 +1,276 @@
+// Copyright 2020-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <cstring>
+
+#include "chart/ChartJsDashboard.hpp"
+
+using namespace chart;
+
+namespace {
+const u64 fnv_offset_basis = 14695981039346656037ULL;
+const u64 fnv_prime = 1099511628211ULL;
+
+u64 update_hash(u64 hash, u64 value) { return (hash ^ value) * fnv_prime; }
+
+u64 update_hash(u64 hash, var::StringView value) {
+  for (size_t i = 0; i < value.length(); i++) {
+    hash = (hash ^ u8(value.data()[i])) * fnv_prime;
+  }
+  // the length separates "ab","c" from "a","bc"
+  return update_hash(hash, value.length());
+}
+
+// the bits are compared so -0.0 and 0.0 (written differently) are not
+// the same value
+u64 get_value_bits(const chart::ChartJsDataColumn &column, size_t offset) {
+  if (column.is_integer()) {
+    return u64(column.integer_at(offset));
+  }
+  const double value = column.at(offset);
+  u64 result;
+  memcpy(&result, &value, sizeof(result));
+  return result;
+}
+
+u64 update_hash(u64 hash, const chart::ChartJsDataColumn &column) {
+  hash = update_hash(hash, u64(column.type()));
+  hash = update_hash(hash, column.count());
+  for (size_t i = 0; i < column.count(); i++) {
+    hash = update_hash(hash, get_value_bits(column, i));
+  }
+  return hash;
+}
+
+bool is_equal(const chart::ChartJsDataColumn &a,
+              const chart::ChartJsDataColumn &b) {
+  // label ids are only compared in the same table
+  if (a.type() != b.type() || a.count() != b.count()
+      || a.label_table() != b.label_table()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.count(); i++) {
+    if (get_value_bits(a, i) != get_value_bits(b, i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+u64 get_label_hash(const chart::ChartJsData &data) {
+  u64 result = update_hash(fnv_offset_basis, data.label_count());
+  for (size_t i = 0; i < data.label_count(); i++) {
+    result = update_hash(result, data.label_at(i));
+  }
+  return result;
+}
+
+bool is_label_equal(const chart::ChartJsData &a, const chart::ChartJsData &b) {
+  if (a.label_count() != b.label_count()) {
+    return false;
+  }
+  if (a.label_table() && a.label_table() == b.label_table()) {
+    for (size_t i = 0; i < a.label_count(); i++) {
+      if (a.label_id_at(i) != b.label_id_at(i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  for (size_t i = 0; i < a.label_count(); i++) {
+    if (a.label_at(i) != b.label_at(i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// json values and source points are not compared, datasets with them are
+// not shared
+bool is_data_shared(const chart::ChartJsDataSet &dataset) {
+  return dataset.data().count() == 0 && dataset.point_count() > 0
+         && !dataset.point_source().is_valid();
+}
+
+u64 get_data_hash(const chart::ChartJsDataSet &dataset) {
+  u64 result = update_hash(fnv_offset_basis, u64(dataset.data_encoding()));
+  result = update_hash(result, u64(dataset.decimation().algorithm()));
+  result = update_hash(result, dataset.decimation().sample_count());
+  result = update_hash(result, u64(dataset.transform().function()));
+  result = update_hash(result, dataset.transform().window_size());
+  result = update_hash(result, u64(dataset.real_format().style()));
+  result = update_hash(result, u64(dataset.real_format().precision()));
+  result = update_hash(result, dataset.x_column());
+  return update_hash(result, dataset.y_column());
+}
+
+bool is_data_equal(const chart::ChartJsDataSet &a,
+                   const chart::ChartJsDataSet &b) {
+  return a.data_encoding() == b.data_encoding()
+         && a.decimation() == b.decimation()
+         && a.transform() == b.transform()
+         && a.real_format() == b.real_format()
+         && is_equal(a.x_column(), b.x_column())
+         && is_equal(a.y_column(), b.y_column());
+}
+} // namespace
+
+ChartJsDashboard::Plan ChartJsDashboard::create_plan() const {
+  // a dashboard has tens of charts so the entries are searched in order
+  Plan result;
+  result.label_index_list.reserve(m_chart_list.count());
+  for (const auto &chart : m_chart_list) {
+    const ChartJsData &data = chart.data();
+    {
+      const u64 hash = get_label_hash(data);
+      size_t index = 0;
+      while (index < result.label_list.count()
+             && (result.label_list.at(index).hash != hash
+                 || !is_label_equal(*result.label_list.at(index).data, data))) {
+        index++;
+      }
+      if (index == result.label_list.count()) {
+        result.label_list.push_back({hash, &data});
+      }
+      result.label_index_list.push_back(index);
+    }
+
+    for (const auto &dataset : data.dataset_list()) {
+      if (!is_data_shared(dataset)) {
+        result.data_index_list.push_back(no_index);
+        continue;
+      }
+      const u64 hash = get_data_hash(dataset);
+      size_t index = 0;
+      while (index < result.data_list.count()
+             && (result.data_list.at(index).hash != hash
+                 || !is_data_equal(*result.data_list.at(index).dataset,
+                                   dataset))) {
+        index++;
+      }
+      if (index == result.data_list.count()) {
+        result.data_list.push_back({hash, &dataset});
+      }
+      result.data_index_list.push_back(index);
+    }
+  }
+  return result;
+}
+
+json::JsonObject ChartJsDashboard::to_object() const {
+  const Plan plan = create_plan();
+
+  json::JsonArray label_array;
+  for (const auto &entry : plan.label_list) {
+    label_array.append(entry.data->labels_to_array());
+  }
+
+  json::JsonArray data_array;
+  for (const auto &entry : plan.data_list) {
+    const ChartJsDataSet &dataset = *entry.dataset;
+    if (dataset.data_encoding() == ChartJsDataSet::DataEncoding::json) {
+      data_array.append(dataset.data_to_array());
+    } else {
+      data_array.append(dataset.encoded_data_to_object());
+    }
+  }
+
+  json::JsonArray chart_array;
+  size_t dataset_offset = 0;
+  for (size_t i = 0; i < m_chart_list.count(); i++) {
+    const ChartJs &chart = m_chart_list.at(i);
+    json::JsonArray dataset_array;
+    for (const auto &dataset : chart.data().dataset_list()) {
+      const size_t index = plan.data_index_list.at(dataset_offset++);
+      if (index == no_index) {
+        dataset_array.append(dataset.to_object());
+        continue;
+      }
+      json::JsonObject dataset_object;
+      dataset.copy_properties_object(dataset_object);
+      if (dataset.data_encoding() == ChartJsDataSet::DataEncoding::json) {
+        dataset_object.insert("data", json::JsonInteger(index));
+      } else {
+        dataset_object.insert("data", json::JsonArray())
+          .insert("encodedData", json::JsonInteger(index));
+      }
+      dataset_array.append(dataset_object);
+    }
+
+    chart_array.append(
+      json::JsonObject()
+        .insert(
+          "type", json::JsonString(ChartJs::convert_type_to_string(chart.type())))
+        .insert("options", chart.options().to_shared_object())
+        .insert(
+          "data",
+          json::JsonObject()
+            .insert("labels", json::JsonInteger(plan.label_index_list.at(i)))
+            .insert("datasets", dataset_array)));
+  }
+
+  return json::JsonObject()
+    .insert("labels", label_array)
+    .insert("data", data_array)
+    .insert("charts", chart_array);
+}
+
+const ChartJsDashboard &ChartJsDashboard::write(ChartJsWriter &writer) const {
+  const Plan plan = create_plan();
+  const ChartJsRealFormat parent_format = writer.real_format();
+
+  writer.begin_object().write_key("labels").begin_array();
+  for (const auto &entry : plan.label_list) {
+    writer.begin_array();
+    for (size_t i = 0; i < entry.data->label_count(); i++) {
+      writer.write_string(entry.data->label_at(i));
+    }
+    writer.end_array();
+  }
+
+  writer.end_array().write_key("data").begin_array();
+  for (const auto &entry : plan.data_list) {
+    const ChartJsDataSet &dataset = *entry.dataset;
+    writer.set_real_format(dataset.real_format().resolve(parent_format));
+    if (dataset.data_encoding() == ChartJsDataSet::DataEncoding::json) {
+      dataset.write_data(writer);
+    } else {
+      dataset.write_encoded_data(writer);
+    }
+    writer.set_real_format(parent_format);
+  }
+
+  writer.end_array().write_key("charts").begin_array();
+  size_t dataset_offset = 0;
+  for (size_t i = 0; i < m_chart_list.count(); i++) {
+    const ChartJs &chart = m_chart_list.at(i);
+    writer.begin_object().insert(
+      "type", ChartJs::convert_type_to_string(chart.type()));
+    chart.options().write(writer.write_key("options"));
+    writer.write_key("data")
+      .begin_object()
+      .insert_integer("labels", plan.label_index_list.at(i))
+      .write_key("datasets")
+      .begin_array();
+    for (const auto &dataset : chart.data().dataset_list()) {
+      const size_t index = plan.data_index_list.at(dataset_offset++);
+      if (index == no_index) {
+        dataset.write(writer);
+        continue;
+      }
+      const ChartJsRealFormat format
+        = dataset.real_format().resolve(parent_format);
+      writer.set_real_format(format).begin_object().write_fragment(
+        dataset.get_properties_fragment(format).string_view());
+      if (dataset.data_encoding() == ChartJsDataSet::DataEncoding::json) {
+        writer.insert_integer("data", index);
+      } else {
+        writer.write_key("data").begin_array().end_array().insert_integer(
+          "encodedData", index);
+      }
+      writer.end_object().set_real_format(parent_format);
+    }
+    writer.end_array().end_object().end_object();
+  }
+  writer.end_array().end_object();
+  return *this;
+}
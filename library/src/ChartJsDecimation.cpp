@@ -0,0 +1,314 @@
+// Copyright 2020-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <cmath>
+
+#include "chart/ChartJs.hpp"
+
+using namespace chart;
+
+namespace {
+double get_x(const ChartJsDataColumn &x_column, size_t offset) {
+  return x_column.is_empty() ? double(offset) : x_column.at(offset);
+}
+
+bool is_finite(const ChartJsDataColumn &x_column,
+               const ChartJsDataColumn &y_column, size_t offset) {
+  return std::isfinite(get_x(x_column, offset))
+         && std::isfinite(y_column.at(offset));
+}
+
+// first offset of bucket within point_count points
+size_t get_bucket_start(size_t bucket, size_t bucket_count,
+                        size_t point_count) {
+  return size_t(u64(bucket) * point_count / bucket_count);
+}
+} // namespace
+
+const ChartJsDecimation &ChartJsDecimation::select(
+  const ChartJsDataColumn &x_column,
+  const ChartJsDataColumn &y_column,
+  size_t point_count,
+  void *context,
+  Callback callback) const {
+
+  if (!is_active(point_count)) {
+    for (size_t i = 0; i < point_count; i++) {
+      callback(context, i);
+    }
+    return *this;
+  }
+
+  switch (algorithm()) {
+  case Algorithm::none:
+    break;
+  case Algorithm::lttb:
+    select_lttb(x_column, y_column, point_count, context, callback);
+    break;
+  case Algorithm::min_max:
+    select_bucket_extremes(y_column, point_count,
+                           (sample_count() + 1) / 2, false, context,
+                           callback);
+    break;
+  case Algorithm::first_last_min_max:
+    select_bucket_extremes(y_column, point_count,
+                           (sample_count() + 3) / 4, true, context,
+                           callback);
+    break;
+  case Algorithm::rdp:
+    select_rdp(x_column, y_column, point_count, context, callback);
+    break;
+  }
+  return *this;
+}
+
+void ChartJsDecimation::select_lttb(const ChartJsDataColumn &x_column,
+                                    const ChartJsDataColumn &y_column,
+                                    size_t point_count,
+                                    void *context,
+                                    Callback callback) const {
+  // the first and last points are always kept, the rest are divided
+  // into sample_count - 2 buckets
+  callback(context, 0);
+  if (sample_count() < 3) {
+    callback(context, point_count - 1);
+    return;
+  }
+
+  const size_t bucket_count = sample_count() - 2;
+  const size_t inner_count = point_count - 2;
+  size_t selected = 0;
+
+  for (size_t bucket = 0; bucket < bucket_count; bucket++) {
+    const size_t start =
+      1 + get_bucket_start(bucket, bucket_count, inner_count);
+    const size_t end =
+      1 + get_bucket_start(bucket + 1, bucket_count, inner_count);
+
+    // average of the next bucket (or the last point)
+    const size_t next_start = end;
+    const size_t next_end =
+      bucket + 1 < bucket_count
+        ? 1 + get_bucket_start(bucket + 2, bucket_count, inner_count)
+        : point_count;
+    double average_x = 0.0;
+    double average_y = 0.0;
+    size_t next_count = 0;
+    for (size_t i = next_start; i < next_end; i++) {
+      if (is_finite(x_column, y_column, i)) {
+        average_x += get_x(x_column, i);
+        average_y += y_column.at(i);
+        next_count++;
+      }
+    }
+    const double selected_x = get_x(x_column, selected);
+    const double selected_y = y_column.at(selected);
+    if (next_count) {
+      average_x /= next_count;
+      average_y /= next_count;
+    } else {
+      average_x = selected_x;
+      average_y = selected_y;
+    }
+
+    // the point that forms the largest triangle with the previously
+    // selected point and the average of the next bucket (the first finite
+    // point if the area is not finite)
+    double maximum_area = -1.0;
+    size_t next_selected = end;
+    bool is_gap = false;
+    for (size_t i = start; i < end; i++) {
+      if (!is_finite(x_column, y_column, i)) {
+        is_gap = true;
+        continue;
+      }
+      double area =
+        fabs((selected_x - average_x) * (y_column.at(i) - selected_y)
+             - (selected_x - get_x(x_column, i)) * (average_y - selected_y));
+      if (!std::isfinite(area)) {
+        area = 0.0;
+      }
+      if (area > maximum_area) {
+        maximum_area = area;
+        next_selected = i;
+      }
+    }
+
+    if (is_gap) {
+      // the first point of each non-finite run is kept as a gap
+      for (size_t i = start; i < end; i++) {
+        if (i == next_selected
+            || (!is_finite(x_column, y_column, i)
+                && (i == start || is_finite(x_column, y_column, i - 1)))) {
+          callback(context, i);
+        }
+      }
+    } else {
+      callback(context, next_selected);
+    }
+
+    if (next_selected < end) {
+      selected = next_selected;
+    }
+  }
+
+  callback(context, point_count - 1);
+}
+
+void ChartJsDecimation::select_rdp(const ChartJsDataColumn &x_column,
+                                   const ChartJsDataColumn &y_column,
+                                   size_t point_count,
+                                   void *context,
+                                   Callback callback) const {
+  // A point with a non-finite x or y is a gap in the line: it is kept and
+  // the finite runs between the gaps are simplified independently.
+  //
+  // Ranges are split at the point furthest from the segment between their
+  // ends until every point is within epsilon. The ranges waiting to be
+  // split are on a stack (rather than recursion) and the left part is
+  // split first, so the first point of each range that is not split is
+  // kept in ascending order.
+  struct Range {
+    size_t first;
+    size_t last;
+  };
+
+  auto is_finite = [&](size_t offset) {
+    return std::isfinite(get_x(x_column, offset) * x_scale())
+           && std::isfinite(y_column.at(offset) * y_scale());
+  };
+
+  const double epsilon_squared = epsilon() * epsilon();
+  var::Vector<Range> stack;
+  size_t offset = 0;
+  while (offset < point_count) {
+    if (!is_finite(offset)) {
+      callback(context, offset++);
+      continue;
+    }
+    size_t run_last = offset;
+    while (run_last + 1 < point_count && is_finite(run_last + 1)) {
+      run_last++;
+    }
+
+    if (run_last > offset) {
+      stack.push_back({offset, run_last});
+    }
+    while (stack.count()) {
+      const Range range = stack.back();
+      stack.pop_back();
+
+      const double ax = get_x(x_column, range.first) * x_scale();
+      const double ay = y_column.at(range.first) * y_scale();
+      const double dx = get_x(x_column, range.last) * x_scale() - ax;
+      const double dy = y_column.at(range.last) * y_scale() - ay;
+      const double length_squared = dx * dx + dy * dy;
+
+      double maximum = 0.0;
+      size_t furthest = range.first;
+      for (size_t i = range.first + 1; i < range.last; i++) {
+        const double px = get_x(x_column, i) * x_scale() - ax;
+        const double py = y_column.at(i) * y_scale() - ay;
+        // distance to the closest point of the segment
+        double t = length_squared > 0.0
+                     ? (px * dx + py * dy) / length_squared
+                     : 0.0;
+        t = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+        const double ex = px - t * dx;
+        const double ey = py - t * dy;
+        const double distance_squared = ex * ex + ey * ey;
+        if (distance_squared > maximum) {
+          maximum = distance_squared;
+          furthest = i;
+        }
+      }
+
+      if (maximum > epsilon_squared) {
+        stack.push_back({furthest, range.last});
+        stack.push_back({range.first, furthest});
+      } else {
+        callback(context, range.first);
+      }
+    }
+    callback(context, run_last);
+    offset = run_last + 1;
+  }
+}
+
+void ChartJsDecimation::select_bucket_extremes(
+  const ChartJsDataColumn &y_column,
+  size_t point_count,
+  size_t bucket_count,
+  bool is_first_last,
+  void *context,
+  Callback callback) const {
+
+  for (size_t bucket = 0; bucket < bucket_count; bucket++) {
+    const size_t start = get_bucket_start(bucket, bucket_count, point_count);
+    const size_t end = get_bucket_start(bucket + 1, bucket_count, point_count);
+    if (start == end) {
+      continue;
+    }
+
+    // non-finite values are gaps, the extremes are of the finite values
+    size_t minimum = end;
+    size_t maximum = end;
+    double minimum_value = 0.0;
+    double maximum_value = 0.0;
+    bool is_gap = false;
+    for (size_t i = start; i < end; i++) {
+      const double value = y_column.at(i);
+      if (!std::isfinite(value)) {
+        is_gap = true;
+      } else if (minimum == end) {
+        minimum_value = maximum_value = value;
+        minimum = maximum = i;
+      } else if (value < minimum_value) {
+        minimum_value = value;
+        minimum = i;
+      } else if (value > maximum_value) {
+        maximum_value = value;
+        maximum = i;
+      }
+    }
+
+    if (is_gap) {
+      // the first point of each non-finite run is kept as a gap
+      for (size_t i = start; i < end; i++) {
+        const bool is_value_finite = std::isfinite(y_column.at(i));
+        if (i == minimum || i == maximum
+            || (is_first_last && (i == start || i == end - 1))
+            || (!is_value_finite
+                && (i == start || std::isfinite(y_column.at(i - 1))))) {
+          callback(context, i);
+        }
+      }
+      continue;
+    }
+
+    // emit the kept offsets in ascending order without duplicates
+    size_t offset_list[4];
+    size_t count = 0;
+    if (is_first_last) {
+      offset_list[count++] = start;
+      offset_list[count++] = end - 1;
+    }
+    offset_list[count++] = minimum;
+    offset_list[count++] = maximum;
+
+    for (size_t i = 1; i < count; i++) {
+      const size_t value = offset_list[i];
+      size_t j = i;
+      while (j > 0 && offset_list[j - 1] > value) {
+        offset_list[j] = offset_list[j - 1];
+        j--;
+      }
+      offset_list[j] = value;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      if (i == 0 || offset_list[i] != offset_list[i - 1]) {
+        callback(context, offset_list[i]);
+      }
+    }
+  }
+}
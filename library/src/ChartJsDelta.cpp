@@ -0,0 +1,220 @@
+// Copyright 2020-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include "chart/ChartJs.hpp"
+
+using namespace chart;
+
+namespace {
+// number of values appended between two states of a sequence that are
+// still present
+size_t get_appended_count(u64 previous_sequence, u64 sequence, size_t count) {
+  const u64 appended = sequence - previous_sequence;
+  return appended < count ? size_t(appended) : count;
+}
+
+// number of values dropped from the front between two states of a
+// sequence, -1 if the change is not a sequence of appends
+s64 get_removed_count(u64 previous_sequence,
+                      size_t previous_count,
+                      u64 sequence,
+                      size_t count) {
+  if (sequence < previous_sequence) {
+    return -1;
+  }
+  const s64 removed
+    = s64(previous_count)
+      + s64(get_appended_count(previous_sequence, sequence, count))
+      - s64(count);
+  if (removed < 0 || removed > s64(previous_count)) {
+    return -1;
+  }
+  return removed;
+}
+} // namespace
+
+json::JsonObject ChartJs::to_delta(u32 since_generation) {
+  {
+    Snapshot current = create_snapshot();
+    if (m_snapshot_list.count() == 0
+        || !is_equal(current, m_snapshot_list.back())) {
+      current.generation = generation() + 1;
+      if (m_snapshot_list.count() < snapshot_history_size) {
+        m_snapshot_list.push_back(current);
+      } else {
+        for (size_t i = 1; i < m_snapshot_list.count(); i++) {
+          m_snapshot_list.at(i - 1) = m_snapshot_list.at(i);
+        }
+        m_snapshot_list.back() = current;
+      }
+    }
+  }
+
+  const Snapshot &latest = m_snapshot_list.back();
+  json::JsonObject result;
+  result.insert("generation", json::JsonInteger(latest.generation));
+
+  const Snapshot *since = nullptr;
+  for (const auto &snapshot : m_snapshot_list) {
+    if (snapshot.generation == since_generation) {
+      since = &snapshot;
+    }
+  }
+
+  if (since == nullptr || since->type != latest.type
+      || since->dataset_list.count() > latest.dataset_list.count()) {
+    result.insert("reset", to_object());
+    return result;
+  }
+
+  result.insert("since", json::JsonInteger(since->generation));
+  if (since == &latest) {
+    return result;
+  }
+
+  if (since->options_hash != latest.options_hash) {
+    result.insert("options", options().to_shared_object());
+  }
+
+  if (since->label_sequence != latest.label_sequence
+      || since->label_count != latest.label_count
+      || since->label_modification_count != latest.label_modification_count) {
+    const s64 removed
+      = get_removed_count(since->label_sequence, since->label_count,
+                          latest.label_sequence, latest.label_count);
+    if (removed < 0
+        || since->label_modification_count
+             != latest.label_modification_count) {
+      result.insert("labels", data().labels_to_array());
+    } else {
+      const size_t appended
+        = get_appended_count(since->label_sequence, latest.label_sequence,
+                             latest.label_count);
+      json::JsonArray append_array;
+      for (size_t i = latest.label_count - appended; i < latest.label_count;
+           i++) {
+        append_array.append(json::JsonString(data().label_at(i)));
+      }
+      result.insert("labels",
+                    json::JsonObject()
+                      .insert("remove", json::JsonInteger(removed))
+                      .insert("append", append_array));
+    }
+  }
+
+  json::JsonArray dataset_array;
+  for (size_t i = 0; i < latest.dataset_list.count(); i++) {
+    const ChartJsDataSet &dataset = data().dataset_list().at(i);
+    const DataSetSnapshot &current = latest.dataset_list.at(i);
+    json::JsonObject entry;
+    entry.insert("index", json::JsonInteger(i));
+
+    if (i >= since->dataset_list.count()) {
+      dataset_array.append(entry.insert("dataset", dataset.to_object()));
+      continue;
+    }
+
+    const DataSetSnapshot &previous = since->dataset_list.at(i);
+    const bool is_points_changed
+      = previous.point_sequence != current.point_sequence
+        || previous.point_count != current.point_count;
+    const bool is_properties_changed
+      = previous.properties_hash != current.properties_hash;
+    const bool is_modified
+      = previous.identity != current.identity
+        || previous.modification_count != current.modification_count;
+    if (!is_points_changed && !is_properties_changed && !is_modified
+        && previous.data_count == current.data_count
+        && !current.is_point_source) {
+      continue;
+    }
+
+    const s64 removed
+      = get_removed_count(previous.point_sequence, previous.point_count,
+                          current.point_sequence, current.point_count);
+    if (is_modified || previous.data_count != current.data_count
+        || removed < 0
+        || dataset.decimation().is_active(current.point_count)
+        || dataset.transform().is_active()
+        || current.is_point_source) {
+      dataset_array.append(entry.insert("dataset", dataset.to_object()));
+      continue;
+    }
+
+    if (is_points_changed) {
+      const size_t appended
+        = get_appended_count(previous.point_sequence, current.point_sequence,
+                             current.point_count);
+      json::JsonArray append_array;
+      for (size_t offset = current.point_count - appended;
+           offset < current.point_count; offset++) {
+        append_array.append(dataset.point_to_value(offset));
+      }
+      entry.insert("remove", json::JsonInteger(removed))
+        .insert("append", append_array);
+    }
+
+    if (is_properties_changed) {
+      entry.insert("properties", dataset.properties_to_object());
+    }
+
+    dataset_array.append(entry);
+  }
+
+  if (dataset_array.count()) {
+    result.insert("datasets", dataset_array);
+  }
+
+  return result;
+}
+
+ChartJs::Snapshot ChartJs::create_snapshot() const {
+  Snapshot result;
+  result.generation = 0;
+  result.type = m_type;
+
+  result.options_hash = options().calculate_hash();
+
+  result.label_sequence = data().label_sequence();
+  result.label_count = data().label_count();
+  result.label_modification_count = data().modification_count();
+
+  result.dataset_list.reserve(data().dataset_list().count());
+  for (const auto &dataset : data().dataset_list()) {
+    DataSetSnapshot snapshot;
+    snapshot.identity = dataset.identity();
+    snapshot.point_sequence = dataset.y_column().sequence();
+    snapshot.point_count = dataset.point_count();
+    snapshot.data_count = dataset.data().count();
+    snapshot.modification_count = dataset.modification_count();
+    snapshot.properties_hash = dataset.calculate_properties_hash();
+    snapshot.is_point_source = dataset.point_source().is_valid();
+    result.dataset_list.push_back(snapshot);
+  }
+
+  return result;
+}
+
+bool ChartJs::is_equal(const Snapshot &a, const Snapshot &b) {
+  if (a.type != b.type || a.options_hash != b.options_hash
+      || a.label_sequence != b.label_sequence
+      || a.label_count != b.label_count
+      || a.label_modification_count != b.label_modification_count
+      || a.dataset_list.count() != b.dataset_list.count()) {
+    return false;
+  }
+
+  for (size_t i = 0; i < a.dataset_list.count(); i++) {
+    const DataSetSnapshot &first = a.dataset_list.at(i);
+    const DataSetSnapshot &second = b.dataset_list.at(i);
+    if (first.identity != second.identity
+        || first.point_sequence != second.point_sequence
+        || first.point_count != second.point_count
+        || first.data_count != second.data_count
+        || first.modification_count != second.modification_count
+        || first.properties_hash != second.properties_hash
+        || first.is_point_source) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,385 @@
+// Copyright 2020-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <cstdint>
+#include <cstring>
+
+#include "chart/ChartJs.hpp"
+
+using namespace chart;
+using namespace var;
+
+namespace {
+// int32_delta holds the difference of each value from the previous one
+// (the first from the first value of the column)
+enum class ArrayType { float32, float64, int32, int32_delta };
+
+bool is_int32(s64 value) { return value >= INT32_MIN && value <= INT32_MAX; }
+
+ArrayType get_timestamp_array_type(const ChartJsDataSet &dataset,
+                                   const ChartJsDataColumn &column) {
+  struct Context {
+    const ChartJsDataColumn *column;
+    s64 previous;
+    bool is_int32;
+  } context = {&column, column.first(), true};
+  dataset.decimation().select(
+    dataset.x_column(), dataset.y_column(), dataset.point_count(), &context,
+    [](void *context, size_t offset) {
+      Context *c = reinterpret_cast<Context *>(context);
+      const s64 value = c->column->timestamp_at(offset);
+      c->is_int32 = c->is_int32 && is_int32(value - c->previous);
+      c->previous = value;
+    });
+  return context.is_int32 ? ArrayType::int32_delta : ArrayType::float64;
+}
+
+// the y values of a transformed dataset are derived when encoded
+bool is_derived(const ChartJsDataSet &dataset,
+                const ChartJsDataColumn &column) {
+  return &column == &dataset.y_column() && dataset.transform().is_active();
+}
+
+ArrayType get_array_type(const ChartJsDataSet &dataset,
+                         const ChartJsDataColumn &column) {
+  if (is_derived(dataset, column)) {
+    return ArrayType::float64;
+  }
+  switch (column.type()) {
+  case ChartJsDataColumn::Type::none:
+  case ChartJsDataColumn::Type::real32:
+    return ArrayType::float32;
+  case ChartJsDataColumn::Type::real64:
+    return ArrayType::float64;
+  case ChartJsDataColumn::Type::integer64:
+    for (const s64 value : column.integer64()) {
+      if (!is_int32(value)) {
+        return ArrayType::float64;
+      }
+    }
+    return ArrayType::int32;
+  case ChartJsDataColumn::Type::timestamp:
+    return get_timestamp_array_type(dataset, column);
+  case ChartJsDataColumn::Type::label:
+    return ArrayType::int32;
+  }
+  return ArrayType::float64;
+}
+
+StringView get_array_type_name(ArrayType value) {
+  switch (value) {
+  case ArrayType::float32:
+    return "Float32";
+  case ArrayType::float64:
+    return "Float64";
+  case ArrayType::int32:
+    return "Int32";
+  case ArrayType::int32_delta:
+    return "Int32Delta";
+  }
+  return "Float64";
+}
+
+void append_string(void *context, const char *data, size_t size) {
+  reinterpret_cast<String *>(context)->append(StringView(data, size));
+}
+
+// stores the value of column at offset as little-endian bytes of type and
+// returns the number of bytes, previous is the last value of an Int32Delta
+// column
+size_t pack_value(const ChartJsDataColumn &column, ArrayType type,
+                  ChartJsTransform::Evaluator *evaluator, size_t offset,
+                  s64 &previous, u8 *bytes) {
+  u64 bits = 0;
+  size_t size = sizeof(u32);
+  switch (type) {
+  case ArrayType::float32: {
+    const float value = float(column.at(offset));
+    u32 value_bits;
+    memcpy(&value_bits, &value, sizeof(value_bits));
+    bits = value_bits;
+  } break;
+  case ArrayType::float64: {
+    // integers are exact to 2^53 (timestamps to year 285616)
+    double value;
+    if (evaluator) {
+      value = evaluator->at(offset);
+    } else if (column.is_integer()) {
+      value = double(column.integer_at(offset));
+    } else {
+      value = column.at(offset);
+    }
+    memcpy(&bits, &value, sizeof(bits));
+    size = sizeof(u64);
+  } break;
+  case ArrayType::int32:
+    bits = u32(s32(column.integer_at(offset)));
+    break;
+  case ArrayType::int32_delta: {
+    const s64 value = column.timestamp_at(offset);
+    bits = u32(s32(value - previous));
+    previous = value;
+  } break;
+  }
+  for (size_t i = 0; i < size; i++) {
+    bytes[i] = u8(bits >> (i * 8));
+  }
+  return size;
+}
+
+// packs the selected values of a column as a little-endian typed array
+// and passes it to the sink in parts of buffer_size bytes
+class ColumnEncoder {
+public:
+  using Sink = void (*)(void *context, const void *data, size_t size);
+
+  // a multiple of 3 (whole base64 groups) and of every element size
+  static constexpr size_t buffer_size = 192;
+
+  ColumnEncoder(const ChartJsDataColumn &column, ArrayType type,
+                void *context, Sink sink)
+    : m_column(column), m_type(type), m_context(context), m_sink(sink),
+      m_previous(column.first()) {}
+
+  // encodes the derived values of evaluator (as float64)
+  ColumnEncoder &set_evaluator(ChartJsTransform::Evaluator *value) {
+    m_evaluator = value;
+    return *this;
+  }
+
+  ~ColumnEncoder() { flush(); }
+
+  void append(size_t offset) {
+    u8 bytes[sizeof(u64)];
+    const size_t size
+      = pack_value(m_column, m_type, m_evaluator, offset, m_previous, bytes);
+    if (m_size + size > buffer_size) {
+      flush();
+    }
+    memcpy(m_buffer + m_size, bytes, size);
+    m_size += size;
+    m_count++;
+  }
+
+  void flush() {
+    if (m_size) {
+      m_sink(m_context, m_buffer, m_size);
+      m_length += m_size;
+      m_size = 0;
+    }
+  }
+
+  size_t count() const { return m_count; }
+  // bytes passed to the sink
+  size_t length() const { return m_length; }
+
+  static void encode(const ChartJsDataSet &dataset, ColumnEncoder &encoder) {
+    dataset.decimation().select(
+      dataset.x_column(), dataset.y_column(), dataset.point_count(),
+      &encoder, [](void *context, size_t offset) {
+        reinterpret_cast<ColumnEncoder *>(context)->append(offset);
+      });
+    encoder.flush();
+  }
+
+private:
+  const ChartJsDataColumn &m_column;
+  const ArrayType m_type;
+  void *m_context;
+  Sink m_sink;
+  ChartJsTransform::Evaluator *m_evaluator = nullptr;
+  s64 m_previous;
+  size_t m_size = 0;
+  size_t m_count = 0;
+  size_t m_length = 0;
+  u8 m_buffer[buffer_size];
+};
+
+// a regular timestamp column with every point selected is written as
+// {"type":"Timestamp","start":..,"step":..}
+bool is_step(const ChartJsDataSet &dataset, const ChartJsDataColumn &column) {
+  return column.is_regular()
+         && !dataset.decimation().is_active(dataset.point_count())
+         && !is_derived(dataset, column);
+}
+
+void write_base64_part(void *context, const void *data, size_t size) {
+  reinterpret_cast<ChartJsWriter *>(context)->write_base64(data, size);
+}
+
+void write_sidecar_part(void *context, const void *data, size_t size) {
+  reinterpret_cast<ChartJsWriter *>(context)->write_sidecar(data, size);
+}
+
+// begins the object of an encoded column with its "type" and "start" or
+// "labels"
+void write_column_head(ChartJsWriter &writer,
+                       const ChartJsDataColumn &column,
+                       ArrayType type) {
+  writer.begin_object().insert("type", get_array_type_name(type));
+  if (type == ArrayType::int32_delta) {
+    writer.insert_integer("start", column.first());
+  }
+  if (column.type() == ChartJsDataColumn::Type::label) {
+    column.label_table()->write(writer.write_key("labels"));
+  }
+}
+
+// writes {"type":..,"base64":..} or {"type":..,"offset":..,"length":..}
+// ("start" is added for Int32Delta and the "labels" the ids of a label
+// column refer to), returns the number of encoded values
+size_t write_column(
+  ChartJsWriter &writer,
+  const ChartJsDataSet &dataset,
+  const ChartJsDataColumn &column,
+  bool is_sidecar) {
+  if (is_step(dataset, column)) {
+    writer.begin_object()
+      .insert("type", "Timestamp")
+      .insert_integer("start", column.first())
+      .insert_integer("step", column.step())
+      .end_object();
+    return dataset.point_count();
+  }
+
+  const ArrayType type = get_array_type(dataset, column);
+  // the evaluator only does work for the derived column
+  const ChartJsTransform none;
+  ChartJsTransform::Evaluator derived(
+    is_derived(dataset, column) ? dataset.transform() : none,
+    dataset.x_column(), column, dataset.point_count());
+  ChartJsTransform::Evaluator *evaluator
+    = is_derived(dataset, column) ? &derived : nullptr;
+  write_column_head(writer, column, type);
+  size_t result = 0;
+  if (is_sidecar) {
+    const size_t offset = writer.sidecar_size();
+    ColumnEncoder encoder(column, type, &writer, write_sidecar_part);
+    encoder.set_evaluator(evaluator);
+    ColumnEncoder::encode(dataset, encoder);
+    // the next array starts 8-byte aligned so it can be viewed in place
+    static const u8 padding[8] = {};
+    writer.write_sidecar(padding, (8 - encoder.length() % 8) % 8);
+    writer.insert_integer("offset", offset)
+      .insert_integer("length", encoder.length());
+    result = encoder.count();
+  } else {
+    writer.write_key("base64").begin_base64();
+    ColumnEncoder encoder(column, type, &writer, write_base64_part);
+    encoder.set_evaluator(evaluator);
+    ColumnEncoder::encode(dataset, encoder);
+    writer.end_base64();
+    result = encoder.count();
+  }
+  writer.end_object();
+  return result;
+}
+
+json::JsonObject column_to_object(
+  const ChartJsDataSet &dataset,
+  const ChartJsDataColumn &column,
+  size_t &count) {
+  if (is_step(dataset, column)) {
+    count = dataset.point_count();
+    return json::JsonObject()
+      .insert("type", json::JsonString("Timestamp"))
+      .insert("start", ChartJsWriter::create_integer(column.first()))
+      .insert("step", ChartJsWriter::create_integer(column.step()));
+  }
+
+  const ArrayType type = get_array_type(dataset, column);
+  // the evaluator only does work for the derived column
+  const ChartJsTransform none;
+  ChartJsTransform::Evaluator derived(
+    is_derived(dataset, column) ? dataset.transform() : none,
+    dataset.x_column(), column, dataset.point_count());
+  ChartJsTransform::Evaluator *evaluator
+    = is_derived(dataset, column) ? &derived : nullptr;
+  String base64;
+  {
+    ChartJsWriter writer(&base64, append_string);
+    ColumnEncoder encoder(column, type, &writer, write_base64_part);
+    encoder.set_evaluator(evaluator);
+    ColumnEncoder::encode(dataset, encoder);
+    count = encoder.count();
+  }
+  json::JsonObject result;
+  result.insert("type", json::JsonString(get_array_type_name(type)));
+  if (type == ArrayType::int32_delta) {
+    result.insert("start", ChartJsWriter::create_integer(column.first()));
+  }
+  if (column.type() == ChartJsDataColumn::Type::label) {
+    result.insert("labels", column.label_table()->to_array());
+  }
+  return result.insert("base64", json::JsonString(base64.string_view()));
+}
+} // namespace
+
+json::JsonObject ChartJsDataSet::encoded_data_to_object() const {
+  json::JsonObject result;
+  size_t count = 0;
+  if (is_point_xy()) {
+    result.insert("x", column_to_object(*this, x_column(), count));
+  }
+  result.insert("y", column_to_object(*this, y_column(), count));
+  result.insert("count", json::JsonInteger(int(count)));
+  return result;
+}
+
+const ChartJsDataSet &
+ChartJsDataSet::write_encoded_data(ChartJsWriter &writer) const {
+  const bool is_sidecar = data_encoding() == DataEncoding::sidecar
+                          && writer.sidecar() != nullptr;
+  writer.begin_object();
+  if (is_point_xy()) {
+    write_column(writer.write_key("x"), *this, x_column(), is_sidecar);
+  }
+  const size_t count
+    = write_column(writer.write_key("y"), *this, y_column(), is_sidecar);
+  writer.insert_integer("count", count).end_object();
+  return *this;
+}
+
+bool ChartJsDataSet::write_encoded_column_head(
+  ChartJsWriter &writer,
+  const ChartJsDataColumn &column,
+  EncodedColumnCursor &cursor) const {
+  cursor = EncodedColumnCursor();
+  if (is_step(*this, column)) {
+    write_column(writer, *this, column, false);
+    cursor.count = point_count();
+    return false;
+  }
+  const ArrayType type = get_array_type(*this, column);
+  cursor.array_type = u8(type);
+  cursor.previous = column.first();
+  write_column_head(writer, column, type);
+  writer.write_key("base64").begin_base64();
+  return true;
+}
+
+void ChartJsDataSet::write_encoded_value(
+  ChartJsWriter &writer,
+  const ChartJsDataColumn &column,
+  size_t offset,
+  ChartJsTransform::Evaluator *evaluator,
+  EncodedColumnCursor &cursor) const {
+  // the bytes left from the previous value start the next base64 group
+  u8 bytes[sizeof(cursor.pending) + sizeof(u64)];
+  memcpy(bytes, cursor.pending, cursor.pending_size);
+  const size_t size
+    = cursor.pending_size
+      + pack_value(column, ArrayType(cursor.array_type),
+                   is_derived(*this, column) ? evaluator : nullptr, offset,
+                   cursor.previous, bytes + cursor.pending_size);
+  const size_t group_size = size - size % 3;
+  writer.write_base64(bytes, group_size);
+  cursor.pending_size = u8(size - group_size);
+  memcpy(cursor.pending, bytes + group_size, cursor.pending_size);
+  cursor.count++;
+}
+
+void ChartJsDataSet::write_encoded_column_tail(
+  ChartJsWriter &writer,
+  const EncodedColumnCursor &cursor) const {
+  writer.write_base64(cursor.pending, cursor.pending_size);
+}
@@ -0,0 +1,171 @@
+// Copyright 2020-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <algorithm>
+#include <cstring>
+
+#include "chart/ChartJs.hpp"
+
+using namespace chart;
+using namespace var;
+
+namespace {
+const u32 fnv_offset_basis = 2166136261UL;
+const u32 fnv_prime = 16777619UL;
+constexpr size_t minimum_slot_count = 16;
+
+// byte order, a prefix first
+bool is_less(StringView a, StringView b) {
+  const size_t length = a.length() < b.length() ? a.length() : b.length();
+  const int result = length ? memcmp(a.data(), b.data(), length) : 0;
+  return result < 0 || (result == 0 && a.length() < b.length());
+}
+} // namespace
+
+u32 ChartJsLabelTable::intern(StringView label) {
+  if (m_slot_list.count() == 0 || (count() + 1) * 2 > m_slot_list.count()) {
+    grow();
+  }
+  const size_t slot = get_slot(label, get_hash(label));
+  if (m_slot_list.at(slot)) {
+    return m_slot_list.at(slot) - 1;
+  }
+
+  const u32 result = u32(count());
+  for (size_t i = 0; i < label.length(); i++) {
+    m_text.push_back(label.data()[i]);
+  }
+  m_end_list.push_back(u32(m_text.count()));
+  m_slot_list.at(slot) = result + 1;
+  return result;
+}
+
+u32 ChartJsLabelTable::find(StringView label) const {
+  if (m_slot_list.count() == 0) {
+    return invalid_id;
+  }
+  const u32 id = m_slot_list.at(get_slot(label, get_hash(label)));
+  return id ? id - 1 : invalid_id;
+}
+
+u32 ChartJsLabelTable::rank(u32 id) const {
+  if (m_rank_list.count() != count()) {
+    Vector<u32> order;
+    order.reserve(count());
+    for (u32 i = 0; i < count(); i++) {
+      order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(),
+              [this](u32 a, u32 b) { return is_less(at(a), at(b)); });
+    m_rank_list.resize(count());
+    for (u32 i = 0; i < order.count(); i++) {
+      m_rank_list.at(order.at(i)) = i;
+    }
+  }
+  return m_rank_list.at(id);
+}
+
+json::JsonArray ChartJsLabelTable::to_array() const {
+  json::JsonArray result;
+  for (u32 i = 0; i < count(); i++) {
+    result.append(json::JsonString(at(i)));
+  }
+  return result;
+}
+
+const ChartJsLabelTable &
+ChartJsLabelTable::write(ChartJsWriter &writer) const {
+  writer.begin_array();
+  for (u32 i = 0; i < count(); i++) {
+    writer.write_string(at(i));
+  }
+  writer.end_array();
+  return *this;
+}
+
+ChartJsLabelTable &ChartJsLabelTable::clear() {
+  m_text.clear();
+  m_end_list.clear();
+  m_slot_list.clear();
+  m_rank_list.clear();
+  return *this;
+}
+
+u32 ChartJsLabelTable::get_hash(StringView label) {
+  u32 result = fnv_offset_basis;
+  for (size_t i = 0; i < label.length(); i++) {
+    result = (result ^ u8(label.data()[i])) * fnv_prime;
+  }
+  return result;
+}
+
+size_t ChartJsLabelTable::get_slot(StringView label, u32 hash) const {
+  // the slot count is a power of 2 and never full
+  const size_t mask = m_slot_list.count() - 1;
+  size_t slot = hash & mask;
+  while (m_slot_list.at(slot) && at(m_slot_list.at(slot) - 1) != label) {
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+void ChartJsLabelTable::grow() {
+  const size_t slot_count = m_slot_list.count() ? m_slot_list.count() * 2
+                                                : minimum_slot_count;
+  m_slot_list = Vector<u32>(slot_count);
+  for (u32 i = 0; i < count(); i++) {
+    const size_t mask = slot_count - 1;
+    size_t slot = get_hash(at(i)) & mask;
+    while (m_slot_list.at(slot)) {
+      slot = (slot + 1) & mask;
+    }
+    m_slot_list.at(slot) = i + 1;
+  }
+}
+
+ChartJsData &
+ChartJsData::set_label_table(const std::shared_ptr<ChartJsLabelTable> &table) {
+  if (table == m_label_table) {
+    return *this;
+  }
+  if (table == nullptr) {
+    // back to strings in order
+    StringList label_list;
+    label_list.reserve(m_label_capacity ? m_label_capacity : label_count());
+    for (size_t i = 0; i < label_count(); i++) {
+      label_list.push_back(String(label_at(i)));
+    }
+    m_label_list = std::move(label_list);
+    m_label_id_list = var::Vector<u32>();
+    m_label_head = 0;
+    m_label_table = nullptr;
+    return *this;
+  }
+  var::Vector<u32> id_list;
+  id_list.reserve(m_label_capacity ? m_label_capacity : label_count());
+  for (size_t i = 0; i < label_count(); i++) {
+    id_list.push_back(table->intern(label_at(i)));
+  }
+  m_label_list = StringList();
+  m_label_id_list = std::move(id_list);
+  m_label_head = 0;
+  m_label_table = table;
+  return *this;
+}
+
+void ChartJsDataColumn::push_label_id(s64 value) {
+  if (is_label_id(value)) {
+    push(m_integer64, value);
+  }
+}
+
+ChartJsDataColumn &ChartJsDataColumn::append(StringView value) {
+  set_type_if_none(Type::label);
+  if (m_type != Type::label) {
+    return *this;
+  }
+  if (m_label_table == nullptr) {
+    m_label_table = std::make_shared<ChartJsLabelTable>();
+  }
+  push(m_integer64, s64(m_label_table->intern(value)));
+  return *this;
+}
@@ -0,0 +1,153 @@
+// Copyright 2020-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <algorithm>
+
+#include "chart/ChartJsLevelOfDetail.hpp"
+
+using namespace chart;
+
+ChartJsLevelOfDetail &ChartJsLevelOfDetail::append(double x, double y) {
+  const size_t offset = m_x.count();
+  m_x.push_back(x);
+  m_y.push_back(y);
+
+  const size_t count = offset + 1;
+  for (size_t level = 1; level < 8 * sizeof(size_t); level++) {
+    const size_t run_size = size_t(1) << level;
+    if (run_size > count) {
+      break;
+    }
+
+    if (m_level_list.count() < level) {
+      // a new level starts as the merge of the two runs below it, which
+      // already include this sample
+      Run run;
+      if (level == 1) {
+        const bool is_first_minimum = m_y.at(0) <= m_y.at(1);
+        run.minimum = is_first_minimum ? m_y.at(0) : m_y.at(1);
+        run.maximum = is_first_minimum ? m_y.at(1) : m_y.at(0);
+        run.minimum_offset = is_first_minimum ? 0 : 1;
+        run.maximum_offset = is_first_minimum ? 1 : 0;
+        run.sum = m_y.at(0) + m_y.at(1);
+      } else {
+        const Run &first = m_level_list.at(level - 2).at(0);
+        const Run &second = m_level_list.at(level - 2).at(1);
+        const bool is_first_minimum = first.minimum <= second.minimum;
+        const bool is_first_maximum = first.maximum >= second.maximum;
+        run.minimum = is_first_minimum ? first.minimum : second.minimum;
+        run.minimum_offset =
+          is_first_minimum ? first.minimum_offset : second.minimum_offset;
+        run.maximum = is_first_maximum ? first.maximum : second.maximum;
+        run.maximum_offset =
+          is_first_maximum ? first.maximum_offset : second.maximum_offset;
+        run.sum = first.sum + second.sum;
+      }
+      m_level_list.push_back(var::Vector<Run>());
+      m_level_list.back().push_back(run);
+      continue;
+    }
+
+    var::Vector<Run> &run_list = m_level_list.at(level - 1);
+    if ((offset >> level) == run_list.count()) {
+      Run run;
+      run.minimum = y;
+      run.maximum = y;
+      run.sum = y;
+      run.minimum_offset = u32(offset);
+      run.maximum_offset = u32(offset);
+      run_list.push_back(run);
+    } else {
+      Run &run = run_list.back();
+      if (y < run.minimum) {
+        run.minimum = y;
+        run.minimum_offset = u32(offset);
+      }
+      if (y > run.maximum) {
+        run.maximum = y;
+        run.maximum_offset = u32(offset);
+      }
+      run.sum += y;
+    }
+  }
+
+  return *this;
+}
+
+ChartJsLevelOfDetail &ChartJsLevelOfDetail::append(const double *x_values,
+                                                   const double *y_values,
+                                                   size_t count) {
+  m_x.reserve(m_x.count() + count);
+  m_y.reserve(m_y.count() + count);
+  for (size_t i = 0; i < count; i++) {
+    append(x_values[i], y_values[i]);
+  }
+  return *this;
+}
+
+const ChartJsLevelOfDetail &
+ChartJsLevelOfDetail::query(const Query &options,
+                            ChartJsDataSet &dataset) const {
+  const size_t start = lower_bound(options.minimum());
+  const size_t end = upper_bound(options.maximum());
+  if (start >= end) {
+    return *this;
+  }
+
+  const size_t sample_count = end - start;
+  const size_t resolution = options.resolution() ? options.resolution() : 1;
+
+  // the coarsest level that still has at least resolution runs
+  size_t level = 0;
+  while (level < m_level_list.count() &&
+         (sample_count >> (level + 1)) >= resolution) {
+    level++;
+  }
+
+  if (level == 0) {
+    dataset.reserve_points(dataset.point_count() + sample_count);
+    dataset.append_points(m_x.data() + start, m_y.data() + start,
+                          sample_count);
+    return *this;
+  }
+
+  // runs on the edges may include samples just outside the range
+  const var::Vector<Run> &run_list = m_level_list.at(level - 1);
+  const size_t first_run = start >> level;
+  const size_t last_run = (end - 1) >> level;
+  const size_t points_per_run =
+    options.aggregate() == Aggregate::min_max ? 2 : 1;
+  dataset.reserve_points(dataset.point_count() +
+                         (last_run - first_run + 1) * points_per_run);
+
+  for (size_t i = first_run; i <= last_run; i++) {
+    const Run &run = run_list.at(i);
+    switch (options.aggregate()) {
+    case Aggregate::mean: {
+      const size_t first_sample = i << level;
+      const size_t last_sample =
+        std::min(((i + 1) << level) - 1, m_x.count() - 1);
+      dataset.append_point(
+        (m_x.at(first_sample) + m_x.at(last_sample)) / 2.0,
+        run.sum / double(last_sample - first_sample + 1));
+    } break;
+    case Aggregate::min_max: {
+      const u32 first = std::min(run.minimum_offset, run.maximum_offset);
+      const u32 second = std::max(run.minimum_offset, run.maximum_offset);
+      dataset.append_point(m_x.at(first), m_y.at(first));
+      if (second != first) {
+        dataset.append_point(m_x.at(second), m_y.at(second));
+      }
+    } break;
+    }
+  }
+
+  return *this;
+}
+
+size_t ChartJsLevelOfDetail::lower_bound(double x) const {
+  return size_t(std::lower_bound(m_x.begin(), m_x.end(), x) - m_x.begin());
+}
+
+size_t ChartJsLevelOfDetail::upper_bound(double x) const {
+  return size_t(std::upper_bound(m_x.begin(), m_x.end(), x) - m_x.begin());
+}
@@ -0,0 +1,630 @@
+// Copyright 2020-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined __link && !defined __win32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CHARTJS_LOADER_MMAP 1
+#endif
+
+#include "chart/ChartJsLoader.hpp"
+
+using namespace chart;
+using namespace var;
+
+namespace {
+
+// converts selected columns of rows to batches of points
+class Session {
+public:
+  Session(const ChartJsLoader &loader, ChartJsData &data)
+    : m_loader(loader), m_data(data) {}
+
+  ~Session() { flush(); }
+
+  bool is_complete() const {
+    return m_loader.row_count() && m_loaded_count == m_loader.row_count();
+  }
+
+  // returns false when the row range has been loaded
+  bool consume_line(StringView line) {
+    if (line.length() && line.data()[line.length() - 1] == '\r') {
+      line = StringView(line.data(), line.length() - 1);
+    }
+    if (line.is_empty()) {
+      return true;
+    }
+
+    if (m_slot_list.is_empty()) {
+      prepare(count_fields(line));
+      if (m_loader.is_header()) {
+        consume_header(line);
+        return true;
+      }
+    }
+
+    if (m_row++ < m_loader.first_row()) {
+      return true;
+    }
+
+    double *values = m_batch.data() + m_batch_count;
+    size_t column = 0;
+    const char *cursor = line.data();
+    const char *end = cursor + line.length();
+    while (cursor <= end) {
+      const char *field_end = find_field_end(cursor, end);
+      const StringView field(cursor, size_t(field_end - cursor));
+      if (column < m_slot_list.count()) {
+        const size_t slot = m_slot_list.at(column);
+        if (slot != ChartJsLoader::none) {
+          values[slot * ChartJsLoader::batch_size] =
+            ChartJsLoader::parse_real(field);
+        }
+      }
+      if (column == m_loader.label_column()) {
+        m_data.append_label(unquote(field).string_view());
+      }
+      cursor = field_end + 1;
+      column++;
+    }
+
+    return commit_row();
+  }
+
+  bool consume_record(const u8 *record) {
+    if (m_slot_list.is_empty()) {
+      prepare(m_loader.field_list().count());
+    }
+
+    if (m_row++ < m_loader.first_row()) {
+      return true;
+    }
+
+    double *values = m_batch.data() + m_batch_count;
+    const auto &field_list = m_loader.field_list();
+    for (size_t column = 0; column < field_list.count(); column++) {
+      const size_t slot = m_slot_list.at(column);
+      const ChartJsLoader::Field field = field_list.at(column);
+      if (slot != ChartJsLoader::none) {
+        values[slot * ChartJsLoader::batch_size] = decode(field, record);
+      }
+      record += ChartJsLoader::get_field_size(field);
+    }
+
+    return commit_row();
+  }
+
+  // applied to the datasets when they are created
+  Session &reserve(size_t row_count) {
+    m_reserve_count = row_count;
+    return *this;
+  }
+
+  // skips rows before the range without reading them
+  Session &skip(size_t row_count) {
+    m_row += row_count;
+    return *this;
+  }
+
+  Session &flush() {
+    if (m_batch_count == 0) {
+      return *this;
+    }
+
+    const size_t batch_size = ChartJsLoader::batch_size;
+    const double *x_values = m_batch.data();
+    const bool is_xy = m_loader.x_column() != ChartJsLoader::none;
+    for (size_t i = 0; i < m_y_count; i++) {
+      ChartJsDataSet &dataset = get_dataset(i);
+      const double *y_values = m_batch.data() + (i + 1) * batch_size;
+      switch (m_loader.type()) {
+      case ChartJsDataColumn::Type::none:
+      case ChartJsDataColumn::Type::real32: {
+        float x[batch_size];
+        float y[batch_size];
+        for (size_t j = 0; j < m_batch_count; j++) {
+          x[j] = float(x_values[j]);
+          y[j] = float(y_values[j]);
+        }
+        is_xy ? dataset.append_points(x, y, m_batch_count)
+              : dataset.append_points(y, m_batch_count);
+      } break;
+      case ChartJsDataColumn::Type::real64:
+        is_xy ? dataset.append_points(x_values, y_values, m_batch_count)
+              : dataset.append_points(y_values, m_batch_count);
+        break;
+      case ChartJsDataColumn::Type::label:
+        // rejected by load(), labels are read from label_column()
+        break;
+      case ChartJsDataColumn::Type::integer64: {
+        s64 x[batch_size];
+        s64 y[batch_size];
+        for (size_t j = 0; j < m_batch_count; j++) {
+          x[j] = std::isfinite(x_values[j]) ? s64(x_values[j]) : 0;
+          y[j] = std::isfinite(y_values[j]) ? s64(y_values[j]) : 0;
+        }
+        is_xy ? dataset.append_points(x, y, m_batch_count)
+              : dataset.append_points(y, m_batch_count);
+      } break;
+      case ChartJsDataColumn::Type::timestamp:
+        // integer x (such as epoch milliseconds) with real64 y
+        if (is_xy) {
+          s64 x[batch_size];
+          for (size_t j = 0; j < m_batch_count; j++) {
+            x[j] = std::isfinite(x_values[j]) ? s64(x_values[j]) : 0;
+          }
+          dataset.x_column()
+            .set_type(ChartJsDataColumn::Type::timestamp)
+            .append(x, m_batch_count);
+          dataset.y_column().append(y_values, m_batch_count);
+        } else {
+          dataset.append_points(y_values, m_batch_count);
+        }
+        break;
+      }
+    }
+    m_batch_count = 0;
+    return *this;
+  }
+
+private:
+  const ChartJsLoader &m_loader;
+  ChartJsData &m_data;
+  // the batch slot (0 for x, 1 + n for the nth y column) of each column
+  var::Vector<size_t> m_slot_list;
+  var::Vector<double> m_batch;
+  size_t m_batch_count = 0;
+  size_t m_y_count = 0;
+  size_t m_first_dataset = 0;
+  size_t m_row = 0;
+  size_t m_loaded_count = 0;
+  size_t m_reserve_count = 0;
+
+  ChartJsDataSet &get_dataset(size_t offset) {
+    return m_data.dataset_list().at(m_first_dataset + offset);
+  }
+
+  void prepare(size_t column_count) {
+    var::Vector<size_t> y_column_list = m_loader.y_column_list();
+    if (y_column_list.is_empty()) {
+      for (size_t column = 0; column < column_count; column++) {
+        if (column != m_loader.x_column()
+            && column != m_loader.label_column()) {
+          y_column_list.push_back(column);
+        }
+      }
+    }
+
+    size_t slot_count = column_count;
+    for (const auto column : y_column_list) {
+      slot_count = column >= slot_count ? column + 1 : slot_count;
+    }
+    if (m_loader.x_column() != ChartJsLoader::none) {
+      slot_count = m_loader.x_column() >= slot_count ? m_loader.x_column() + 1
+                                                     : slot_count;
+    }
+
+    m_slot_list.resize(slot_count);
+    for (auto &slot : m_slot_list) {
+      slot = ChartJsLoader::none;
+    }
+    if (m_loader.x_column() != ChartJsLoader::none) {
+      m_slot_list.at(m_loader.x_column()) = 0;
+    }
+    m_y_count = y_column_list.count();
+    for (size_t i = 0; i < m_y_count; i++) {
+      m_slot_list.at(y_column_list.at(i)) = i + 1;
+    }
+
+    // missing fields are gaps
+    m_batch.resize((m_y_count + 1) * ChartJsLoader::batch_size);
+    for (auto &value : m_batch) {
+      value = NAN;
+    }
+
+    m_first_dataset = m_data.dataset_list().count();
+    for (size_t i = 0; i < m_y_count; i++) {
+      m_data.append(ChartJsDataSet());
+      get_dataset(i).reserve_points(m_reserve_count);
+    }
+  }
+
+  void consume_header(StringView line) {
+    size_t column = 0;
+    const char *cursor = line.data();
+    const char *end = cursor + line.length();
+    while (cursor <= end) {
+      const char *field_end = find_field_end(cursor, end);
+      const size_t slot = column < m_slot_list.count()
+                            ? m_slot_list.at(column)
+                            : ChartJsLoader::none;
+      if (slot != ChartJsLoader::none && slot > 0) {
+        const StringView field(cursor, size_t(field_end - cursor));
+        get_dataset(slot - 1).set_label(unquote(field).string_view());
+      }
+      cursor = field_end + 1;
+      column++;
+    }
+  }
+
+  bool commit_row() {
+    m_loaded_count++;
+    if (++m_batch_count == ChartJsLoader::batch_size) {
+      flush();
+      // clear the batch for rows with missing fields
+      for (auto &value : m_batch) {
+        value = NAN;
+      }
+    }
+    return !is_complete();
+  }
+
+  size_t count_fields(StringView line) const {
+    size_t result = 0;
+    const char *cursor = line.data();
+    const char *end = cursor + line.length();
+    while (cursor <= end) {
+      cursor = find_field_end(cursor, end) + 1;
+      result++;
+    }
+    return result;
+  }
+
+  // the delimiter after the field at cursor (or end), delimiters in
+  // double quotes are part of the field
+  const char *find_field_end(const char *cursor, const char *end) const {
+    const char delimiter = m_loader.delimiter();
+    if (cursor < end && *cursor == '"') {
+      cursor++;
+      while (cursor < end) {
+        if (*cursor == '"') {
+          if (cursor + 1 < end && cursor[1] == '"') {
+            cursor += 2;
+            continue;
+          }
+          cursor++;
+          break;
+        }
+        cursor++;
+      }
+    }
+    const void *result = memchr(cursor, delimiter, size_t(end - cursor));
+    return result != nullptr ? reinterpret_cast<const char *>(result) : end;
+  }
+
+  static var::String unquote(StringView field) {
+    if (field.length() < 2 || field.data()[0] != '"'
+        || field.data()[field.length() - 1] != '"') {
+      return var::String(field);
+    }
+
+    var::String result;
+    const char *cursor = field.data() + 1;
+    const char *end = field.data() + field.length() - 1;
+    while (cursor < end) {
+      // "" is an escaped quote
+      const char *quote = reinterpret_cast<const char *>(
+        memchr(cursor, '"', size_t(end - cursor)));
+      if (quote == nullptr) {
+        result.append(StringView(cursor, size_t(end - cursor)));
+        break;
+      }
+      result.append(StringView(cursor, size_t(quote - cursor) + 1));
+      cursor = quote + 2;
+    }
+    return result;
+  }
+
+  static u64 decode_unsigned(const u8 *data, size_t size) {
+    u64 result = 0;
+    for (size_t i = 0; i < size; i++) {
+      result |= u64(data[i]) << (8 * i);
+    }
+    return result;
+  }
+
+  static double decode(ChartJsLoader::Field field, const u8 *data) {
+    using Field = ChartJsLoader::Field;
+    switch (field) {
+    case Field::u8:
+      return data[0];
+    case Field::s8:
+      return s8(data[0]);
+    case Field::u16:
+      return double(u16(decode_unsigned(data, 2)));
+    case Field::s16:
+      return double(s16(decode_unsigned(data, 2)));
+    case Field::u32:
+      return double(u32(decode_unsigned(data, 4)));
+    case Field::s32:
+      return double(s32(decode_unsigned(data, 4)));
+    case Field::u64:
+      return double(decode_unsigned(data, 8));
+    case Field::s64:
+      return double(s64(decode_unsigned(data, 8)));
+    case Field::real32: {
+      const u32 bits = u32(decode_unsigned(data, 4));
+      float result;
+      memcpy(&result, &bits, sizeof(result));
+      return result;
+    }
+    case Field::real64: {
+      const u64 bits = decode_unsigned(data, 8);
+      double result;
+      memcpy(&result, &bits, sizeof(result));
+      return result;
+    }
+    }
+    return NAN;
+  }
+};
+
+} // namespace
+
+ChartJsLoader &ChartJsLoader::load(var::View contents, ChartJsData &data) {
+  API_RETURN_VALUE_IF_ERROR(*this);
+  if (type() == ChartJsDataColumn::Type::label) {
+    API_RETURN_VALUE_ASSIGN_ERROR(*this, "label is not a value type", EINVAL);
+  }
+  Session session(*this, data);
+  const char *cursor = contents.to_const_char();
+  const char *end = cursor + contents.size();
+
+  if (format() == Format::binary) {
+    const size_t record_size = get_record_size();
+    if (record_size == 0) {
+      API_RETURN_VALUE_ASSIGN_ERROR(*this, "no binary fields", EINVAL);
+    }
+
+    const size_t total = contents.size() / record_size;
+    const size_t first = first_row() < total ? first_row() : total;
+    const size_t available = total - first;
+    session.reserve(row_count() && row_count() < available ? row_count()
+                                                           : available);
+    session.skip(first);
+    for (size_t i = first; i < total; i++) {
+      if (!session.consume_record(
+            reinterpret_cast<const u8 *>(cursor) + i * record_size)) {
+        break;
+      }
+    }
+    return *this;
+  }
+
+  if (row_count()) {
+    session.reserve(row_count());
+  }
+  while (cursor < end) {
+    const char *newline = reinterpret_cast<const char *>(
+      memchr(cursor, '\n', size_t(end - cursor)));
+    const char *line_end = newline != nullptr ? newline : end;
+    if (!session.consume_line(StringView(cursor, size_t(line_end - cursor)))) {
+      break;
+    }
+    cursor = line_end + 1;
+  }
+  return *this;
+}
+
+ChartJsLoader &ChartJsLoader::load(const fs::FileObject &file,
+                                   ChartJsData &data) {
+  API_RETURN_VALUE_IF_ERROR(*this);
+  if (type() == ChartJsDataColumn::Type::label) {
+    API_RETURN_VALUE_ASSIGN_ERROR(*this, "label is not a value type", EINVAL);
+  }
+  const size_t record_size =
+    format() == Format::binary ? get_record_size() : 1;
+  if (record_size == 0 || record_size > buffer_size) {
+    API_RETURN_VALUE_ASSIGN_ERROR(*this, "invalid binary record size",
+                                  EINVAL);
+  }
+
+  Session session(*this, data);
+  if (format() == Format::binary) {
+    // records before the range are not read, seek() takes an int so an
+    // offset past 2GB is reached in steps from the current location
+    u64 offset = u64(first_row()) * record_size;
+    file.seek(0, fs::FileObject::Whence::set);
+    while (offset) {
+      const int step = offset < u64(INT_MAX) ? int(offset) : INT_MAX;
+      file.seek(step, fs::FileObject::Whence::current);
+      offset -= u64(step);
+    }
+    API_RETURN_VALUE_IF_ERROR(*this);
+    session.skip(first_row());
+  }
+
+  var::Vector<char> buffer(buffer_size);
+  size_t length = 0;
+  bool is_active = true;
+  while (is_active) {
+    file.read(var::View(buffer.data() + length, buffer_size - length));
+    API_RETURN_VALUE_IF_ERROR(*this);
+    const int result = file.return_value();
+    const bool is_end = result <= 0;
+    length += is_end ? 0 : size_t(result);
+
+    const char *cursor = buffer.data();
+    const char *end = cursor + length;
+    if (format() == Format::binary) {
+      while (is_active && size_t(end - cursor) >= record_size) {
+        is_active =
+          session.consume_record(reinterpret_cast<const u8 *>(cursor));
+        cursor += record_size;
+      }
+    } else {
+      while (is_active) {
+        const char *newline = reinterpret_cast<const char *>(
+          memchr(cursor, '\n', size_t(end - cursor)));
+        if (newline == nullptr) {
+          if (is_end) {
+            // the last line does not need a newline
+            session.consume_line(StringView(cursor, size_t(end - cursor)));
+            cursor = end;
+          }
+          break;
+        }
+        is_active =
+          session.consume_line(StringView(cursor, size_t(newline - cursor)));
+        cursor = newline + 1;
+      }
+    }
+
+    if (is_end) {
+      break;
+    }
+
+    length = size_t(end - cursor);
+    if (length == buffer_size) {
+      API_RETURN_VALUE_ASSIGN_ERROR(*this, "csv line exceeds buffer_size",
+                                    EINVAL);
+    }
+    memmove(buffer.data(), cursor, length);
+  }
+
+  return *this;
+}
+
+ChartJsLoader &ChartJsLoader::load(var::StringView path, ChartJsData &data) {
+  API_RETURN_VALUE_IF_ERROR(*this);
+#if defined CHARTJS_LOADER_MMAP
+  const int fd = ::open(var::PathString(path).cstring(), O_RDONLY);
+  if (fd < 0) {
+    API_RETURN_VALUE_ASSIGN_ERROR(*this, "failed to open file", errno);
+  }
+
+  struct stat info;
+  void *map = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    map = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  ::close(fd);
+
+  if (map != MAP_FAILED) {
+    madvise(map, size_t(info.st_size), MADV_SEQUENTIAL);
+    load(var::View(map, size_t(info.st_size)), data);
+    munmap(map, size_t(info.st_size));
+    return *this;
+  }
+#endif
+  return load(fs::File(path), data);
+}
+
+size_t ChartJsLoader::get_field_size(Field value) {
+  switch (value) {
+  case Field::u8:
+  case Field::s8:
+    return 1;
+  case Field::u16:
+  case Field::s16:
+    return 2;
+  case Field::u32:
+  case Field::s32:
+  case Field::real32:
+    return 4;
+  case Field::u64:
+  case Field::s64:
+  case Field::real64:
+    return 8;
+  }
+  return 0;
+}
+
+size_t ChartJsLoader::get_record_size() const {
+  size_t result = 0;
+  for (const auto field : field_list()) {
+    result += get_field_size(field);
+  }
+  return result;
+}
+
+double ChartJsLoader::parse_real(var::StringView text) {
+  const char *cursor = text.data();
+  const char *end = cursor + text.length();
+  while (cursor < end && (*cursor == ' ' || *cursor == '\t')) {
+    cursor++;
+  }
+  while (end > cursor && (end[-1] == ' ' || end[-1] == '\t')) {
+    end--;
+  }
+
+  // Clinger's fast path: up to 19 digits with a mantissa below 2^53 and a
+  // power of ten below 10^22 are both exact doubles, so one multiply or
+  // divide is correctly rounded
+  static const double power_list[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+  const char *start = cursor;
+  const bool is_negative = cursor < end && *cursor == '-';
+  if (cursor < end && (*cursor == '-' || *cursor == '+')) {
+    cursor++;
+  }
+
+  u64 mantissa = 0;
+  int digit_count = 0;
+  int exponent = 0;
+  bool has_digits = false;
+  for (; cursor < end && *cursor >= '0' && *cursor <= '9'; cursor++) {
+    has_digits = true;
+    if (mantissa || *cursor != '0') {
+      mantissa = mantissa * 10 + u64(*cursor - '0');
+      digit_count++;
+    }
+  }
+  if (cursor < end && *cursor == '.') {
+    for (cursor++; cursor < end && *cursor >= '0' && *cursor <= '9';
+         cursor++) {
+      has_digits = true;
+      if (mantissa || *cursor != '0') {
+        mantissa = mantissa * 10 + u64(*cursor - '0');
+        digit_count++;
+      }
+      exponent--;
+    }
+  }
+  if (has_digits && cursor < end && (*cursor == 'e' || *cursor == 'E')) {
+    cursor++;
+    const bool is_exponent_negative = cursor < end && *cursor == '-';
+    if (cursor < end && (*cursor == '-' || *cursor == '+')) {
+      cursor++;
+    }
+    // "1e", "1e-" and "1e+" have no exponent digits
+    const char *exponent_start = cursor;
+    int value = 0;
+    for (; cursor < end && *cursor >= '0' && *cursor <= '9'; cursor++) {
+      value = value < 10000 ? value * 10 + (*cursor - '0') : value;
+    }
+    if (cursor == exponent_start) {
+      return NAN;
+    }
+    exponent += is_exponent_negative ? -value : value;
+  }
+
+  if (has_digits && cursor == end && digit_count <= 19
+      && mantissa <= (u64(1) << 53) && exponent >= -22 && exponent <= 22) {
+    const double result = exponent < 0
+                            ? double(mantissa) / power_list[-exponent]
+                            : double(mantissa) * power_list[exponent];
+    return is_negative ? -result : result;
+  }
+
+  // long mantissas, large exponents, inf and nan
+  char buffer[64];
+  const size_t length = size_t(end - start);
+  if (length == 0 || length >= sizeof(buffer)) {
+    return NAN;
+  }
+  memcpy(buffer, start, length);
+  buffer[length] = '\0';
+  char *parse_end = nullptr;
+  const double result = strtod(buffer, &parse_end);
+  return parse_end == buffer + length ? result : NAN;
+}
@@ -0,0 +1,83 @@
+// Copyright 2020-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include "chart/ChartJs.hpp"
+
+using namespace chart;
+
+const ChartJsPointSource &
+ChartJsPointSource::write(ChartJsWriter &writer) const {
+  Cursor cursor;
+  Value x_list[block_size];
+  Value y_list[block_size];
+  size_t offset = 0;
+  while (const size_t count = read(cursor, offset, x_list, y_list)) {
+    for (size_t i = 0; i < count; i++) {
+      write_point(writer, x_list[i], y_list[i]);
+    }
+    offset += count;
+  }
+  return *this;
+}
+
+const ChartJsPointSource &
+ChartJsPointSource::write_point(ChartJsWriter &writer, Value x,
+                                Value y) const {
+  if (is_xy()) {
+    writer.begin_object().write_key("x");
+    write_value(writer, x_type(), x);
+    writer.write_key("y");
+    write_value(writer, y_type(), y);
+    writer.end_object();
+  } else {
+    write_value(writer, y_type(), y);
+  }
+  return *this;
+}
+
+const ChartJsPointSource &
+ChartJsPointSource::append(json::JsonArray &array) const {
+  Cursor cursor;
+  Value x_list[block_size];
+  Value y_list[block_size];
+  size_t offset = 0;
+  while (const size_t count = read(cursor, offset, x_list, y_list)) {
+    for (size_t i = 0; i < count; i++) {
+      if (is_xy()) {
+        array.append(json::JsonObject()
+                       .insert("x", to_value(x_type(), x_list[i]))
+                       .insert("y", to_value(y_type(), y_list[i])));
+      } else {
+        array.append(to_value(y_type(), y_list[i]));
+      }
+    }
+    offset += count;
+  }
+  return *this;
+}
+
+void ChartJsPointSource::write_value(ChartJsWriter &writer,
+                                     ChartJsDataColumn::Type type,
+                                     Value value) {
+  if (is_integer(type)) {
+    writer.write_integer(value.integer);
+  } else if (type == ChartJsDataColumn::Type::real32) {
+    writer.write_real(float(value.real));
+  } else {
+    writer.write_real(value.real);
+  }
+}
+
+json::JsonValue ChartJsPointSource::to_value(ChartJsDataColumn::Type type,
+                                             Value value) {
+  if (is_integer(type)) {
+    return ChartJsWriter::create_integer(value.integer);
+  }
+  // jansson cannot represent inf/nan, chart.js treats null as a gap
+  if (!std::isfinite(value.real)) {
+    return json::JsonNull();
+  }
+  if (type == ChartJsDataColumn::Type::real32) {
+    return json::JsonReal(float(value.real));
+  }
+  return json::JsonReal(value.real);
+}
@@ -0,0 +1,190 @@
+// Copyright 2020-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <limits>
+
+#include "chart/ChartJs.hpp"
+
+using namespace chart;
+
+namespace {
+// independent accumulators so the compiler keeps them in vector registers
+// (and a scalar core can overlap the comparisons)
+constexpr size_t lane_count = 8;
+
+template <typename T>
+ChartJsRange get_range(const var::Vector<T> &list) {
+  const T *values = list.data();
+  const size_t count = list.count();
+  T minimum[lane_count];
+  T maximum[lane_count];
+  T positive_minimum[lane_count];
+  for (size_t lane = 0; lane < lane_count; lane++) {
+    minimum[lane] = std::numeric_limits<T>::max();
+    maximum[lane] = std::numeric_limits<T>::lowest();
+    positive_minimum[lane] = std::numeric_limits<T>::max();
+  }
+
+  // selects rather than branches so the lanes vectorize, value - value
+  // is not 0 for nan and infinity (which are not part of the range)
+  size_t i = 0;
+  for (; i + lane_count <= count; i += lane_count) {
+    for (size_t lane = 0; lane < lane_count; lane++) {
+      const T value = values[i + lane];
+      const bool is_finite = value - value == 0;
+      const T low = is_finite ? value : std::numeric_limits<T>::max();
+      const T high = is_finite ? value : std::numeric_limits<T>::lowest();
+      const T positive = value > 0 ? low : std::numeric_limits<T>::max();
+      minimum[lane] = low < minimum[lane] ? low : minimum[lane];
+      maximum[lane] = high > maximum[lane] ? high : maximum[lane];
+      positive_minimum[lane] = positive < positive_minimum[lane]
+                                 ? positive
+                                 : positive_minimum[lane];
+    }
+  }
+
+  ChartJsRange result;
+  for (size_t lane = 0; lane < lane_count; lane++) {
+    // an untouched lane is still the initial value
+    if (minimum[lane] <= maximum[lane]) {
+      result.include(double(minimum[lane])).include(double(maximum[lane]));
+    }
+    if (positive_minimum[lane] != std::numeric_limits<T>::max()) {
+      result.include(double(positive_minimum[lane]));
+    }
+  }
+  for (; i < count; i++) {
+    result.include(double(values[i]));
+  }
+  return result;
+}
+} // namespace
+
+ChartJsRange ChartJsDataColumn::calculate_range() const {
+  switch (m_type) {
+  case Type::none:
+  case Type::label:
+    break;
+  case Type::real32:
+    return get_range(m_real32);
+  case Type::real64:
+    return get_range(m_real64);
+  case Type::integer64:
+    return get_range(m_integer64);
+  case Type::timestamp: {
+    // the regular values are monotonic so only the ends are checked
+    ChartJsRange result;
+    if (m_regular_count) {
+      result.include(double(m_first))
+        .include(double(m_first + s64(m_regular_count - 1) * m_step));
+    }
+    for (size_t i = m_regular_count; i < m_timestamp_count; i++) {
+      result.include(double(timestamp_at(i)));
+    }
+    return result;
+  }
+  }
+  return ChartJsRange();
+}
+
+ChartJsAxisTicks ChartJsAxisTicks::create_linear(double minimum,
+                                                 double maximum,
+                                                 size_t tick_count) {
+  if (!(minimum <= maximum)) {
+    return ChartJsAxisTicks();
+  }
+  if (minimum == maximum) {
+    // a constant is shown in the middle of the axis
+    const double margin = minimum != 0.0 ? fabs(minimum) * 0.1 : 1.0;
+    minimum -= margin;
+    maximum += margin;
+  }
+
+  const double raw_step = (maximum - minimum) / (tick_count ? tick_count : 1);
+  const double exponent = floor(log10(raw_step));
+  // a multiple of the power of 10 is divided by its (exact) inverse
+  // rather than multiplied by it, so 7 tenths is 0.7 rather than
+  // 0.7000000000000001
+  const double scale = pow(10.0, fabs(exponent));
+  auto to_value = [&](double multiple) {
+    return exponent < 0.0 ? multiple / scale : multiple * scale;
+  };
+  const double fraction = raw_step / to_value(1.0);
+  const double factor = fraction <= 1.0   ? 1.0
+                        : fraction <= 2.0 ? 2.0
+                        : fraction <= 5.0 ? 5.0
+                                          : 10.0;
+  const double step = to_value(factor);
+  // the tolerance keeps a bound that is a multiple of the step (but not
+  // exactly in binary) from gaining a step
+  const double tolerance = 1e-9;
+  return ChartJsAxisTicks()
+    .set_minimum(to_value(floor(minimum / step + tolerance) * factor))
+    .set_maximum(to_value(ceil(maximum / step - tolerance) * factor))
+    .set_step_size(step);
+}
+
+ChartJsAxisTicks ChartJsAxisTicks::create_logarithmic(double minimum,
+                                                      double maximum) {
+  if (!(minimum > 0.0 && minimum <= maximum)) {
+    return ChartJsAxisTicks();
+  }
+  const double lower = pow(10.0, floor(log10(minimum)));
+  const double upper = pow(10.0, ceil(log10(maximum)));
+  return ChartJsAxisTicks().set_minimum(lower).set_maximum(
+    upper > lower ? upper : lower * 10.0);
+}
+
+ChartJsScales &ChartJsScales::calculate_ranges(const ChartJsData &data) {
+  var::Vector<ChartJsRange> x_range_list(x_axes().count());
+  var::Vector<ChartJsRange> y_range_list(y_axes().count());
+
+  for (const auto &dataset : data.dataset_list()) {
+    // y only datasets are placed by the labels
+    const size_t x_index = get_axis_index(x_axes(), dataset.x_axis_id());
+    if (x_index != no_axis && x_axes().at(x_index).is_auto_range()
+        && dataset.is_point_xy()) {
+      x_range_list.at(x_index).include(dataset.x_column().calculate_range());
+    }
+
+    const size_t y_index = get_axis_index(y_axes(), dataset.y_axis_id());
+    if (y_index != no_axis && y_axes().at(y_index).is_auto_range()) {
+      y_range_list.at(y_index).include(dataset.y_column().calculate_range());
+    }
+  }
+
+  update_ticks(x_axes(), x_range_list);
+  update_ticks(y_axes(), y_range_list);
+  return *this;
+}
+
+size_t ChartJsScales::get_axis_index(const var::Vector<ChartJsAxis> &axes,
+                                     var::StringView id) {
+  if (id.is_empty()) {
+    return axes.count() ? 0 : no_axis;
+  }
+  for (size_t i = 0; i < axes.count(); i++) {
+    if (axes.at(i).id() == id) {
+      return i;
+    }
+  }
+  return no_axis;
+}
+
+void ChartJsScales::update_ticks(var::Vector<ChartJsAxis> &axes,
+                                 const var::Vector<ChartJsRange> &range_list) {
+  for (size_t i = 0; i < axes.count(); i++) {
+    ChartJsAxis &axis = axes.at(i);
+    const ChartJsRange &range = range_list.at(i);
+    if (!axis.is_auto_range() || !range.is_valid()) {
+      continue;
+    }
+    if (axis.type() == ChartJsAxis::Type::linear) {
+      axis.set_ticks(ChartJsAxisTicks::create_linear(
+        range.minimum(), range.maximum(), axis.tick_count()));
+    } else if (axis.type() == ChartJsAxis::Type::logarithmic
+               && range.is_positive_valid()) {
+      axis.set_ticks(ChartJsAxisTicks::create_logarithmic(
+        range.positive_minimum(), range.maximum()));
+    }
+  }
+}
@@ -0,0 +1,237 @@
+// Copyright 2020-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include "chart/ChartJs.hpp"
+
+using namespace chart;
+
+namespace {
+constexpr size_t block_size = ChartJsTransform::Evaluator::block_size;
+// independent sums so the fit reduction vectorizes
+constexpr size_t lane_count = 8;
+
+template <typename T>
+void load_list(const var::Vector<T> &list, size_t head, size_t offset,
+               size_t count, double *result) {
+  // a rolling column with a head is full, the values wrap at the end
+  size_t position = head + offset;
+  position = position < list.count() ? position : position - list.count();
+  const size_t first_count
+    = count < list.count() - position ? count : list.count() - position;
+  const T *values = list.data();
+  for (size_t i = 0; i < first_count; i++) {
+    result[i] = double(values[position + i]);
+  }
+  for (size_t i = first_count; i < count; i++) {
+    result[i] = double(values[i - first_count]);
+  }
+}
+
+void load_column(const ChartJsDataColumn &column, size_t offset, size_t count,
+                 double *result) {
+  switch (column.type()) {
+  case ChartJsDataColumn::Type::real32:
+    load_list(column.real32(), column.head(), offset, count, result);
+    return;
+  case ChartJsDataColumn::Type::real64:
+    load_list(column.real64(), column.head(), offset, count, result);
+    return;
+  case ChartJsDataColumn::Type::integer64:
+    load_list(column.integer64(), column.head(), offset, count, result);
+    return;
+  default:
+    break;
+  }
+  for (size_t i = 0; i < count; i++) {
+    result[i] = column.at(offset + i);
+  }
+}
+
+bool is_finite(double value) { return value - value == 0.0; }
+} // namespace
+
+ChartJsDataSet
+ChartJsTransform::create_dataset(const ChartJsDataSet &source) const {
+  ChartJsDataSet result;
+  const size_t point_count = source.point_count();
+  if (source.is_point_xy()) {
+    result.x_column() = source.x_column();
+  }
+  result.y_column().set_type(ChartJsDataColumn::Type::real64);
+  result.y_column().reserve(point_count);
+
+  Evaluator evaluator(*this, source.x_column(), source.y_column(), point_count);
+  while (evaluator.calculate_next()) {
+    result.y_column().append(evaluator.value_list(), evaluator.count());
+  }
+  return result;
+}
+
+ChartJsTransform::Evaluator::Evaluator(const ChartJsTransform &transform,
+                                       const ChartJsDataColumn &x_column,
+                                       const ChartJsDataColumn &y_column,
+                                       size_t point_count)
+  : m_transform(transform), m_x_column(x_column), m_y_column(y_column),
+    m_point_count(point_count) {
+  if (transform.function() == Function::linear_fit) {
+    calculate_fit();
+  }
+}
+
+bool ChartJsTransform::Evaluator::calculate_next() {
+  m_offset += m_count;
+  m_count = m_point_count - m_offset;
+  m_count = m_count < block_size ? m_count : block_size;
+  if (m_count == 0) {
+    return false;
+  }
+
+  double x_list[block_size];
+  double y_list[block_size];
+  load(m_offset, m_count, x_list, y_list);
+  double *result = m_value_list;
+
+  switch (m_transform.function()) {
+  case Function::none:
+    for (size_t i = 0; i < m_count; i++) {
+      result[i] = y_list[i];
+    }
+    break;
+
+  case Function::moving_average: {
+    // the values leaving the window (nan before the window is full)
+    const size_t window_size = m_transform.window_size();
+    double leaving_list[block_size];
+    size_t start = window_size > m_offset ? window_size - m_offset : 0;
+    start = start < m_count ? start : m_count;
+    for (size_t i = 0; i < start; i++) {
+      leaving_list[i] = NAN;
+    }
+    if (start < m_count) {
+      load_column(
+        m_y_column, m_offset + start - window_size, m_count - start,
+        leaving_list + start);
+    }
+    for (size_t i = 0; i < m_count; i++) {
+      const double entering = y_list[i];
+      const double leaving = leaving_list[i];
+      const bool is_entering = is_finite(entering);
+      const bool is_leaving = is_finite(leaving);
+      m_sum += (is_entering ? entering : 0.0) - (is_leaving ? leaving : 0.0);
+      m_sum_count += size_t(is_entering) - size_t(is_leaving);
+      // an empty window drops the accumulated rounding
+      m_sum = m_sum_count ? m_sum : 0.0;
+      result[i] = m_sum_count ? m_sum / double(m_sum_count) : NAN;
+    }
+  } break;
+
+  case Function::exponential_average: {
+    const double alpha = m_transform.alpha();
+    for (size_t i = 0; i < m_count; i++) {
+      const double value = y_list[i];
+      if (is_finite(value)) {
+        m_sum = m_sum_count ? m_sum + alpha * (value - m_sum) : value;
+        m_sum_count = 1;
+      }
+      result[i] = m_sum_count ? m_sum : NAN;
+    }
+  } break;
+
+  case Function::rate: {
+    // element-wise after the first point of the block
+    const double x_unit = m_transform.x_unit();
+    result[0] = (y_list[0] - m_previous_y) / (x_list[0] - m_previous_x) * x_unit;
+    for (size_t i = 1; i < m_count; i++) {
+      result[i] = (y_list[i] - y_list[i - 1]) / (x_list[i] - x_list[i - 1])
+                  * x_unit;
+    }
+    m_previous_x = x_list[m_count - 1];
+    m_previous_y = y_list[m_count - 1];
+  } break;
+
+  case Function::cumulative_sum:
+    for (size_t i = 0; i < m_count; i++) {
+      const double value = y_list[i];
+      m_sum += is_finite(value) ? value : 0.0;
+      result[i] = m_sum;
+    }
+    break;
+
+  case Function::linear_fit:
+    for (size_t i = 0; i < m_count; i++) {
+      result[i] = m_intercept + m_slope * (x_list[i] - m_origin);
+    }
+    break;
+  }
+  return true;
+}
+
+void ChartJsTransform::Evaluator::load(size_t offset, size_t count,
+                                       double *x_list, double *y_list) const {
+  load_column(m_y_column, offset, count, y_list);
+  if (m_x_column.is_empty()) {
+    for (size_t i = 0; i < count; i++) {
+      x_list[i] = double(offset + i);
+    }
+  } else {
+    load_column(m_x_column, offset, count, x_list);
+  }
+  for (size_t i = count; i < block_size; i++) {
+    x_list[i] = NAN;
+    y_list[i] = NAN;
+  }
+}
+
+void ChartJsTransform::Evaluator::calculate_fit() {
+  // x is offset from the first x so timestamps keep their precision in
+  // the sum of squares
+  if (m_point_count) {
+    m_origin = m_x_column.is_empty() ? 0.0 : m_x_column.at(0);
+    m_origin = is_finite(m_origin) ? m_origin : 0.0;
+  }
+
+  double count[lane_count] = {};
+  double x_sum[lane_count] = {};
+  double y_sum[lane_count] = {};
+  double xx_sum[lane_count] = {};
+  double xy_sum[lane_count] = {};
+  double x_list[block_size];
+  double y_list[block_size];
+  for (size_t offset = 0; offset < m_point_count; offset += block_size) {
+    const size_t remaining = m_point_count - offset;
+    load(offset, remaining < block_size ? remaining : block_size, x_list,
+         y_list);
+    // padding is nan and is skipped with the non-finite points
+    for (size_t i = 0; i < block_size; i += lane_count) {
+      for (size_t lane = 0; lane < lane_count; lane++) {
+        const double x = x_list[i + lane] - m_origin;
+        const double y = y_list[i + lane];
+        const bool is_point = is_finite(x) && is_finite(y);
+        const double dx = is_point ? x : 0.0;
+        const double dy = is_point ? y : 0.0;
+        count[lane] += is_point ? 1.0 : 0.0;
+        x_sum[lane] += dx;
+        y_sum[lane] += dy;
+        xx_sum[lane] += dx * dx;
+        xy_sum[lane] += dx * dy;
+      }
+    }
+  }
+
+  for (size_t lane = 1; lane < lane_count; lane++) {
+    count[0] += count[lane];
+    x_sum[0] += x_sum[lane];
+    y_sum[0] += y_sum[lane];
+    xx_sum[0] += xx_sum[lane];
+    xy_sum[0] += xy_sum[lane];
+  }
+  const double n = count[0];
+  if (n == 0.0) {
+    return;
+  }
+  const double denominator = n * xx_sum[0] - x_sum[0] * x_sum[0];
+  // a single x has no slope, the line is the mean
+  m_slope = denominator != 0.0
+              ? (n * xy_sum[0] - x_sum[0] * y_sum[0]) / denominator
+              : 0.0;
+  m_intercept = (y_sum[0] - m_slope * x_sum[0]) / n;
+}
@@ -0,0 +1,574 @@
+// Copyright 2020-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "chart/ChartJsWriter.hpp"
+
+using namespace chart;
+using namespace var;
+
+namespace {
+// appends ".0" to integer-looking output and removes the '+' and leading
+// zeros from the exponent (jansson's jsonp_dtostr() rules)
+size_t clean_real(char *buffer, size_t length) {
+  // a real must not be mistaken for an integer when decoded
+  if (strchr(buffer, '.') == nullptr && strchr(buffer, 'e') == nullptr) {
+    buffer[length++] = '.';
+    buffer[length++] = '0';
+    buffer[length] = '\0';
+  }
+
+  char *start = strchr(buffer, 'e');
+  if (start != nullptr) {
+    start++;
+    char *end = start + 1;
+    if (*start == '-') {
+      start++;
+    }
+    while (*end == '0') {
+      end++;
+    }
+    if (end != start) {
+      memmove(start, end, length - size_t(end - buffer) + 1);
+      length -= size_t(end - start);
+    }
+  }
+
+  return length;
+}
+
+// significant digits of a real with the exponent of the first digit
+struct Decimal {
+  char digits[20];
+  int count;
+  int exponent;
+  bool is_negative;
+};
+
+// length of the longest shortest output: sign, 17 digits, "0.000" or an
+// exponent, and ".0"
+constexpr size_t shortest_capacity = 32;
+
+Decimal parse_scientific(const char *text) {
+  Decimal result;
+  result.is_negative = *text == '-';
+  if (result.is_negative) {
+    text++;
+  }
+  result.count = 0;
+  for (; *text != 'e'; text++) {
+    if (*text != '.') {
+      result.digits[result.count++] = *text;
+    }
+  }
+  result.exponent = atoi(text + 1);
+  return result;
+}
+
+// rounds source to count digits, returns false if the dropped digits are
+// exactly half (source may already be rounded up, so it cannot decide)
+bool round_decimal(const Decimal &source, int count, Decimal &result) {
+  result = source;
+  result.count = count;
+  bool is_round_up = source.digits[count] > '5';
+  if (source.digits[count] == '5') {
+    for (int i = count + 1; i < source.count; i++) {
+      if (source.digits[i] != '0') {
+        is_round_up = true;
+        break;
+      }
+    }
+    if (!is_round_up) {
+      return false;
+    }
+  }
+
+  if (is_round_up) {
+    int i = count - 1;
+    while (i >= 0 && result.digits[i] == '9') {
+      result.digits[i--] = '0';
+    }
+    if (i < 0) {
+      result.digits[0] = '1';
+      result.exponent++;
+    } else {
+      result.digits[i]++;
+    }
+  }
+  return true;
+}
+
+// d.ddde+x, readable by strtod()
+size_t write_scientific(const Decimal &value, char *buffer) {
+  char *cursor = buffer;
+  if (value.is_negative) {
+    *cursor++ = '-';
+  }
+  *cursor++ = value.digits[0];
+  if (value.count > 1) {
+    *cursor++ = '.';
+    memcpy(cursor, value.digits + 1, size_t(value.count - 1));
+    cursor += value.count - 1;
+  }
+  *cursor++ = 'e';
+  *cursor++ = value.exponent < 0 ? '-' : '+';
+  const int exponent = value.exponent < 0 ? -value.exponent : value.exponent;
+  if (exponent >= 100) {
+    *cursor++ = char('0' + exponent / 100);
+  }
+  if (exponent >= 10) {
+    *cursor++ = char('0' + (exponent / 10) % 10);
+  }
+  *cursor++ = char('0' + exponent % 10);
+  *cursor = '\0';
+  return size_t(cursor - buffer);
+}
+
+// the same output as %.*g with value.count digits
+size_t write_general(Decimal value, char *buffer) {
+  const int precision = value.count;
+  while (value.count > 1 && value.digits[value.count - 1] == '0') {
+    value.count--;
+  }
+
+  if (value.exponent < -4 || value.exponent >= precision) {
+    return write_scientific(value, buffer);
+  }
+
+  char *cursor = buffer;
+  if (value.is_negative) {
+    *cursor++ = '-';
+  }
+  if (value.exponent < 0) {
+    *cursor++ = '0';
+    *cursor++ = '.';
+    for (int i = value.exponent + 1; i < 0; i++) {
+      *cursor++ = '0';
+    }
+    memcpy(cursor, value.digits, size_t(value.count));
+    cursor += value.count;
+  } else {
+    for (int i = 0; i <= value.exponent; i++) {
+      *cursor++ = i < value.count ? value.digits[i] : '0';
+    }
+    if (value.count > value.exponent + 1) {
+      *cursor++ = '.';
+      memcpy(cursor, value.digits + value.exponent + 1,
+             size_t(value.count - value.exponent - 1));
+      cursor += value.count - value.exponent - 1;
+    }
+  }
+  *cursor = '\0';
+  return size_t(cursor - buffer);
+}
+
+// the fewest digits that read back as value. The digits are printed once
+// with the maximum precision (9 for float, 17 for double) and shorter
+// candidates are rounded from them. %.6g (%.15g) is the shortest when
+// any representation with that many digits reads back the same, so
+// candidates start there.
+size_t format_shortest(char *buffer, double value, bool is_float) {
+  const int minimum = is_float ? 6 : 15;
+  const int maximum = is_float ? 9 : 17;
+
+  char text[shortest_capacity];
+  snprintf(text, sizeof(text), "%.*e", maximum - 1, value);
+  const Decimal exact = parse_scientific(text);
+
+  for (int count = minimum; count < maximum; count++) {
+    Decimal candidate;
+    if (!round_decimal(exact, count, candidate)) {
+      snprintf(text, sizeof(text), "%.*e", count - 1, value);
+      candidate = parse_scientific(text);
+    }
+    write_scientific(candidate, text);
+    const bool is_recovered = is_float
+                                ? strtof(text, nullptr) == float(value)
+                                : strtod(text, nullptr) == value;
+    if (is_recovered) {
+      return write_general(candidate, buffer);
+    }
+  }
+
+  return write_general(exact, buffer);
+}
+
+// removes trailing zeros (and a trailing '.') from fixed notation
+size_t trim_fraction(char *buffer, size_t length) {
+  if (strchr(buffer, '.') == nullptr) {
+    return length;
+  }
+  while (buffer[length - 1] == '0') {
+    length--;
+  }
+  if (buffer[length - 1] == '.') {
+    length--;
+  }
+  buffer[length] = '\0';
+  return length;
+}
+} // namespace
+
+size_t ChartJsRealFormat::format(char *buffer, size_t capacity,
+                                 double value) const {
+  return format(buffer, capacity, value, false);
+}
+
+size_t ChartJsRealFormat::format(char *buffer, size_t capacity,
+                                 float value) const {
+  return format(buffer, capacity, value, true);
+}
+
+size_t ChartJsRealFormat::format(char *buffer, size_t capacity, double value,
+                                 bool is_float) const {
+  if (!std::isfinite(value)) {
+    return 0;
+  }
+
+  int result = -1;
+  switch (style()) {
+  case Style::exact:
+    return ChartJsWriter::format_real(buffer, capacity, value);
+  case Style::inherit:
+  case Style::shortest:
+    if (capacity < shortest_capacity) {
+      return 0;
+    }
+    result = int(format_shortest(buffer, value, is_float));
+    break;
+  case Style::fixed:
+    result = snprintf(buffer, capacity, "%.*f", int(precision()), value);
+    if (result < 0 || size_t(result) + 3 >= capacity) {
+      // very large values do not fit in fixed notation
+      return ChartJsWriter::format_real(buffer, capacity, value);
+    }
+    result = int(trim_fraction(buffer, size_t(result)));
+    break;
+  case Style::significant:
+    result = snprintf(buffer, capacity, "%.*g",
+                      precision() ? int(precision()) : 1, value);
+    break;
+  }
+
+  if (result < 0 || size_t(result) + 3 >= capacity) {
+    return 0;
+  }
+  return clean_real(buffer, size_t(result));
+}
+
+ChartJsWriter &ChartJsWriter::begin_object() {
+  begin_value();
+  write_character('{');
+  return push();
+}
+
+ChartJsWriter &ChartJsWriter::end_object() {
+  pop();
+  return write_character('}');
+}
+
+ChartJsWriter &ChartJsWriter::begin_array() {
+  begin_value();
+  write_character('[');
+  return push();
+}
+
+ChartJsWriter &ChartJsWriter::end_array() {
+  pop();
+  return write_character(']');
+}
+
+ChartJsWriter &ChartJsWriter::write_key(StringView key) {
+  begin_value();
+  write_escaped(key);
+  write_character(':');
+  m_is_after_key = true;
+  return *this;
+}
+
+ChartJsWriter &ChartJsWriter::write_string(StringView value) {
+  begin_value();
+  return write_escaped(value);
+}
+
+ChartJsWriter &ChartJsWriter::write_escaped(StringView value) {
+  write_character('"');
+  const char *start = value.data();
+  const char *end = start + value.length();
+  const char *cursor = start;
+  while (cursor < end) {
+    const unsigned char c = static_cast<unsigned char>(*cursor);
+    if (c != '"' && c != '\\' && c >= 0x20) {
+      cursor++;
+      continue;
+    }
+
+    write_raw(start, cursor - start);
+    switch (c) {
+    case '"':
+      write_raw("\\\"", 2);
+      break;
+    case '\\':
+      write_raw("\\\\", 2);
+      break;
+    case '\b':
+      write_raw("\\b", 2);
+      break;
+    case '\f':
+      write_raw("\\f", 2);
+      break;
+    case '\n':
+      write_raw("\\n", 2);
+      break;
+    case '\r':
+      write_raw("\\r", 2);
+      break;
+    case '\t':
+      write_raw("\\t", 2);
+      break;
+    default: {
+      char sequence[8];
+      const int length = snprintf(sequence, sizeof(sequence), "\\u%04X", c);
+      write_raw(sequence, length);
+    } break;
+    }
+    start = ++cursor;
+  }
+  write_raw(start, end - start);
+  return write_character('"');
+}
+
+ChartJsWriter &ChartJsWriter::write_real(double value) {
+  if (!std::isfinite(value)) {
+    return write_null();
+  }
+  begin_value();
+  char buffer[64];
+  return write_raw(buffer,
+                   m_real_format.format(buffer, sizeof(buffer), value));
+}
+
+ChartJsWriter &ChartJsWriter::write_real(float value) {
+  if (!std::isfinite(value)) {
+    return write_null();
+  }
+  begin_value();
+  char buffer[64];
+  return write_raw(buffer,
+                   m_real_format.format(buffer, sizeof(buffer), value));
+}
+
+ChartJsWriter &ChartJsWriter::write_integer(s64 value) {
+  begin_value();
+  char buffer[24];
+  const int length =
+    snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(value));
+  return write_raw(buffer, length);
+}
+
+ChartJsWriter &ChartJsWriter::write_bool(bool value) {
+  begin_value();
+  return value ? write_raw("true", 4) : write_raw("false", 5);
+}
+
+ChartJsWriter &ChartJsWriter::write_null() {
+  begin_value();
+  return write_raw("null", 4);
+}
+
+ChartJsWriter &ChartJsWriter::write_value(const json::JsonValue &value) {
+  if (m_real_format.style() != ChartJsRealFormat::Style::exact) {
+    return write_tree(value);
+  }
+
+  begin_value();
+  // jansson only dumps objects and arrays, so the value is wrapped in an
+  // array and the brackets are dropped
+  const var::String result =
+    json::JsonDocument()
+      .set_flags(json::JsonDocument::Option::compact)
+      .stringify(json::JsonArray().append(value));
+  if (result.length() < 2) {
+    return *this;
+  }
+  return write_raw(result.string_view().get_substring(
+    StringView::GetSubstring().set_position(1).set_length(
+      result.length() - 2)));
+}
+
+ChartJsWriter &ChartJsWriter::write_tree(const json::JsonValue &value) {
+  using Type = json::JsonValue::Type;
+  switch (value.type()) {
+  case Type::object: {
+    const json::JsonObject object = value.to_object();
+    begin_object();
+    for (const auto &key : object.get_key_list()) {
+      write_key(key.string_view());
+      write_tree(object.at(key.string_view()));
+    }
+    return end_object();
+  }
+  case Type::array: {
+    const json::JsonArray array = value.to_array();
+    begin_array();
+    for (size_t i = 0; i < array.count(); i++) {
+      write_tree(array.at(i));
+    }
+    return end_array();
+  }
+  case Type::string:
+    return write_string(StringView(value.to_cstring()));
+  case Type::real: {
+    const double real = get_real(value);
+    const float narrow = float(real);
+    return double(narrow) == real ? write_real(narrow) : write_real(real);
+  }
+  case Type::integer:
+    return write_integer(get_integer(value));
+  case Type::true_:
+    return write_bool(true);
+  case Type::false_:
+    return write_bool(false);
+  case Type::null:
+  case Type::invalid:
+    break;
+  }
+  return write_null();
+}
+
+ChartJsWriter &ChartJsWriter::write_fragment(StringView members) {
+  if (members.is_empty()) {
+    return *this;
+  }
+  begin_value();
+  return write_raw(members);
+}
+
+ChartJsWriter &ChartJsWriter::write_base64(const void *data, size_t size) {
+  static const char alphabet[]
+    = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  const u8 *cursor = reinterpret_cast<const u8 *>(data);
+  char group[4];
+  while (size) {
+    const u32 value = u32(cursor[0]) << 16
+                      | (size > 1 ? u32(cursor[1]) << 8 : 0)
+                      | (size > 2 ? u32(cursor[2]) : 0);
+    group[0] = alphabet[(value >> 18) & 0x3f];
+    group[1] = alphabet[(value >> 12) & 0x3f];
+    group[2] = size > 1 ? alphabet[(value >> 6) & 0x3f] : '=';
+    group[3] = size > 2 ? alphabet[value & 0x3f] : '=';
+    write_raw(group, sizeof(group));
+    const size_t page = size < 3 ? size : 3;
+    cursor += page;
+    size -= page;
+  }
+  return *this;
+}
+
+ChartJsWriter &ChartJsWriter::write_sidecar(const void *data, size_t size) {
+  if (m_sidecar != nullptr && size) {
+    m_sidecar->write(View(data, size));
+    m_sidecar_size += size;
+  }
+  return *this;
+}
+
+ChartJsWriter &ChartJsWriter::write_string_list(const StringList &list) {
+  begin_array();
+  for (const auto &item : list) {
+    write_string(item.string_view());
+  }
+  return end_array();
+}
+
+ChartJsWriter &ChartJsWriter::write_integer_list(const Vector<s32> &list) {
+  begin_array();
+  for (const auto item : list) {
+    write_integer(item);
+  }
+  return end_array();
+}
+
+ChartJsWriter &ChartJsWriter::flush() {
+  // on error, the remaining output is discarded
+  if (m_length && is_success()) {
+    if (m_file != nullptr) {
+      m_file->write(View(m_buffer, m_length));
+    } else {
+      m_callback(m_context, m_buffer, m_length);
+    }
+    m_size += m_length;
+  }
+  m_length = 0;
+  return *this;
+}
+
+size_t ChartJsWriter::format_real(char *buffer, size_t capacity, double value) {
+  // same rules as jansson's jsonp_dtostr() with the default precision
+  int result = snprintf(buffer, capacity, "%.17g", value);
+  if (result < 0 || size_t(result) + 3 >= capacity) {
+    return 0;
+  }
+  return clean_real(buffer, size_t(result));
+}
+
+json::JsonValue ChartJsWriter::create_integer(s64 value) {
+  return json::JsonValue(json_integer(json_int_t(value)));
+}
+
+s64 ChartJsWriter::get_integer(const json::JsonValue &value) {
+  return s64(json_integer_value(value.m_value));
+}
+
+double ChartJsWriter::get_real(const json::JsonValue &value) {
+  return json_real_value(value.m_value);
+}
+
+ChartJsWriter &ChartJsWriter::write_raw(const char *value, size_t length) {
+  while (length) {
+    if (m_length == buffer_size) {
+      flush();
+    }
+    const size_t space = buffer_size - m_length;
+    const size_t page = length < space ? length : space;
+    memcpy(m_buffer + m_length, value, page);
+    m_length += page;
+    value += page;
+    length -= page;
+  }
+  return *this;
+}
+
+void ChartJsWriter::begin_value() {
+  if (m_is_after_key) {
+    m_is_after_key = false;
+    return;
+  }
+
+  if (m_depth == 0) {
+    return;
+  }
+
+  const u32 mask = 1UL << (m_depth - 1);
+  if (m_has_member & mask) {
+    write_character(',');
+  } else {
+    m_has_member |= mask;
+  }
+}
+
+ChartJsWriter &ChartJsWriter::push() {
+  API_ASSERT(m_depth < maximum_depth);
+  m_depth++;
+  m_has_member &= ~(1UL << (m_depth - 1));
+  return *this;
+}
+
+ChartJsWriter &ChartJsWriter::pop() {
+  API_ASSERT(m_depth > 0);
+  m_depth--;
+  return *this;
+}
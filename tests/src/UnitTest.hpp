@@ -1,5 +1,8 @@
 ﻿
 #include <cstdio>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 
 #include "chrono.hpp"
 #include "fs.hpp"
@@ -9,18 +12,2711 @@
 
 #include "json.hpp"
 
+#include "chart.hpp"
+
 #include "test/Test.hpp"
 
+#if defined __link
+#if !defined __win32
+#include <sys/resource.h>
+#endif
+// defined in main.cpp
+extern size_t allocation_count;
+#endif
+
 class UnitTest : public test::Test {
 public:
 
   UnitTest(var::StringView name) : test::Test(name) {}
 
   bool execute_class_api_case() {
+    TEST_ASSERT_RESULT(column_api_case());
+    TEST_ASSERT_RESULT(writer_api_case());
+    TEST_ASSERT_RESULT(decimation_api_case());
+    TEST_ASSERT_RESULT(rdp_api_case());
+    TEST_ASSERT_RESULT(auto_range_api_case());
+    TEST_ASSERT_RESULT(transform_api_case());
+    TEST_ASSERT_RESULT(point_source_api_case());
+    TEST_ASSERT_RESULT(level_of_detail_api_case());
+    TEST_ASSERT_RESULT(rolling_api_case());
+    TEST_ASSERT_RESULT(delta_api_case());
+    TEST_ASSERT_RESULT(properties_cache_api_case());
+    TEST_ASSERT_RESULT(color_api_case());
+    TEST_ASSERT_RESULT(real_format_api_case());
+    TEST_ASSERT_RESULT(loader_api_case());
+    TEST_ASSERT_RESULT(parallel_api_case());
+    TEST_ASSERT_RESULT(encoding_api_case());
+    TEST_ASSERT_RESULT(aggregation_api_case());
+    TEST_ASSERT_RESULT(timestamp_api_case());
+    TEST_ASSERT_RESULT(arena_api_case());
+    TEST_ASSERT_RESULT(move_api_case());
+    TEST_ASSERT_RESULT(options_template_api_case());
+    TEST_ASSERT_RESULT(dashboard_api_case());
+    TEST_ASSERT_RESULT(label_table_api_case());
+    TEST_ASSERT_RESULT(chunk_writer_api_case());
+    return true;
+  }
+
+  bool execute_class_performance_case() {
+#if defined __link
+    const size_t point_count_list[] = {1000, 10000, 100000, 1000000, 10000000};
+#else
+    const size_t point_count_list[] = {1000, 10000};
+#endif
+
+    for (const size_t point_count : point_count_list) {
+      TEST_ASSERT_RESULT(serialization_performance_case(point_count));
+    }
+    TEST_ASSERT_RESULT(color_performance_case());
+    TEST_ASSERT_RESULT(aggregation_performance_case());
+    TEST_ASSERT_RESULT(dashboard_performance_case());
+    TEST_ASSERT_RESULT(label_table_performance_case());
+    TEST_ASSERT_RESULT(chunk_writer_performance_case());
+    TEST_ASSERT_RESULT(rdp_performance_case());
+    TEST_ASSERT_RESULT(auto_range_performance_case());
+    TEST_ASSERT_RESULT(transform_performance_case());
+    TEST_ASSERT_RESULT(point_source_performance_case());
+    return true;
+  }
+
+  bool serialization_performance_case(size_t point_count) {
+    // the jansson tree needs ~100 bytes per point
+    constexpr size_t object_point_count_limit = 1000000;
+
+    ChartJs chart;
+    Measurement construct;
+    {
+      ChartJsDataSet dataset;
+      dataset.set_label("benchmark");
+      for (size_t i = 0; i < point_count; i++) {
+        dataset.append_point(i * 0.001f, sinf(i * 0.001f));
+      }
+      chart.data().append(dataset);
+    }
+    print_measurement("construct", point_count, construct.stop(), 0);
+
+    class Counter {
+    public:
+      static void update(void *context, const char *, size_t size) {
+        *reinterpret_cast<size_t *>(context) += size;
+      }
+    };
+
+    size_t size = 0;
+    Measurement write;
+    {
+      ChartJsWriter writer(&size, Counter::update);
+      chart.write(writer);
+    }
+    print_measurement("write", point_count, write.stop(), size);
+    TEST_ASSERT(size > point_count);
+
+    chart.data().dataset_list().at(0).set_data_encoding(
+      ChartJsDataSet::DataEncoding::base64);
+    size = 0;
+    Measurement write_base64;
+    {
+      ChartJsWriter writer(&size, Counter::update);
+      chart.write(writer);
+    }
+    print_measurement("writeBase64", point_count, write_base64.stop(), size);
+    chart.data().dataset_list().at(0).set_data_encoding(
+      ChartJsDataSet::DataEncoding::json);
+
+    TEST_ASSERT_RESULT(parallel_performance_case(point_count));
+
+    if (point_count > object_point_count_limit) {
+      return true;
+    }
+
+    Measurement to_object;
+    const json::JsonObject object = chart.to_object();
+    print_measurement("toObject", point_count, to_object.stop(), 0);
+
+    Measurement stringify;
+    const var::String result = json::JsonDocument()
+                                 .set_flags(json::JsonDocument::Option::compact)
+                                 .stringify(object);
+    print_measurement(
+      "stringify", point_count, stringify.stop(), result.length());
+    TEST_ASSERT(result.length() > point_count);
+
+    {
+      // the tree is released with the arena
+      ChartJsArena arena;
+      Measurement to_object_arena;
+      {
+        ChartJsArena::Scope scope(arena);
+        const json::JsonObject arena_object = chart.to_object();
+      }
+      print_measurement(
+        "toObjectArena", point_count, to_object_arena.stop(), arena.used());
+    }
+
+    return true;
+  }
+
+  bool parallel_performance_case(size_t point_count) {
+    // the points split across 8 datasets
+    constexpr size_t dataset_count = 8;
+    ChartJs chart;
+    for (size_t i = 0; i < dataset_count; i++) {
+      ChartJsDataSet dataset;
+      for (size_t j = 0; j < point_count / dataset_count; j++) {
+        dataset.append_point(j * 0.001f, sinf(j * 0.001f + i));
+      }
+      chart.data().append(dataset);
+    }
+
+    for (u32 thread_count = 1; thread_count <= dataset_count;
+         thread_count *= 2) {
+      class Counter {
+      public:
+        static void update(void *context, const char *, size_t size) {
+          *reinterpret_cast<size_t *>(context) += size;
+        }
+      };
+
+      size_t size = 0;
+      Measurement write;
+      {
+        ChartJsWriter writer(&size, Counter::update);
+        writer.set_thread_count(thread_count);
+        chart.write(writer);
+      }
+      print_measurement(
+        var::GeneralString("write")
+          .append(format_size(thread_count).string_view())
+          .append("Threads")
+          .string_view(),
+        point_count, write.stop(), size);
+    }
+    return true;
+  }
+
+  bool color_performance_case() {
+    constexpr size_t color_count = 100000;
+    size_t size = 0;
+    Measurement palette;
+    for (u32 i = 0; i < color_count; i++) {
+      size += ChartJsColor::get_standard(i).to_string().length();
+    }
+    print_measurement("palette", color_count, palette.stop(), size);
+    return true;
+  }
+
+  bool aggregation_performance_case() {
+    constexpr size_t sample_count = 1000000;
+    // 100 samples per second into minute buckets
+    ChartJsTimeAggregation aggregation;
+    aggregation.add_statistic(ChartJsTimeAggregation::Statistic::mean)
+      .add_statistic(ChartJsTimeAggregation::Statistic::minimum)
+      .add_statistic(ChartJsTimeAggregation::Statistic::maximum)
+      .add_quantile(0.95);
+    Measurement rollup;
+    for (size_t i = 0; i < sample_count; i++) {
+      aggregation.append(s64(i * 10), sin(i * 0.001));
+    }
+    aggregation.flush();
+    print_measurement("rollup", sample_count, rollup.stop(), 0);
+    TEST_ASSERT(aggregation.bucket_count() == sample_count / 6000 + 1);
+
+    ChartJsHistogram histogram(-1.0, 1.0, 100);
+    Measurement bins;
+    for (size_t i = 0; i < sample_count; i++) {
+      histogram.append(sin(i * 0.001));
+    }
+    print_measurement("histogram", sample_count, bins.stop(), 0);
+    return true;
+  }
+
+  bool dashboard_performance_case() {
+    // 30 charts with the same labels, each with a series shared by every
+    // chart and one of its own
+    constexpr size_t chart_count = 30;
+    constexpr size_t point_count = 1000;
+    ChartJsDashboard dashboard;
+    for (size_t i = 0; i < chart_count; i++) {
+      ChartJs &chart = dashboard.emplace_chart();
+      for (size_t j = 0; j < point_count; j++) {
+        chart.data().append_label(var::NumberString(int(j), "%d").string_view());
+      }
+      chart.data().emplace_dataset();
+      chart.data().emplace_dataset();
+      ChartJsDataSet &shared = chart.data().dataset_list().at(0);
+      ChartJsDataSet &own = chart.data().dataset_list().at(1);
+      for (size_t j = 0; j < point_count; j++) {
+        shared.append_point(sinf(j * 0.01f));
+        own.append_point(sinf(j * 0.01f + i));
+      }
+    }
+
+    size_t chart_size = 0;
+    Measurement charts;
+    for (const auto &chart : dashboard.chart_list()) {
+      var::String output;
+      ChartJsWriter writer(&output, append_string);
+      chart.write(writer);
+      writer.flush();
+      chart_size += output.length();
+    }
+    print_measurement(
+      "writeCharts", chart_count * point_count * 2, charts.stop(), chart_size);
+
+    var::String output;
+    Measurement batch;
+    {
+      ChartJsWriter writer(&output, append_string);
+      dashboard.write(writer);
+    }
+    print_measurement(
+      "writeDashboard", chart_count * point_count * 2, batch.stop(),
+      output.length());
+    TEST_ASSERT(output.length() < chart_size / 2);
+    return true;
+  }
+
+  bool label_table_performance_case() {
+    // a million points over 100 hostnames
+    constexpr size_t label_count = 1000000;
+    var::Vector<var::String> host_list;
+    for (int i = 0; i < 100; i++) {
+      host_list.push_back(var::NumberString(i, "host-%d.example.com"));
+    }
+
+    {
+      ChartJsData data;
+      Measurement strings;
+      for (size_t i = 0; i < label_count; i++) {
+        data.append_label(host_list.at(i % 100).string_view());
+      }
+      print_measurement("appendLabel", label_count, strings.stop(), 0);
+    }
+
+    ChartJsData data;
+    data.set_label_table(std::make_shared<ChartJsLabelTable>());
+    Measurement interned;
+    for (size_t i = 0; i < label_count; i++) {
+      data.append_label(host_list.at(i % 100).string_view());
+    }
+    print_measurement("internLabel", label_count, interned.stop(), 0);
+    TEST_ASSERT(data.label_table()->count() == 100);
+    return true;
+  }
+
+  bool chunk_writer_performance_case() {
+    // 64 byte parts such as USB full speed packets
+    constexpr size_t point_count = 100000;
+    ChartJs chart;
+    ChartJsDataSet &dataset = chart.data().emplace_dataset();
+    for (size_t i = 0; i < point_count; i++) {
+      dataset.append_point(float(i), sinf(i * 0.001f));
+    }
+    char buffer[64];
+    size_t size = 0;
+    ChartJsChunkWriter chunk_writer(chart);
+    Measurement chunks;
+    while (const size_t length
+           = chunk_writer.write(var::View(buffer, sizeof(buffer)))) {
+      size += length;
+    }
+    print_measurement("writeChunks", point_count, chunks.stop(), size);
+    TEST_ASSERT(chunks.allocation_count() == 0);
+
+    // each value is encoded once whatever the number of parts
+    dataset.set_data_encoding(ChartJsDataSet::DataEncoding::base64);
+    size = 0;
+    chunk_writer.restart();
+    Measurement encoded;
+    while (const size_t length
+           = chunk_writer.write(var::View(buffer, sizeof(buffer)))) {
+      size += length;
+    }
+    print_measurement("writeEncodedChunks", point_count, encoded.stop(), size);
+    TEST_ASSERT(encoded.allocation_count() == 0);
+    return true;
+  }
+
+  bool point_source_performance_case() {
+#if defined __link
+    constexpr size_t point_count = 10000000;
+#else
+    constexpr size_t point_count = 10000;
+#endif
+    // samples already held by the caller
+    var::Vector<float> samples;
+    samples.reserve(point_count);
+    for (size_t i = 0; i < point_count; i++) {
+      samples.push_back(sinf(i * 0.001f));
+    }
+    auto count_size = [](void *context, const char *, size_t size) {
+      *reinterpret_cast<size_t *>(context) += size;
+    };
+
+    // what the caller did before: copy the samples into the dataset
+    size_t copy_size = 0;
+    Measurement copy;
+    {
+      ChartJsDataSet dataset;
+      dataset.append_points(samples.data(), samples.count());
+      ChartJsWriter writer(&copy_size, count_size);
+      dataset.write(writer);
+    }
+    print_measurement("copyAndWrite", point_count, copy.stop(), copy_size);
+
+    size_t source_size = 0;
+    Measurement source;
+    {
+      ChartJsDataSet dataset;
+      dataset.set_point_source(ChartJsPointSource::create_y(samples));
+      ChartJsWriter writer(&source_size, count_size);
+      dataset.write(writer);
+    }
+    print_measurement("sourceWrite", point_count, source.stop(), source_size);
+    TEST_ASSERT(source_size == copy_size);
+    TEST_ASSERT(source.allocation_count() < 100);
+    return true;
+  }
+
+  bool transform_performance_case() {
+#if defined __link
+    constexpr size_t point_count = 10000000;
+#else
+    constexpr size_t point_count = 10000;
+#endif
+    ChartJsDataSet source;
+    source.reserve_points(point_count);
+    for (size_t i = 0; i < point_count; i++) {
+      source.append_point(float(i), sinf(i * 0.001f) + (i % 7) * 0.1f);
+    }
+
+    // what the caller did before: a second dataset filled point by point
+    Measurement manual;
+    {
+      ChartJsDataSet average;
+      double sum = 0.0;
+      for (size_t i = 0; i < source.point_count(); i++) {
+        sum += source.y_column().at(i);
+        if (i >= 100) {
+          sum -= source.y_column().at(i - 100);
+        }
+        average.append_point(
+          source.x_column().at(i), sum / (i < 100 ? i + 1 : 100));
+      }
+      TEST_ASSERT(average.point_count() == point_count);
+    }
+    print_measurement("manualAverage", point_count, manual.stop(), 0);
+
+    const ChartJsTransform transform_list[]
+      = {ChartJsTransform::create_moving_average(100),
+         ChartJsTransform::create_exponential_average(0.01),
+         ChartJsTransform::create_rate(),
+         ChartJsTransform::create_cumulative_sum(),
+         ChartJsTransform::create_linear_fit()};
+    const char *name_list[]
+      = {"movingAverage", "exponentialAverage", "rate", "cumulativeSum",
+         "linearFit"};
+    for (size_t i = 0; i < sizeof(name_list) / sizeof(name_list[0]); i++) {
+      Measurement create;
+      const ChartJsDataSet derived
+        = transform_list[i].create_dataset(source);
+      print_measurement(name_list[i], point_count, create.stop(), 0);
+      TEST_ASSERT(derived.point_count() == point_count);
+    }
+
+    // written with the derived values in place of y (nothing is stored)
+    var::String raw;
+    Measurement write_raw;
+    {
+      ChartJsWriter writer(&raw, append_string);
+      source.write(writer);
+    }
+    print_measurement("writeRaw", point_count, write_raw.stop(), raw.length());
+
+    source.set_transform(ChartJsTransform::create_moving_average(100));
+    var::String derived;
+    Measurement write_derived;
+    {
+      ChartJsWriter writer(&derived, append_string);
+      source.write(writer);
+    }
+    print_measurement(
+      "writeMovingAverage", point_count, write_derived.stop(),
+      derived.length());
+    return true;
+  }
+
+  bool auto_range_performance_case() {
+#if defined __link
+    constexpr size_t point_count = 10000000;
+#else
+    constexpr size_t point_count = 10000;
+#endif
+    ChartJs chart;
+    {
+      ChartJsDataSet &dataset = chart.data().emplace_dataset();
+      dataset.reserve_points(point_count);
+      for (size_t i = 0; i < point_count; i++) {
+        dataset.append_point(float(i), sinf(i * 0.001f) * i);
+      }
+    }
+    const ChartJsDataSet &dataset = chart.data().dataset_list().at(0);
+
+    // what the caller did before: a pass over the values of each axis
+    Measurement manual;
+    double x_minimum = HUGE_VAL;
+    double x_maximum = -HUGE_VAL;
+    double y_minimum = HUGE_VAL;
+    double y_maximum = -HUGE_VAL;
+    for (size_t i = 0; i < dataset.point_count(); i++) {
+      const double x = dataset.x_column().at(i);
+      const double y = dataset.y_column().at(i);
+      x_minimum = x < x_minimum ? x : x_minimum;
+      x_maximum = x > x_maximum ? x : x_maximum;
+      y_minimum = y < y_minimum ? y : y_minimum;
+      y_maximum = y > y_maximum ? y : y_maximum;
+    }
+    print_measurement("manualRange", point_count, manual.stop(), 0);
+
+    ChartJsScales scales
+      = ChartJsScales()
+          .append_x_axis(ChartJsAxis().set_auto_range())
+          .append_y_axis(ChartJsAxis().set_auto_range());
+    Measurement auto_range;
+    scales.calculate_ranges(chart.data());
+    print_measurement("autoRange", point_count, auto_range.stop(), 0);
+
+    TEST_ASSERT(scales.x_axes().at(0).ticks().minimum() <= x_minimum);
+    TEST_ASSERT(scales.x_axes().at(0).ticks().maximum() >= x_maximum);
+    TEST_ASSERT(scales.y_axes().at(0).ticks().minimum() <= y_minimum);
+    TEST_ASSERT(scales.y_axes().at(0).ticks().maximum() >= y_maximum);
+    return true;
+  }
+
+  bool rdp_performance_case() {
+#if defined __link
+    constexpr size_t point_count = 10000000;
+#else
+    constexpr size_t point_count = 10000;
+#endif
+    // a random walk (the ranges split unevenly)
+    ChartJsDataSet dataset;
+    dataset.reserve_points(point_count);
+    float y = 0.0f;
+    u32 state = 1;
+    for (size_t i = 0; i < point_count; i++) {
+      state = state * 1664525 + 1013904223;
+      y += (state >> 8) * (1.0f / 16777216.0f) - 0.5f;
+      dataset.append_point(float(i), y);
+    }
+    dataset.set_decimation(ChartJsDecimation()
+                             .set_algorithm(ChartJsDecimation::Algorithm::rdp)
+                             .set_epsilon(50.0));
+
+    size_t count = 0;
+    Measurement rdp;
+    dataset.decimation().select(
+      dataset.x_column(), dataset.y_column(), dataset.point_count(), &count,
+      [](void *context, size_t) { (*reinterpret_cast<size_t *>(context))++; });
+    print_measurement("rdp", point_count, rdp.stop(), 0);
+    TEST_ASSERT(count > 2 && count < point_count);
+    return true;
+  }
+
+  bool column_api_case() {
+    float x_values[4];
+    float y_values[4];
+    ChartJsDataSet object_dataset;
+    ChartJsDataSet real_dataset;
+    for (size_t i = 0; i < 4; i++) {
+      x_values[i] = i * 0.1f;
+      y_values[i] = i * 1.7f;
+      object_dataset.append(ChartJsRealDataPoint()
+                                .set_x(x_values[i])
+                                .set_y(y_values[i])
+                                .to_object());
+      real_dataset.append(json::JsonReal(y_values[i]));
+    }
+
+    TEST_ASSERT(
+      stringify(ChartJsDataSet().append_points(x_values, y_values, 4))
+      == stringify(object_dataset));
+
+    TEST_ASSERT(
+      stringify(ChartJsDataSet().append_points(y_values, 4))
+      == stringify(real_dataset));
+
+    ChartJsDataSet integer_dataset;
+    integer_dataset.append_point(s64(1), s64(2));
+    TEST_ASSERT(integer_dataset.x_column().is_integer());
+    TEST_ASSERT(integer_dataset.point_count() == 1);
+
+    // integers beyond 32 bits (epoch milliseconds) are not truncated
+    ChartJsDataSet time_dataset;
+    time_dataset.append_point(s64(1700000000123), s64(-5000000000));
+    var::String written;
+    {
+      ChartJsWriter writer(&written, append_string);
+      writer.set_real_format(
+        ChartJsRealFormat().set_style(ChartJsRealFormat::Style::exact));
+      time_dataset.write(writer);
+    }
+    TEST_ASSERT(written == stringify(time_dataset));
+    TEST_ASSERT(
+      written.string_view().find("{\"x\":1700000000123,\"y\":-5000000000}")
+      != var::StringView::npos);
+
+    return true;
+  }
+
+  bool writer_api_case() {
+    ChartJs chart;
+    chart.options().set_title(ChartJsTitle().set_text("title"));
+    chart.data().label_list().push_back("label\n\"quoted\"");
+
+    ChartJsDataSet dataset;
+    dataset.set_label("dataset")
+      .set_border_color(ChartJsColor::get_standard(1))
+      .append(json::JsonString("string"))
+      .append(ChartJsIntegerDataPoint().set_x(1).set_y(2).to_object());
+    for (u32 i = 0; i < 1000; i++) {
+      dataset.append_point(i * 0.1f, i * 1e-7f);
+    }
+    chart.data().append(dataset);
+
+    fs::DataFile file;
+    {
+      ChartJsWriter writer(file);
+      writer.set_real_format(
+        ChartJsRealFormat().set_style(ChartJsRealFormat::Style::exact));
+      chart.write(writer);
+    }
+    TEST_ASSERT(
+      var::StringView(file.data().add_null_terminator())
+      == json::JsonDocument()
+           .set_flags(json::JsonDocument::Option::compact)
+           .stringify(chart.to_object())
+           .string_view());
+
+    {
+      // json values are not narrowed to an int or a float
+      ChartJsDataSet values;
+      values.append(ChartJsWriter::create_integer(1700000000123))
+        .append(json::JsonReal(0.1 + 0.2))
+        .append(json::JsonReal(0.1f));
+      var::String output;
+      {
+        ChartJsWriter writer(&output, append_string);
+        values.write(writer);
+      }
+      TEST_ASSERT(
+        output.string_view().find(
+          "\"data\":[1700000000123,0.30000000000000004,0.1]")
+        != var::StringView::npos);
+      TEST_ASSERT(
+        ChartJsWriter::get_integer(values.data().at(0)) == 1700000000123);
+    }
+
+    return true;
+  }
+
+  bool decimation_api_case() {
+    const ChartJsDecimation::Algorithm algorithm_list[]
+      = {ChartJsDecimation::Algorithm::lttb,
+         ChartJsDecimation::Algorithm::min_max,
+         ChartJsDecimation::Algorithm::first_last_min_max};
+
+    for (const auto algorithm : algorithm_list) {
+      ChartJsDataSet dataset;
+      for (u32 i = 0; i < 100000; i++) {
+        // a single spike must survive the decimation
+        dataset.append_point(float(i), i == 51234 ? 100.0f : sinf(i * 0.001f));
+      }
+      dataset.set_decimation(
+        ChartJsDecimation().set_algorithm(algorithm).set_sample_count(200));
+
+      const json::JsonArray data = dataset.to_object().at("data").to_array();
+      TEST_ASSERT(data.count() <= 200);
+      float maximum = 0.0f;
+      for (size_t i = 0; i < data.count(); i++) {
+        const float y = data.at(i).to_object().at("y").to_real();
+        maximum = y > maximum ? y : maximum;
+      }
+      TEST_ASSERT(maximum == 100.0f);
+    }
+
+    {
+      // the gap is kept and the extremes are of the finite values
+      ChartJsDataSet dataset;
+      for (const float y : {NAN, 5.0f, -7.0f, 1.0f, 2.0f}) {
+        dataset.append_point(y);
+      }
+      dataset.set_decimation(
+        ChartJsDecimation()
+          .set_algorithm(ChartJsDecimation::Algorithm::min_max)
+          .set_sample_count(2));
+      const json::JsonArray data = dataset.to_object().at("data").to_array();
+      TEST_ASSERT(data.count() == 3);
+      TEST_ASSERT(data.at(0).is_null());
+      TEST_ASSERT(data.at(1).to_real() == 5.0f);
+      TEST_ASSERT(data.at(2).to_real() == -7.0f);
+    }
+
+    for (const auto algorithm : algorithm_list) {
+      ChartJsDataSet dataset;
+      for (u32 i = 0; i < 1000; i++) {
+        const bool is_gap = i >= 400 && i < 420;
+        dataset.append_point(float(i), is_gap ? NAN : sinf(i * 0.01f));
+      }
+      dataset.set_decimation(
+        ChartJsDecimation().set_algorithm(algorithm).set_sample_count(20));
+
+      const json::JsonArray data = dataset.to_object().at("data").to_array();
+      size_t gap_count = 0;
+      for (size_t i = 0; i < data.count(); i++) {
+        const json::JsonValue y = data.at(i).to_object().at("y");
+        gap_count += y.is_null();
+        TEST_ASSERT(y.is_null() || y.is_real());
+      }
+      TEST_ASSERT(gap_count >= 1 && gap_count <= 2);
+      TEST_ASSERT(data.count() > 10 && data.count() <= 22);
+    }
+
+    return true;
+  }
+
+  bool auto_range_api_case() {
+    {
+      const ChartJsAxisTicks ticks
+        = ChartJsAxisTicks::create_linear(0.3, 9.7, 10);
+      TEST_ASSERT(ticks.minimum() == 0.0 && ticks.maximum() == 10.0);
+      TEST_ASSERT(ticks.step_size() == 1.0);
+      // bounds on a step are kept
+      const ChartJsAxisTicks tenths
+        = ChartJsAxisTicks::create_linear(0.1, 0.7, 10);
+      TEST_ASSERT(tenths.minimum() == 0.1 && tenths.maximum() == 0.7);
+      TEST_ASSERT(tenths.step_size() == 0.1);
+      const ChartJsAxisTicks constant
+        = ChartJsAxisTicks::create_linear(5.0, 5.0, 10);
+      TEST_ASSERT(constant.minimum() < 5.0 && constant.maximum() > 5.0);
+      const ChartJsAxisTicks log
+        = ChartJsAxisTicks::create_logarithmic(3.0, 450.0);
+      TEST_ASSERT(log.minimum() == 1.0 && log.maximum() == 1000.0);
+      TEST_ASSERT(!ChartJsAxisTicks::create_logarithmic(0.0, 1.0).is_valid());
+      // millisecond timestamps are beyond float precision
+      const ChartJsAxisTicks timestamps = ChartJsAxisTicks::create_linear(
+        1600000001000.0, 1600000089000.0, 9);
+      TEST_ASSERT(timestamps.minimum() == 1600000000000.0);
+      TEST_ASSERT(timestamps.maximum() == 1600000090000.0);
+      TEST_ASSERT(timestamps.step_size() == 10000.0);
+
+      // max is not truncated
+      TEST_ASSERT(
+        ChartJsAxisTicks().set_minimum(0.0).set_maximum(2.5).to_object().at(
+          "max").to_real()
+        == 2.5f);
+    }
+
+    {
+      // the extremes are in the tail after the last full set of lanes
+      ChartJsDataColumn column;
+      const float values[]
+        = {3.0f, NAN, 2.0f, INFINITY, 0.5f, -1.0f, 4.0f, 2.0f, 1.0f,
+           -INFINITY, 9.0f, -3.0f, 0.25f};
+      column.append(values, sizeof(values) / sizeof(values[0]));
+      const ChartJsRange range = column.calculate_range();
+      TEST_ASSERT(range.minimum() == -3.0 && range.maximum() == 9.0);
+      TEST_ASSERT(range.positive_minimum() == 0.25);
+
+      ChartJsDataColumn timestamp;
+      timestamp.set_type(ChartJsDataColumn::Type::timestamp);
+      for (s64 value : {s64(1000), s64(2000), s64(3000), s64(500), s64(2500)}) {
+        timestamp.append(value);
+      }
+      TEST_ASSERT(timestamp.calculate_range().minimum() == 500.0);
+      TEST_ASSERT(timestamp.calculate_range().maximum() == 3000.0);
+      TEST_ASSERT(!ChartJsDataColumn().calculate_range().is_valid());
+    }
+
+    {
+      ChartJs chart;
+      for (u32 i = 0; i < 3; i++) {
+        chart.data().emplace_dataset();
+      }
+      ChartJsDataSet &left = chart.data().dataset_list().at(0);
+      ChartJsDataSet &right = chart.data().dataset_list().at(1);
+      ChartJsDataSet &other = chart.data().dataset_list().at(2);
+      for (u32 i = 0; i < 1000; i++) {
+        left.append_point(double(i) * 0.01, sin(i * 0.01) * 7.2);
+        right.append_point(s64(i) - 100, s64(i) * s64(i) + 1);
+        other.append_point(double(i), 1e9);
+      }
+      right.set_y_axis_id("right");
+      // bound to an axis that does not exist
+      other.set_x_axis_id("none").set_y_axis_id("none");
+
+      ChartJsScales scales
+        = ChartJsScales()
+            .append_x_axis(ChartJsAxis().set_auto_range().set_tick_count(5))
+            .append_y_axis(ChartJsAxis().set_id("left").set_auto_range())
+            .append_y_axis(
+              ChartJsAxis()
+                .set_id("right")
+                .set_type(ChartJsAxis::Type::logarithmic)
+                .set_auto_range())
+            .calculate_ranges(chart.data());
+
+      const ChartJsAxisTicks &x = scales.x_axes().at(0).ticks();
+      TEST_ASSERT(x.minimum() == -200.0 && x.maximum() == 1000.0);
+      TEST_ASSERT(x.step_size() == 200.0);
+      const ChartJsAxisTicks &left_ticks = scales.y_axes().at(0).ticks();
+      TEST_ASSERT(left_ticks.minimum() == -8.0);
+      TEST_ASSERT(left_ticks.maximum() == 8.0);
+      const ChartJsAxisTicks &right_ticks = scales.y_axes().at(1).ticks();
+      TEST_ASSERT(right_ticks.minimum() == 1.0);
+      TEST_ASSERT(right_ticks.maximum() == 1000000.0);
+
+      const json::JsonObject object = scales.to_object();
+      TEST_ASSERT(
+        object.at("yAxes").to_array().at(0).to_object().at("ticks").to_object().at(
+          "max").to_real()
+        == 8.0f);
+    }
+
+    return true;
+  }
+
+  bool transform_api_case() {
+    auto is_equal = [](const ChartJsDataSet &dataset,
+                       std::initializer_list<double> expected) {
+      if (dataset.point_count() != expected.size()) {
+        return false;
+      }
+      size_t offset = 0;
+      for (const double value : expected) {
+        const double y = dataset.y_column().at(offset++);
+        if (std::isnan(value) ? !std::isnan(y) : fabs(y - value) > 1e-9) {
+          return false;
+        }
+      }
+      return true;
+    };
+
+    {
+      // non-finite values are skipped
+      ChartJsDataSet source;
+      const double values[] = {1.0, 2.0, 3.0, 4.0, NAN, 6.0};
+      source.append_points(values, 6);
+      TEST_ASSERT(is_equal(
+        ChartJsTransform::create_moving_average(3).create_dataset(source),
+        {1.0, 1.5, 2.0, 3.0, 3.5, 5.0}));
+      TEST_ASSERT(is_equal(
+        ChartJsTransform::create_exponential_average(0.5).create_dataset(
+          source),
+        {1.0, 1.5, 2.25, 3.125, 3.125, 4.5625}));
+      TEST_ASSERT(is_equal(
+        ChartJsTransform::create_cumulative_sum().create_dataset(source),
+        {1.0, 3.0, 6.0, 10.0, 10.0, 16.0}));
+      // the rate is per point without x
+      TEST_ASSERT(is_equal(
+        ChartJsTransform::create_rate().create_dataset(source),
+        {NAN, 1.0, 1.0, 1.0, NAN, NAN}));
+      TEST_ASSERT(!ChartJsTransform::create_moving_average(0).is_active());
+    }
+
+    {
+      // a rate per second of millisecond timestamps
+      ChartJsDataSet source;
+      source.x_column().set_type(ChartJsDataColumn::Type::timestamp);
+      source.append_point(s64(0), s64(0))
+        .append_point(s64(1000), s64(10))
+        .append_point(s64(3000), s64(30));
+      source.set_transform(ChartJsTransform::create_rate(1000.0));
+      const json::JsonArray data = source.to_object().at("data").to_array();
+      TEST_ASSERT(data.count() == 3);
+      TEST_ASSERT(data.at(0).to_object().at("y").is_null());
+      TEST_ASSERT(data.at(2).to_object().at("x").to_integer() == 3000);
+      TEST_ASSERT(data.at(2).to_object().at("y").to_real() == 10.0f);
+    }
+
+    {
+      // the fit keeps its precision far from x = 0
+      ChartJsDataSet source;
+      for (s64 i = 0; i < 1000; i++) {
+        source.x_column().append(s64(1700000000000LL) + i * 1000);
+        source.y_column().append(0.002 * (i * 1000) + 5.0);
+      }
+      const ChartJsDataSet fit
+        = ChartJsTransform::create_linear_fit().create_dataset(source);
+      TEST_ASSERT(fit.point_count() == 1000);
+      TEST_ASSERT(fit.x_column().integer_at(999) == 1700000999000LL);
+      for (size_t i = 0; i < 1000; i++) {
+        TEST_ASSERT(
+          fabs(fit.y_column().at(i) - source.y_column().at(i)) < 1e-6);
+      }
+    }
+
+    {
+      // blocks span the wrap of a rolling column
+      ChartJsDataSet source = ChartJsDataSet::create_rolling(100);
+      for (u32 i = 0; i < 250; i++) {
+        source.append_point(float(i), float((i * 37) % 11));
+      }
+      const ChartJsDataSet average
+        = ChartJsTransform::create_moving_average(10).create_dataset(source);
+      TEST_ASSERT(average.point_count() == 100);
+      for (size_t i = 0; i < 100; i++) {
+        double sum = 0.0;
+        const size_t first = i < 9 ? 0 : i - 9;
+        for (size_t j = first; j <= i; j++) {
+          sum += source.y_column().at(j);
+        }
+        TEST_ASSERT(fabs(average.y_column().at(i) - sum / (i - first + 1))
+                    < 1e-9);
+      }
+    }
+
+    {
+      // written in place of y, the same as the stored derived values
+      ChartJs chart;
+      chart.data().emplace_dataset();
+      chart.data().emplace_dataset();
+      chart.data().emplace_dataset();
+      ChartJsDataSet &plain = chart.data().dataset_list().at(0);
+      ChartJsDataSet &decimated = chart.data().dataset_list().at(1);
+      ChartJsDataSet &encoded = chart.data().dataset_list().at(2);
+      for (u32 i = 0; i < 1000; i++) {
+        const float y = sinf(i * 0.05f) + (i % 3) * 0.25f;
+        plain.append_point(i * 0.25f, y);
+        decimated.append_point(i * 0.25f, y);
+        encoded.append_point(i * 0.25f, y);
+      }
+      const ChartJsTransform transform
+        = ChartJsTransform::create_moving_average(20);
+      ChartJsDataSet expected = transform.create_dataset(plain);
+      plain.set_transform(transform);
+      decimated.set_transform(transform).set_decimation(
+        ChartJsDecimation()
+          .set_algorithm(ChartJsDecimation::Algorithm::lttb)
+          .set_sample_count(100));
+      encoded.set_transform(transform).set_data_encoding(
+        ChartJsDataSet::DataEncoding::base64);
+
+      auto stringify = [](const json::JsonValue &value) {
+        return json::JsonDocument()
+          .set_flags(json::JsonDocument::Option::compact)
+          .stringify(value);
+      };
+      TEST_ASSERT(
+        stringify(plain.to_object().at("data"))
+        == stringify(expected.to_object().at("data")));
+      {
+        var::String output;
+        var::String expected_output;
+        {
+          ChartJsWriter writer(&output, append_string);
+          plain.write(writer);
+          ChartJsWriter expected_writer(&expected_output, append_string);
+          expected.write(expected_writer);
+        }
+        const size_t data = output.string_view().find("\"data\"");
+        TEST_ASSERT(
+          output.string_view().get_substring_at_position(data)
+          == expected_output.string_view().get_substring_at_position(
+            expected_output.string_view().find("\"data\"")));
+      }
+
+      // the decimation selects source points, y is the derived value
+      const json::JsonArray selected
+        = decimated.to_object().at("data").to_array();
+      TEST_ASSERT(selected.count() <= 100 && selected.count() > 2);
+      for (size_t i = 0; i < selected.count(); i++) {
+        const json::JsonObject point = selected.at(i).to_object();
+        const size_t offset = size_t(point.at("x").to_real() * 4.0f + 0.5f);
+        TEST_ASSERT(
+          point.at("y").to_real() == float(expected.y_column().at(offset)));
+      }
+
+      expected.set_data_encoding(ChartJsDataSet::DataEncoding::base64);
+      TEST_ASSERT(
+        stringify(encoded.to_object().at("encodedData"))
+        == stringify(expected.to_object().at("encodedData")));
+
+      // and a part at a time
+      var::String output;
+      {
+        ChartJsWriter writer(&output, append_string);
+        chart.write(writer);
+      }
+      char buffer[29];
+      ChartJsChunkWriter chunk_writer(chart);
+      var::String chunks;
+      while (const size_t length = chunk_writer.write(var::View(buffer, sizeof(buffer)))) {
+        chunks.append(var::StringView(buffer, length));
+      }
+      TEST_ASSERT(chunks == output);
+    }
+
+    return true;
+  }
+
+  bool point_source_api_case() {
+    struct Sample {
+      s64 time;
+      float value;
+    };
+    var::Vector<Sample> samples;
+    for (u32 i = 0; i < 150; i++) {
+      samples.push_back({s64(i) * 20, sinf(i * 0.1f)});
+    }
+    auto get_time = [](const Sample &sample) { return sample.time; };
+    auto get_value = [](const Sample &sample) { return sample.value; };
+
+    auto stringify = [](const json::JsonValue &value) {
+      return json::JsonDocument()
+        .set_flags(json::JsonDocument::Option::compact)
+        .stringify(value);
+    };
+    auto write = [](const ChartJs &chart) {
+      var::String result;
+      ChartJsWriter writer(&result, append_string);
+      writer.set_real_format(
+        ChartJsRealFormat().set_style(ChartJsRealFormat::Style::exact));
+      chart.write(writer);
+      writer.flush();
+      return result;
+    };
+
+    ChartJs chart;
+    for (u32 i = 0; i < 4; i++) {
+      chart.data().emplace_dataset();
+    }
+    chart.data().dataset_list().at(0).set_point_source(
+      ChartJsPointSource::create_xy(samples, get_time, get_value));
+    chart.data().dataset_list().at(1).set_point_source(
+      ChartJsPointSource::create_y(samples, get_value));
+    {
+      // json values come first, source points follow the columns
+      ChartJsDataSet &mixed = chart.data().dataset_list().at(2);
+      mixed.data().push_back(json::JsonString("first"));
+      for (u32 i = 0; i < 100; i++) {
+        mixed.append_point(double(i), 0.5);
+      }
+      mixed.set_point_source(
+        ChartJsPointSource::create_xy(samples, get_time, get_value));
+    }
+
+    // a callback over an array, the offsets read never decrease
+    static float values[150];
+    for (u32 i = 0; i < 150; i++) {
+      values[i] = cosf(i * 0.1f);
+    }
+    struct Reader {
+      size_t offset;
+      size_t read_count;
+      bool is_ordered;
+    };
+    static Reader reader = {0, 0, true};
+    chart.data()
+      .dataset_list()
+      .at(3)
+      .set_data_encoding(ChartJsDataSet::DataEncoding::base64)
+      .set_point_source(ChartJsPointSource(
+        &reader,
+        [](void *context, size_t offset, ChartJsPointSource::Value *,
+           ChartJsPointSource::Value *y_list) {
+          Reader *r = reinterpret_cast<Reader *>(context);
+          r->is_ordered = r->is_ordered && offset >= r->offset;
+          r->offset = offset;
+          r->read_count++;
+          size_t result = 0;
+          while (result < ChartJsPointSource::block_size
+                 && offset + result < 150) {
+            y_list[result].real = double(values[offset + result]);
+            result++;
+          }
+          return result;
+        },
+        false));
+
+    {
+      // the same as the samples copied into the columns
+      ChartJsDataSet xy;
+      ChartJsDataSet y;
+      for (const auto &sample : samples) {
+        xy.x_column().append(sample.time);
+        xy.y_column().append(sample.value);
+        y.append_point(sample.value);
+      }
+      const json::JsonObject object = chart.data().to_object();
+      const json::JsonArray datasets = object.at("datasets").to_array();
+      TEST_ASSERT(
+        stringify(datasets.at(0).to_object().at("data"))
+        == stringify(xy.to_object().at("data")));
+      TEST_ASSERT(
+        stringify(datasets.at(1).to_object().at("data"))
+        == stringify(y.to_object().at("data")));
+
+      const json::JsonArray mixed = datasets.at(2).to_object().at("data").to_array();
+      TEST_ASSERT(mixed.count() == 1 + 100 + 150);
+      TEST_ASSERT(mixed.at(1).to_object().at("y").to_real() == 0.5f);
+      TEST_ASSERT(
+        mixed.at(101).to_object().at("y").to_real() == samples.at(0).value);
+
+      // points from a source are json whatever the encoding
+      const json::JsonObject encoded = datasets.at(3).to_object();
+      TEST_ASSERT(encoded.at("data").to_array().count() == 150);
+      TEST_ASSERT(encoded.at("data").to_array().at(149).to_real() == values[149]);
+    }
+
+    // the writer reads each block once
+    reader = {0, 0, true};
+    const var::String output = write(chart);
+    // 3 blocks and the empty read
+    TEST_ASSERT(reader.read_count == 4 && reader.is_ordered);
+    reader = {0, 0, true};
+    TEST_ASSERT(output == stringify(chart.to_object()));
+
+    // a part at a time, each buffer reads again from its first point
+    for (const size_t size : {1, 7, 100000}) {
+      reader = {0, 0, true};
+      var::Vector<char> buffer(size);
+      ChartJsChunkWriter chunk_writer(chart);
+      chunk_writer.set_real_format(
+        ChartJsRealFormat().set_style(ChartJsRealFormat::Style::exact));
+      var::String chunks;
+      while (const size_t length = chunk_writer.write(
+               var::View(buffer.data(), buffer.count()))) {
+        chunks.append(var::StringView(buffer.data(), length));
+      }
+      TEST_ASSERT(chunks == output);
+      TEST_ASSERT(reader.is_ordered);
+    }
+
+    // the storage is read when serialized, not when the source is set
+    samples.at(0).value = 100.0f;
+    TEST_ASSERT(chart.data()
+                  .dataset_list()
+                  .at(1)
+                  .to_object()
+                  .at("data")
+                  .to_array()
+                  .at(0)
+                  .to_real()
+                == 100.0f);
+
+    // sent whole by to_delta() although nothing was appended
+    const u32 generation = chart.to_delta(0).at("generation").to_integer();
+    const json::JsonArray delta
+      = chart.to_delta(generation).at("datasets").to_array();
+    TEST_ASSERT(delta.count() == 4);
+    TEST_ASSERT(delta.at(0).to_object().at("dataset").is_object());
+
+    // not shared by a dashboard
+    ChartJsDashboard dashboard;
+    dashboard.append(chart).append(chart);
+    TEST_ASSERT(dashboard.data_count() == 0);
+
+    {
+      // integers are not rounded through double
+      var::Vector<s64> integers;
+      integers.push_back(s64(1) << 62).push_back((s64(1) << 53) + 1);
+      ChartJsDataSet dataset;
+      dataset.set_point_source(ChartJsPointSource::create_y(integers));
+      TEST_ASSERT(
+        dataset.point_source().y_type() == ChartJsDataColumn::Type::integer64);
+      var::String output;
+      {
+        ChartJsWriter writer(&output, append_string);
+        dataset.write(writer);
+      }
+      TEST_ASSERT(
+        output.string_view().find("[4611686018427387904,9007199254740993]")
+        != var::StringView::npos);
+    }
+
+    {
+      // a y source reads each value once
+      static size_t get_count = 0;
+      get_count = 0;
+      ChartJsDataSet dataset;
+      dataset.set_point_source(ChartJsPointSource::create_y(
+        samples, [](const Sample &sample) {
+          get_count++;
+          return sample.value;
+        }));
+      dataset.to_object();
+      TEST_ASSERT(get_count == samples.count());
+    }
+
+    {
+      // copies of a dataset share the range but not the cursor
+      ChartJs copies;
+      ChartJsDataSet dataset;
+      dataset.set_point_source(
+        ChartJsPointSource::create_xy(samples, get_time, get_value));
+      for (u32 i = 0; i < 8; i++) {
+        copies.data().dataset_list().push_back(dataset);
+      }
+      const var::String serial = write(copies);
+      var::String parallel;
+      {
+        ChartJsWriter writer(&parallel, append_string);
+        writer
+          .set_real_format(
+            ChartJsRealFormat().set_style(ChartJsRealFormat::Style::exact))
+          .set_thread_count(4);
+        copies.write(writer);
+      }
+      TEST_ASSERT(parallel == serial);
+
+      // and two writers in turn
+      char buffer[16];
+      ChartJsChunkWriter a(copies);
+      ChartJsChunkWriter b(copies);
+      var::String a_output;
+      var::String b_output;
+      while (!a.is_complete() || !b.is_complete()) {
+        a_output.append(var::StringView(
+          buffer, a.write(var::View(buffer, sizeof(buffer)))));
+        b_output.append(var::StringView(
+          buffer, b.write(var::View(buffer, sizeof(buffer)))));
+      }
+      TEST_ASSERT(a_output == b_output);
+    }
+
+    return true;
+  }
+
+  bool rdp_api_case() {
+    auto get_selection = [](const ChartJsDataSet &dataset) {
+      var::Vector<size_t> result;
+      dataset.decimation().select(
+        dataset.x_column(), dataset.y_column(), dataset.point_count(), &result,
+        [](void *context, size_t offset) {
+          reinterpret_cast<var::Vector<size_t> *>(context)->push_back(offset);
+        });
+      return result;
+    };
+
+    {
+      // collinear points reduce to the ends
+      ChartJsDataSet dataset;
+      for (u32 i = 0; i < 1000; i++) {
+        dataset.append_point(float(i), 2.0f * i + 1.0f);
+      }
+      dataset.set_decimation(ChartJsDecimation()
+                               .set_algorithm(ChartJsDecimation::Algorithm::rdp)
+                               .set_epsilon(0.001));
+      const var::Vector<size_t> selection = get_selection(dataset);
+      TEST_ASSERT(selection.count() == 2);
+      TEST_ASSERT(selection.at(0) == 0 && selection.at(1) == 999);
+    }
+
+    {
+      // the runs between gaps are simplified on their own, the gaps kept
+      ChartJsDataSet dataset;
+      for (u32 i = 0; i < 1000; i++) {
+        const bool is_gap = i == 300 || i == 301 || i == 700;
+        dataset.append_point(float(i), is_gap ? NAN : 2.0f * i + 1.0f);
+      }
+      dataset.append_point(1000.0f, 1.0f);
+      dataset.set_decimation(ChartJsDecimation()
+                               .set_algorithm(ChartJsDecimation::Algorithm::rdp)
+                               .set_epsilon(0.001));
+      const var::Vector<size_t> selection = get_selection(dataset);
+      const size_t expected[]
+        = {0, 299, 300, 301, 302, 699, 700, 701, 999, 1000};
+      TEST_ASSERT(selection.count() == sizeof(expected) / sizeof(size_t));
+      for (size_t i = 0; i < selection.count(); i++) {
+        TEST_ASSERT(selection.at(i) == expected[i]);
+      }
+    }
+
+    // a spiral (x is not monotonic), every point is within epsilon of the
+    // simplified line
+    for (const double x_scale : {1.0, 100.0}) {
+      ChartJsDataSet dataset;
+      for (u32 i = 0; i < 10000; i++) {
+        const double angle = i * 0.01;
+        dataset.append_point(
+          angle * cos(angle) / x_scale, angle * sin(angle));
+      }
+      // in pixels when the x axis has 100 pixels per unit
+      dataset.set_decimation(ChartJsDecimation()
+                               .set_algorithm(ChartJsDecimation::Algorithm::rdp)
+                               .set_epsilon(0.05)
+                               .set_x_scale(x_scale));
+      const var::Vector<size_t> selection = get_selection(dataset);
+      TEST_ASSERT(selection.count() > 10 && selection.count() < 2000);
+      TEST_ASSERT(selection.at(0) == 0 && selection.back() == 9999);
+      for (size_t k = 0; k + 1 < selection.count(); k++) {
+        const size_t a = selection.at(k);
+        const size_t b = selection.at(k + 1);
+        TEST_ASSERT(a < b);
+        const double ax = dataset.x_column().at(a) * x_scale;
+        const double ay = dataset.y_column().at(a);
+        const double dx = dataset.x_column().at(b) * x_scale - ax;
+        const double dy = dataset.y_column().at(b) - ay;
+        for (size_t i = a + 1; i < b; i++) {
+          const double px = dataset.x_column().at(i) * x_scale - ax;
+          const double py = dataset.y_column().at(i) - ay;
+          double t = (px * dx + py * dy) / (dx * dx + dy * dy);
+          t = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+          TEST_ASSERT(hypot(px - t * dx, py - t * dy) <= 0.05);
+        }
+      }
+
+      // serialized points are the selection
+      TEST_ASSERT(
+        dataset.to_object().at("data").to_array().count()
+        == selection.count());
+    }
+
+    return true;
+  }
+
+  bool level_of_detail_api_case() {
+    ChartJsLevelOfDetail level_of_detail;
+    for (u32 i = 0; i < 100000; i++) {
+      level_of_detail.append(i, i == 5000 ? 100.0 : sin(i * 0.001));
+    }
+
+    const ChartJsDataSet dataset = level_of_detail.create_dataset(
+      ChartJsLevelOfDetail::Query()
+        .set_minimum(1000)
+        .set_maximum(9000)
+        .set_resolution(100)
+        .set_aggregate(ChartJsLevelOfDetail::Aggregate::min_max));
+
+    TEST_ASSERT(dataset.point_count() >= 100);
+    TEST_ASSERT(dataset.point_count() <= 2 * 2 * (100 + 1));
+
+    double maximum = 0.0;
+    for (size_t i = 0; i < dataset.point_count(); i++) {
+      TEST_ASSERT(dataset.x_column().at(i) >= 512);
+      TEST_ASSERT(dataset.x_column().at(i) < 9216);
+      const double y = dataset.y_column().at(i);
+      maximum = y > maximum ? y : maximum;
+    }
+    TEST_ASSERT(maximum == 100.0);
+
+    return true;
+  }
+
+  bool rolling_api_case() {
+    ChartJsData data;
+    data.set_label_capacity(4).append(ChartJsDataSet::create_rolling(4));
+
+    for (u32 i = 0; i < 7; i++) {
+      data.append_label(var::NumberString(i, "%d").string_view());
+      data.dataset_list().at(0).append_point(float(i));
+    }
+
+    const ChartJsDataSet &dataset = data.dataset_list().at(0);
+    TEST_ASSERT(dataset.point_count() == 4);
+    TEST_ASSERT(data.label_list().count() == 4);
+    for (u32 i = 0; i < 4; i++) {
+      TEST_ASSERT(dataset.y_column().at(i) == i + 3);
+      TEST_ASSERT(
+        data.label_at(i) == var::NumberString(i + 3, "%d").string_view());
+    }
+
+    // a direct edit sees the labels in order and rolling continues after it
+    data.label_list().at(0) = var::String("first");
+    TEST_ASSERT(data.label_at(0) == "first");
+    data.append_label("7");
+    TEST_ASSERT(data.label_at(0) == "4");
+    TEST_ASSERT(data.label_at(3) == "7");
+    data.set_label_capacity(5).append_label("8").append_label("9");
+    TEST_ASSERT(data.label_count() == 5);
+    TEST_ASSERT(data.label_at(0) == "5");
+    TEST_ASSERT(data.label_at(4) == "9");
+
+    return true;
+  }
+
+  bool delta_api_case() {
+    ChartJs chart;
+    chart.data().append(ChartJsDataSet().set_label("first"));
+
+    TEST_ASSERT(chart.to_delta(0).at("reset").is_valid());
+    const u32 generation = chart.generation();
+    TEST_ASSERT(!chart.to_delta(generation).at("datasets").is_valid());
+
+    chart.data().dataset_list().at(0).append_point(1.0f).append_point(2.0f);
+    const json::JsonObject delta = chart.to_delta(generation);
+    TEST_ASSERT(chart.generation() == generation + 1);
+    TEST_ASSERT(!delta.at("options").is_valid());
+
+    const json::JsonObject dataset
+      = delta.at("datasets").to_array().at(0).to_object();
+    TEST_ASSERT(dataset.at("remove").to_integer() == 0);
+    TEST_ASSERT(dataset.at("append").to_array().count() == 2);
+    TEST_ASSERT(!dataset.at("properties").is_valid());
+
+    chart.data().dataset_list().at(0).set_label("second");
+    TEST_ASSERT(chart.to_delta(generation + 1)
+                  .at("datasets")
+                  .to_array()
+                  .at(0)
+                  .to_object()
+                  .at("properties")
+                  .is_valid());
+
+    // edits that keep the counts are sent whole
+    chart.data().append_label("a");
+    u32 since = chart.generation();
+    chart.to_delta(since);
+    since = chart.generation();
+    chart.data().label_list().at(0) = var::String("b");
+    const json::JsonObject label_delta = chart.to_delta(since);
+    TEST_ASSERT(label_delta.at("labels").is_array());
+    TEST_ASSERT(var::StringView(
+                  label_delta.at("labels").to_array().at(0).to_cstring())
+                == "b");
+
+    since = chart.generation();
+    {
+      ChartJsDataColumn &y_column = chart.data().dataset_list().at(0).y_column();
+      y_column.clear();
+      y_column.append(5.0f);
+      y_column.append(6.0f);
+    }
+    const json::JsonObject point_delta = chart.to_delta(since);
+    TEST_ASSERT(!point_delta.at("labels").is_valid());
+    TEST_ASSERT(point_delta.at("datasets")
+                  .to_array()
+                  .at(0)
+                  .to_object()
+                  .at("dataset")
+                  .is_valid());
+
+    since = chart.generation();
+    chart.data().dataset_list().at(0).append_point(3.0f);
+    TEST_ASSERT(chart.to_delta(since)
+                  .at("datasets")
+                  .to_array()
+                  .at(0)
+                  .to_object()
+                  .at("append")
+                  .is_valid());
+
+    // a dataset assigned over another one is sent whole even though its
+    // sequence runs past the previous one
+    ChartJs replaced;
+    replaced.data().append(ChartJsDataSet());
+    for (u32 i = 0; i < 3; i++) {
+      replaced.data().dataset_list().at(0).append_point(float(i));
+    }
+    replaced.to_delta(0);
+    since = replaced.generation();
+    {
+      ChartJsDataSet other;
+      for (u32 i = 0; i < 5; i++) {
+        other.append_point(100.0f + i);
+      }
+      replaced.data().dataset_list().at(0) = other;
+    }
+    const json::JsonObject replace_delta
+      = replaced.to_delta(since).at("datasets").to_array().at(0).to_object();
+    TEST_ASSERT(!replace_delta.at("append").is_valid());
+    TEST_ASSERT(replace_delta.at("dataset")
+                  .to_object()
+                  .at("data")
+                  .to_array()
+                  .count()
+                == 5);
+    TEST_ASSERT(
+      !replaced.to_delta(replaced.generation()).at("datasets").is_valid());
+
+    return true;
+  }
+
+  bool properties_cache_api_case() {
+    ChartJsDataSet dataset;
+    dataset.set_label("first");
+    const u32 hash = dataset.calculate_properties_hash();
+    TEST_ASSERT(
+      var::StringView(dataset.to_object().at("label").to_cstring())
+      == "first");
+
+    dataset.set_label("second");
+    TEST_ASSERT(dataset.calculate_properties_hash() != hash);
+    TEST_ASSERT(
+      var::StringView(dataset.to_object().at("label").to_cstring())
+      == "second");
+
+    dataset.border_dash_list().push_back(2);
+    TEST_ASSERT(dataset.to_object().at("borderDash").is_valid());
+
+    // data does not invalidate the properties
+    const u32 styled_hash = dataset.calculate_properties_hash();
+    dataset.append_point(1.0f);
+    TEST_ASSERT(dataset.calculate_properties_hash() == styled_hash);
+
+    return true;
+  }
+
+  bool color_api_case() {
+    for (u32 alpha = 0; alpha < 256; alpha++) {
+      const ChartJsColor color = ChartJsColor()
+                                   .set_red(u8(alpha))
+                                   .set_green(7)
+                                   .set_blue(u8(255 - alpha))
+                                   .set_alpha(u8(alpha));
+      TEST_ASSERT(
+        color.to_string().string_view()
+        == var::GeneralString()
+             .format(
+               "rgba(%d,%d,%d,%0.2f)", alpha, 7, 255 - alpha,
+               alpha * 1.0f / 255)
+             .string_view());
+    }
+
+    const ChartJsColor literal("2F6192");
+    TEST_ASSERT(literal.is_valid());
+    TEST_ASSERT(
+      literal.to_string().string_view() == "rgba(47,97,146,1.00)");
+    TEST_ASSERT(
+      ChartJsColor(var::StringView("2f6192")).to_string().string_view()
+      == "rgba(47,97,146,1.00)");
+    TEST_ASSERT(ChartJsColor(var::StringView("2f619g")).is_valid() == false);
+    TEST_ASSERT(ChartJsColor("2f61").is_valid() == false);
+    char buffer[16] = "2f6192";
+    TEST_ASSERT(ChartJsColor(buffer).to_string().string_view()
+                == "rgba(47,97,146,1.00)");
+
+    const auto palette = ChartJsColor::create_standard_palette();
+    TEST_ASSERT(palette.count() == ChartJsColor::standard_palette_count);
+    for (u32 i = 0; i < 2 * palette.count(); i++) {
+      const ChartJsColor color = ChartJsColor::get_standard(i);
+      TEST_ASSERT(
+        color.to_string().string_view()
+        == palette.at(i % palette.count()).to_string().string_view());
+    }
+
+    return true;
+  }
+
+  bool real_format_api_case() {
+    using Style = ChartJsRealFormat::Style;
+    const ChartJsRealFormat shortest;
+    const ChartJsRealFormat exact = ChartJsRealFormat().set_style(Style::exact);
+    const ChartJsRealFormat fixed
+      = ChartJsRealFormat().set_style(Style::fixed).set_precision(2);
+    const ChartJsRealFormat significant
+      = ChartJsRealFormat().set_style(Style::significant).set_precision(3);
+
+    TEST_ASSERT(write_real(shortest, 0.1f).string_view() == "0.1");
+    TEST_ASSERT(write_real(shortest, 0.1).string_view() == "0.1");
+    TEST_ASSERT(write_real(shortest, 2.0f).string_view() == "2.0");
+    TEST_ASSERT(write_real(shortest, 1e-7f).string_view() == "1e-7");
+    TEST_ASSERT(
+      write_real(exact, 0.1f).string_view() == "0.10000000149011612");
+    TEST_ASSERT(write_real(fixed, 3.14159).string_view() == "3.14");
+    TEST_ASSERT(write_real(fixed, 2.0).string_view() == "2.0");
+    TEST_ASSERT(write_real(significant, 1234.5).string_view() == "1.23e3");
+
+    // the shortest output reads back as the same value
+    for (u32 i = 0; i < 10000; i++) {
+      const float value = (i * 7919 % 10007) * 0.37f / (i + 1);
+      const var::String output = write_real(shortest, value);
+      TEST_ASSERT(strtof(output.cstring(), nullptr) == value);
+      TEST_ASSERT(
+        output.length() <= write_real(exact, value).length());
+    }
+
+    // a dataset format applies to its properties and points
+    ChartJsDataSet dataset;
+    dataset.append_point(1.26f).set_real_format(
+      ChartJsRealFormat().set_style(Style::fixed).set_precision(1));
+    var::String output;
+    {
+      ChartJsWriter writer(&output, append_string);
+      dataset.write(writer);
+    }
+    TEST_ASSERT(output.string_view().find("\"lineTension\":0.4,")
+                != var::StringView::npos);
+    TEST_ASSERT(output.string_view().find("\"data\":[1.3]")
+                != var::StringView::npos);
+
+    return true;
+  }
+
+  bool loader_api_case() {
+    TEST_ASSERT(ChartJsLoader::parse_real("1.5") == 1.5);
+    TEST_ASSERT(ChartJsLoader::parse_real(" -2e-3 ") == -2e-3);
+    TEST_ASSERT(ChartJsLoader::parse_real("0.1") == 0.1);
+    TEST_ASSERT(
+      ChartJsLoader::parse_real("1234567890.12345678901234567890")
+      == 1234567890.12345678901234567890);
+    TEST_ASSERT(std::isnan(ChartJsLoader::parse_real("1.5x")));
+    TEST_ASSERT(std::isnan(ChartJsLoader::parse_real("")));
+    TEST_ASSERT(std::isnan(ChartJsLoader::parse_real("1e")));
+    TEST_ASSERT(std::isnan(ChartJsLoader::parse_real("1e-")));
+    TEST_ASSERT(std::isnan(ChartJsLoader::parse_real("1e+")));
+
+    {
+      // reserved before the first append sets the column type
+      ChartJsDataSet dataset;
+      dataset.reserve_points(1000).append_point(1.0f);
+      TEST_ASSERT(dataset.y_column().real32().capacity() >= 1000);
+    }
+
+    {
+      const var::StringView csv
+        = "time,name,a,b\r\n"
+          "0,\"x, \"\"y\"\"\",1.5,2\r\n"
+          "1,z,,3\r\n"
+          "2,w,4e1,5";
+      ChartJsData data;
+      ChartJsLoader().set_x_column(0).set_label_column(1).load(
+        var::View(csv.data(), csv.length()), data);
+      TEST_ASSERT(data.dataset_list().count() == 2);
+      TEST_ASSERT(data.label_list().count() == 3);
+      TEST_ASSERT(data.label_at(0) == "x, \"y\"");
+
+      const ChartJsDataSet &a = data.dataset_list().at(0);
+      TEST_ASSERT(a.label() == "a");
+      TEST_ASSERT(a.point_count() == 3);
+      TEST_ASSERT(a.x_column().at(2) == 2.0);
+      TEST_ASSERT(a.y_column().at(0) == 1.5);
+      TEST_ASSERT(std::isnan(a.y_column().at(1)));
+      TEST_ASSERT(a.y_column().at(2) == 40.0);
+      TEST_ASSERT(data.dataset_list().at(1).y_column().at(1) == 3.0);
+
+      ChartJsData range;
+      ChartJsLoader()
+        .set_x_column(0)
+        .add_y_column(3)
+        .set_first_row(1)
+        .set_row_count(1)
+        .load(var::View(csv.data(), csv.length()), range);
+      TEST_ASSERT(range.dataset_list().count() == 1);
+      TEST_ASSERT(range.dataset_list().at(0).label() == "b");
+      TEST_ASSERT(range.dataset_list().at(0).point_count() == 1);
+      TEST_ASSERT(range.dataset_list().at(0).y_column().at(0) == 3.0);
+
+      // label columns need a label table, the loader can't provide one
+      ChartJsData labels;
+      ChartJsLoader()
+        .set_type(ChartJsDataColumn::Type::label)
+        .load(var::View(csv.data(), csv.length()), labels);
+      TEST_ASSERT(api::ExecutionContext::is_error());
+      TEST_ASSERT(labels.dataset_list().count() == 0);
+      api::ExecutionContext::reset_error();
+    }
+
+    {
+      // lines span the read buffer
+      fs::DataFile file;
+      for (u32 i = 0; i < 1000; i++) {
+        file.write(var::GeneralString().format("%d,%d.25\n", i, i * 3));
+      }
+      file.seek(0);
+      ChartJsData data;
+      ChartJsLoader().set_header(false).set_x_column(0).load(file, data);
+      TEST_ASSERT(data.dataset_list().count() == 1);
+      const ChartJsDataSet &dataset = data.dataset_list().at(0);
+      TEST_ASSERT(dataset.point_count() == 1000);
+      TEST_ASSERT(dataset.x_column().at(999) == 999.0);
+      TEST_ASSERT(dataset.y_column().at(999) == 999 * 3 + 0.25);
+    }
+
+    {
+      // real32 and s16 little-endian records
+      var::Vector<u8> records;
+      for (u32 i = 0; i < 100; i++) {
+        const float value = i * 0.5f;
+        u32 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        for (u32 j = 0; j < 4; j++) {
+          records.push_back(u8(bits >> (8 * j)));
+        }
+        const u16 count = u16(-s16(i));
+        records.push_back(u8(count));
+        records.push_back(u8(count >> 8));
+      }
+
+      ChartJsData data;
+      ChartJsLoader()
+        .set_format(ChartJsLoader::Format::binary)
+        .add_field(ChartJsLoader::Field::real32)
+        .add_field(ChartJsLoader::Field::s16)
+        .set_x_column(0)
+        .set_first_row(10)
+        .load(var::View(records.data(), records.count()), data);
+      const ChartJsDataSet &dataset = data.dataset_list().at(0);
+      TEST_ASSERT(dataset.point_count() == 90);
+      TEST_ASSERT(dataset.x_column().at(0) == 5.0);
+      TEST_ASSERT(dataset.y_column().at(89) == -99.0);
+    }
+
+    return true;
+  }
+
+  bool parallel_api_case() {
+    ChartJs chart;
+    for (u32 i = 0; i < 12; i++) {
+      ChartJsDataSet dataset;
+      dataset.set_label(var::NumberString(i, "%d").string_view());
+      for (u32 j = 0; j < 1000 * (i + 1); j++) {
+        dataset.append_point(j * 0.25f, sinf(j * 0.01f + i));
+      }
+      chart.data().append(dataset);
+    }
+    {
+      // copies share the json values, they are written on this thread
+      ChartJsDataSet values;
+      for (u32 j = 0; j < 100; j++) {
+        values.append(json::JsonReal(j * 0.5f));
+      }
+      chart.data().append(values).append(values);
+    }
+
+    var::String serial;
+    {
+      ChartJsWriter writer(&serial, append_string);
+      chart.write(writer);
+    }
+
+    for (u32 thread_count = 2; thread_count <= 16; thread_count *= 2) {
+      var::String parallel;
+      {
+        ChartJsWriter writer(&parallel, append_string);
+        writer.set_thread_count(thread_count);
+        chart.write(writer);
+      }
+      TEST_ASSERT(parallel.string_view() == serial.string_view());
+    }
+
+    return true;
+  }
+
+  bool aggregation_api_case() {
+    {
+      ChartJsQuantileSketch sketch;
+      TEST_ASSERT(std::isnan(sketch.quantile(0.5)));
+      for (u32 i = 1; i <= 10000; i++) {
+        sketch.append(double(i));
+      }
+      TEST_ASSERT(sketch.count() == 10000);
+      TEST_ASSERT(fabs(sketch.quantile(0.5) - 5000.0) <= 5000.0 * 0.01);
+      TEST_ASSERT(fabs(sketch.quantile(0.95) - 9500.0) <= 9500.0 * 0.01);
+      TEST_ASSERT(sketch.quantile(1.0) == 10000.0);
+      TEST_ASSERT(!sketch.is_collapsed());
+
+      // 1e-30 to 1e30 spans more than maximum_bin_count bins at 1%
+      ChartJsQuantileSketch wide;
+      wide.append(1e-30).append(1e30);
+      TEST_ASSERT(wide.is_collapsed());
+      TEST_ASSERT(ChartJsQuantileSketch().merge(wide).is_collapsed());
+
+      // negative values and zero sort below the positive values
+      ChartJsQuantileSketch other;
+      for (s32 i = -99; i <= 0; i++) {
+        other.append(double(i));
+      }
+      sketch.merge(other);
+      TEST_ASSERT(sketch.quantile(0.0) == -99.0);
+      TEST_ASSERT(fabs(sketch.quantile(0.005) + 50.0) <= 50.0 * 0.01 + 1.0);
+    }
+
+    {
+      ChartJsHistogram histogram(0.0, 10.0, 5);
+      const double values[] = {-1.0, 0.0, 1.9, 2.0, 9.99, 10.0, NAN};
+      histogram.append(values, sizeof(values) / sizeof(values[0]));
+      TEST_ASSERT(histogram.underflow() == 1);
+      TEST_ASSERT(histogram.overflow() == 1);
+      TEST_ASSERT(histogram.bin_list().at(0) == 2);
+      TEST_ASSERT(histogram.bin_list().at(1) == 1);
+      TEST_ASSERT(histogram.bin_list().at(4) == 1);
+
+      const ChartJsData data = histogram.create_data();
+      TEST_ASSERT(data.label_list().count() == 5);
+      TEST_ASSERT(data.label_at(1) == "2-4");
+      TEST_ASSERT(data.dataset_list().at(0).y_column().integer_at(0) == 2);
+    }
+
+    {
+      // two samples a second starting 30s past the minute
+      ChartJsTimeAggregation aggregation;
+      aggregation.set_width(ChartJsTimeAggregation::minute)
+        .add_statistic(ChartJsTimeAggregation::Statistic::mean)
+        .add_statistic(ChartJsTimeAggregation::Statistic::maximum)
+        .add_statistic(ChartJsTimeAggregation::Statistic::count)
+        .add_quantile(0.95);
+      const s64 start = 1599999960000 + 30 * ChartJsTimeAggregation::second;
+      for (s64 i = 0; i < 300; i++) {
+        aggregation.append(start + i * 500, double(i));
+      }
+      TEST_ASSERT(aggregation.bucket_count() == 2);
+
+      const ChartJsData data = aggregation.create_data();
+      TEST_ASSERT(aggregation.bucket_count() == 3);
+      TEST_ASSERT(data.dataset_list().count() == 4);
+      const ChartJsDataSet &mean = data.dataset_list().at(0);
+      TEST_ASSERT(mean.label() == "mean");
+      TEST_ASSERT(mean.point_count() == 3);
+      TEST_ASSERT(mean.x_column().is_integer());
+      TEST_ASSERT(mean.x_column().integer_at(0) == 1599999960000);
+      TEST_ASSERT(mean.x_column().integer_at(1) == 1600000020000);
+      TEST_ASSERT(mean.y_column().at(0) == 29.5);
+      TEST_ASSERT(data.dataset_list().at(1).y_column().at(1) == 179.0);
+      TEST_ASSERT(data.dataset_list().at(2).y_column().at(2) == 120.0);
+      TEST_ASSERT(data.dataset_list().at(3).label() == "p95");
+      TEST_ASSERT(
+        fabs(data.dataset_list().at(3).y_column().at(1) - 173.0) <= 2.0);
+      TEST_ASSERT(
+        var::StringView(ChartJsTimeAggregation::get_unit(
+          ChartJsTimeAggregation::minute))
+        == "minute");
+    }
+
+    return true;
+  }
+
+  bool timestamp_api_case() {
+    constexpr s64 start = 1600000000000;
+    {
+      ChartJsDataColumn column;
+      column.set_type(ChartJsDataColumn::Type::timestamp);
+      for (s64 i = 0; i < 1000; i++) {
+        column.append(start + i * 1000);
+      }
+      TEST_ASSERT(column.count() == 1000);
+      TEST_ASSERT(column.is_regular());
+      TEST_ASSERT(column.timestamp_size() == 0);
+      TEST_ASSERT(column.timestamp_at(999) == start + 999000);
+      TEST_ASSERT(column.at(1) == double(start + 1000));
+    }
+
+    // jittered samples with a gap
+    var::Vector<s64> expected;
+    ChartJsDataSet dataset;
+    dataset.set_data_encoding(ChartJsDataSet::DataEncoding::base64)
+      .x_column()
+      .set_type(ChartJsDataColumn::Type::timestamp);
+    for (s64 i = 0; i < 10000; i++) {
+      const s64 value
+        = start + i * 1000 + (i % 7) - 3 + (i >= 5000 ? 3600000 : 0);
+      expected.push_back(value);
+      dataset.append_point(value, s64(i));
+    }
+    const ChartJsDataColumn &column = dataset.x_column();
+    TEST_ASSERT(!column.is_regular());
+    TEST_ASSERT(column.timestamp_size() < expected.count() * 2);
+    for (size_t i = 0; i < expected.count(); i++) {
+      TEST_ASSERT(column.timestamp_at(i) == expected.at(i));
+    }
+    // out of order
+    for (size_t i = 0; i < expected.count(); i++) {
+      const size_t offset = (i * 7919) % expected.count();
+      TEST_ASSERT(column.timestamp_at(offset) == expected.at(offset));
+    }
+
+    {
+      var::String output;
+      {
+        ChartJsWriter writer(&output, append_string);
+        dataset.write(writer);
+      }
+      const var::StringView prefix = "\"x\":{\"type\":\"Int32Delta\",\"start\":";
+      const size_t position = output.string_view().find(prefix);
+      TEST_ASSERT(position != var::StringView::npos);
+      const size_t base64_position
+        = output.string_view().find("\"base64\":\"", position) + 10;
+      const var::Vector<u8> bytes = decode_base64(
+        output.string_view().get_substring_at_position(base64_position));
+      TEST_ASSERT(bytes.count() == expected.count() * sizeof(s32));
+      TEST_ASSERT(
+        output.string_view()
+          .get_substring_at_position(position + prefix.length())
+          .find("1599999999997,")
+        == 0);
+      s64 value = expected.at(0);
+      for (size_t i = 0; i < expected.count(); i++) {
+        u32 bits = 0;
+        for (u32 j = 0; j < 4; j++) {
+          bits |= u32(bytes.at(i * 4 + j)) << (8 * j);
+        }
+        value += s32(bits);
+        TEST_ASSERT(value == expected.at(i));
+      }
+    }
+
+    {
+      // regular x is written as start and step
+      ChartJsDataSet regular;
+      regular.set_data_encoding(ChartJsDataSet::DataEncoding::base64)
+        .x_column()
+        .set_type(ChartJsDataColumn::Type::timestamp);
+      for (s64 i = 0; i < 100; i++) {
+        regular.append_point(start + i * 1000, s64(i));
+      }
+      var::String output;
+      {
+        ChartJsWriter writer(&output, append_string);
+        regular.write(writer);
+      }
+      TEST_ASSERT(
+        output.string_view().find(
+          "\"x\":{\"type\":\"Timestamp\",\"start\":1600000000000,"
+          "\"step\":1000}")
+        != var::StringView::npos);
+      // to_object() keeps the epoch-ms start of both encodings
+      TEST_ASSERT(
+        stringify(regular).string_view().find(
+          "\"x\":{\"type\":\"Timestamp\",\"start\":1600000000000,"
+          "\"step\":1000}")
+        != var::StringView::npos);
+      TEST_ASSERT(
+        stringify(dataset).string_view().find(
+          "\"x\":{\"type\":\"Int32Delta\",\"start\":1599999999997,")
+        != var::StringView::npos);
+
+      output = var::String();
+      {
+        ChartJsWriter writer(&output, append_string);
+        regular.set_data_encoding(ChartJsDataSet::DataEncoding::json)
+          .write(writer);
+      }
+      TEST_ASSERT(
+        output.string_view().find("{\"x\":1600000000000,\"y\":0},")
+        != var::StringView::npos);
+    }
+
+    {
+      const var::StringView csv = "time,value\n"
+                                  "1600000000000,1.5\n"
+                                  "1600000001000,2.5\n";
+      ChartJsData data;
+      ChartJsLoader()
+        .set_x_column(0)
+        .set_type(ChartJsDataColumn::Type::timestamp)
+        .load(var::View(csv.data(), csv.length()), data);
+      const ChartJsDataSet &loaded = data.dataset_list().at(0);
+      TEST_ASSERT(loaded.x_column().is_regular());
+      TEST_ASSERT(loaded.x_column().step() == 1000);
+      TEST_ASSERT(loaded.y_column().at(1) == 2.5);
+    }
+
+    return true;
+  }
+
+  bool arena_api_case() {
+    {
+      ChartJsArena arena(64);
+      void *first = arena.allocate(1);
+      void *second = arena.allocate(40);
+      TEST_ASSERT(reinterpret_cast<size_t>(first) % ChartJsArena::alignment
+                  == 0);
+      TEST_ASSERT(static_cast<u8 *>(second) - static_cast<u8 *>(first)
+                  == ChartJsArena::alignment);
+      TEST_ASSERT(arena.contains(second));
+      TEST_ASSERT(!arena.contains(&arena));
+      // a second block twice the size
+      arena.allocate(64);
+      TEST_ASSERT(arena.block_count() == 2);
+      TEST_ASSERT(arena.capacity() == 64 + 128);
+      arena.reset();
+      TEST_ASSERT(arena.block_count() == 1);
+      TEST_ASSERT(arena.used() == 0);
+      TEST_ASSERT(arena.allocate(16) == first);
+    }
+
+    {
+      u8 buffer[256];
+      ChartJsArena arena(var::View(buffer, sizeof(buffer)));
+      TEST_ASSERT(arena.allocate(200) != nullptr);
+      TEST_ASSERT(arena.allocate(200) == nullptr);
+    }
+
+    ChartJsDataSet dataset;
+    dataset.set_label("arena");
+    for (u32 i = 0; i < 1000; i++) {
+      dataset.append_point(i * 0.5f, sinf(i * 0.01f));
+    }
+    var::String expected;
+    {
+      ChartJsWriter writer(&expected, append_string);
+      writer.write_value(dataset.to_object());
+    }
+
+    {
+      ChartJsArena arena;
+      var::String output;
+      {
+        ChartJsArena::Scope scope(arena);
+        TEST_ASSERT(ChartJsArena::active() == &arena);
+        const json::JsonObject object = dataset.to_object();
+        ChartJsWriter writer(&output, append_string);
+        writer.write_value(object);
+      }
+      TEST_ASSERT(ChartJsArena::active() == nullptr);
+      TEST_ASSERT(arena.used() > 1000 * sizeof(json_t));
+      TEST_ASSERT(arena.overflow_count() == 0);
+      TEST_ASSERT(output.string_view() == expected.string_view());
+    }
+
+    {
+      // a full buffer arena continues on the heap
+      static u8 buffer[4096];
+      ChartJsArena arena(var::View(buffer, sizeof(buffer)));
+      var::String output;
+      {
+        ChartJsArena::Scope scope(arena);
+        ChartJsWriter writer(&output, append_string);
+        writer.write_value(dataset.to_object());
+      }
+      TEST_ASSERT(arena.overflow_count() > 0);
+      TEST_ASSERT(output.string_view() == expected.string_view());
+    }
+
+    {
+      // values stored in a chart that outlives the scope come from the heap
+      ChartJs chart;
+      chart.data().append(ChartJsDataSet()).append(
+        ChartJsDataSet().append_point(1.0f));
+      {
+        ChartJsArena arena;
+        ChartJsArena::Scope scope(arena);
+        chart.data().dataset_list().at(0).append(json::JsonReal(2.5f));
+        chart.options().set_property("responsive", json::JsonTrue());
+        const size_t used = arena.used();
+        {
+          ChartJsArena::HeapScope heap_scope;
+          json::JsonObject().insert("x", json::JsonInteger(1));
+        }
+        TEST_ASSERT(arena.used() == used);
+
+        // written without threads while the scope is active
+        var::String output;
+        ChartJsWriter writer(&output, append_string);
+        writer.set_thread_count(4);
+        chart.write(writer);
+      }
+      TEST_ASSERT(chart.data().dataset_list().at(0).data().count() == 1);
+      TEST_ASSERT(chart.options().object().at("responsive").is_valid());
+    }
+
+    return true;
+  }
+
+  bool move_api_case() {
+    {
+      // the dataset takes the vector storage
+      var::Vector<float> x_values;
+      var::Vector<float> y_values;
+      for (u32 i = 0; i < 100; i++) {
+        x_values.push_back(i * 0.5f);
+        y_values.push_back(i * 2.0f);
+      }
+      const float *y_data = y_values.data();
+      ChartJs chart;
+      ChartJsDataSet &dataset = chart.data().emplace_dataset();
+      dataset.assign_points(std::move(x_values), std::move(y_values));
+      TEST_ASSERT(dataset.point_count() == 100);
+      TEST_ASSERT(dataset.y_column().real32().data() == y_data);
+      TEST_ASSERT(dataset.y_column().sequence() == 100);
+
+      // growing the dataset list moves the points
+      for (u32 i = 0; i < 32; i++) {
+        chart.data().emplace_dataset();
+      }
+      TEST_ASSERT(
+        chart.data().dataset_list().at(0).y_column().real32().data()
+        == y_data);
+
+      ChartJsDataSet moved;
+      moved.append_point(1.0f);
+      const float *moved_data = moved.y_column().real32().data();
+      chart.data().append(std::move(moved));
+      TEST_ASSERT(
+        chart.data().dataset_list().back().y_column().real32().data()
+        == moved_data);
+    }
+
+#if defined __link
+    // allocations to build and write a chart do not depend on the number
+    // of points
+    TEST_ASSERT(
+      get_build_allocation_count(1000) == get_build_allocation_count(100000));
+#endif
+
+    return true;
+  }
+
+  bool options_template_api_case() {
+    ChartJsOptions base;
+    base.set_title(ChartJsTitle().set_text("title"))
+      .set_property("responsive", json::JsonTrue())
+      .set_property("aspectRatio", json::JsonReal(1.5f));
+    const ChartJsOptionsTemplate options_template(base);
+    TEST_ASSERT(options_template.is_valid());
+    TEST_ASSERT(options_template.count() == 3);
+
+    ChartJsOptions options;
+    options.set_template(options_template)
+      .set_property("aspectRatio", json::JsonReal(2.0f))
+      .set_property("animation", json::JsonFalse());
+
+    // overrides replace template members
+    const json::JsonObject object = options.to_object();
+    TEST_ASSERT(object.get_key_list().count() == 4);
+    TEST_ASSERT(object.at("aspectRatio").to_real() == 2.0f);
+    TEST_ASSERT(object.at("responsive").to_bool());
+    TEST_ASSERT(
+      var::StringView(
+        object.at("title").to_object().at("text").to_cstring())
+      == "title");
+
+    // the fragments and the tree are written the same
+    auto get_output = [&](ChartJsRealFormat::Style style) {
+      var::String result;
+      {
+        ChartJsWriter writer(&result, append_string);
+        writer.set_real_format(ChartJsRealFormat().set_style(style));
+        options.write(writer);
+      }
+      return result;
+    };
+    TEST_ASSERT(
+      get_output(ChartJsRealFormat::Style::shortest)
+      == json::JsonDocument()
+           .set_flags(json::JsonDocument::Option::compact)
+           .stringify(object));
+    TEST_ASSERT(
+      get_output(ChartJsRealFormat::Style::exact)
+      == json::JsonDocument()
+           .set_flags(json::JsonDocument::Option::compact)
+           .stringify(object));
+
+    // charts share the template, changing an override changes the hash
+    ChartJsOptions other;
+    other.set_template(options_template)
+      .set_property("aspectRatio", json::JsonReal(2.0f))
+      .set_property("animation", json::JsonFalse());
+    TEST_ASSERT(other.calculate_hash() == options.calculate_hash());
+    other.set_property("animation", json::JsonTrue());
+    TEST_ASSERT(other.calculate_hash() != options.calculate_hash());
+    TEST_ASSERT(
+      ChartJsOptions().set_template(ChartJsOptionsTemplate(base)).calculate_hash()
+      == ChartJsOptions().set_template(options_template).calculate_hash());
+
+    // editing the options of ChartJs::to_object() does not reach the template
+    ChartJs chart;
+    chart.options().set_template(options_template);
+    chart.to_object().at("options").to_object().at("title").to_object().insert(
+      "text", json::JsonString("edited"));
+    TEST_ASSERT(
+      var::StringView(chart.to_shared_object()
+                        .at("options")
+                        .to_object()
+                        .at("title")
+                        .to_object()
+                        .at("text")
+                        .to_cstring())
+      == "title");
+
+    return true;
+  }
+
+  bool dashboard_api_case() {
+    ChartJsDashboard dashboard;
+    for (u32 i = 0; i < 3; i++) {
+      ChartJs &chart = dashboard.emplace_chart();
+      chart.set_type(i == 2 ? ChartJs::Type::bar : ChartJs::Type::line);
+      chart.options().set_title(ChartJsTitle().set_text("title"));
+      for (u32 j = 0; j < 10; j++) {
+        chart.data().append_label(
+          var::NumberString(i == 2 ? j + 1 : j, "%d").string_view());
+      }
+      chart.data().emplace_dataset();
+      chart.data().emplace_dataset();
+      ChartJsDataSet &shared = chart.data().dataset_list().at(0);
+      ChartJsDataSet &own = chart.data().dataset_list().at(1);
+      shared.set_label("shared");
+      own.set_label("own").set_data_encoding(
+        ChartJsDataSet::DataEncoding::base64);
+      for (u32 j = 0; j < 10; j++) {
+        shared.append_point(j * 0.5f, sinf(j * 0.1f));
+        own.append_point(sinf(j * 0.1f + i));
+      }
+      // json values are written in place
+      chart.data().emplace_dataset().data().push_back(json::JsonReal(1.0f));
+    }
+    // the same values with another decimation are not shared
+    dashboard.chart_list().at(1).data().dataset_list().at(0).set_decimation(
+      ChartJsDecimation()
+        .set_algorithm(ChartJsDecimation::Algorithm::lttb)
+        .set_sample_count(5));
+
+    TEST_ASSERT(dashboard.label_list_count() == 2);
+    TEST_ASSERT(dashboard.data_count() == 5);
+
+    // the writer and to_object() agree
+    const json::JsonObject object = dashboard.to_object();
+    var::String output;
+    {
+      ChartJsWriter writer(&output, append_string);
+      writer.set_real_format(
+        ChartJsRealFormat().set_style(ChartJsRealFormat::Style::exact));
+      dashboard.write(writer);
+    }
+    TEST_ASSERT(
+      output
+      == json::JsonDocument()
+           .set_flags(json::JsonDocument::Option::compact)
+           .stringify(object));
+
+    // replacing the references gives each chart
+    const json::JsonArray label_array = object.at("labels").to_array();
+    const json::JsonArray data_array = object.at("data").to_array();
+    const json::JsonArray chart_array = object.at("charts").to_array();
+    TEST_ASSERT(chart_array.count() == 3);
+    for (u32 i = 0; i < chart_array.count(); i++) {
+      json::JsonObject data = chart_array.at(i).to_object().at("data").to_object();
+      data.insert(
+        "labels", label_array.at(data.at("labels").to_integer()));
+      const json::JsonArray dataset_array = data.at("datasets").to_array();
+      for (u32 j = 0; j < dataset_array.count(); j++) {
+        json::JsonObject dataset = dataset_array.at(j).to_object();
+        if (dataset.at("data").is_integer()) {
+          dataset.insert(
+            "data", data_array.at(dataset.at("data").to_integer()));
+        }
+        if (dataset.at("encodedData").is_integer()) {
+          dataset.insert(
+            "encodedData",
+            data_array.at(dataset.at("encodedData").to_integer()));
+        }
+      }
+      TEST_ASSERT(
+        json::JsonDocument()
+          .set_flags(json::JsonDocument::Option::compact)
+          .stringify(chart_array.at(i))
+        == json::JsonDocument()
+             .set_flags(json::JsonDocument::Option::compact)
+             .stringify(dashboard.chart_list().at(i).to_object()));
+    }
+
+    return true;
+  }
+
+  bool label_table_api_case() {
+    {
+      ChartJsLabelTable table;
+      TEST_ASSERT(table.find("a") == ChartJsLabelTable::invalid_id);
+      TEST_ASSERT(table.intern("b") == 0);
+      TEST_ASSERT(table.intern("a") == 1);
+      TEST_ASSERT(table.intern("b") == 0);
+      TEST_ASSERT(table.intern("") == 2);
+      TEST_ASSERT(table.intern("ab") == 3);
+      TEST_ASSERT(table.find("a") == 1);
+      TEST_ASSERT(table.at(3) == "ab");
+      TEST_ASSERT(table.count() == 4 && table.size() == 4);
+      // "" < "a" < "ab" < "b"
+      TEST_ASSERT(table.rank(2) == 0 && table.rank(1) == 1);
+      TEST_ASSERT(table.rank(3) == 2 && table.rank(0) == 3);
+
+      // the index grows with the labels
+      for (int i = 0; i < 1000; i++) {
+        table.intern(var::NumberString(i, "host-%d"));
+      }
+      TEST_ASSERT(table.count() == 1004);
+      for (int i = 0; i < 1000; i++) {
+        TEST_ASSERT(table.find(var::NumberString(i, "host-%d")) == u32(i + 4));
+      }
+    }
+
+    {
+      // interned labels are written the same, including rolling labels
+      ChartJsData plain;
+      ChartJsData interned;
+      plain.set_label_capacity(3);
+      interned.append_label("early");
+      interned.set_label_table(std::make_shared<ChartJsLabelTable>())
+        .set_label_capacity(3);
+      TEST_ASSERT(interned.label_count() == 1 && interned.label_at(0) == "early");
+      for (int i = 0; i < 5; i++) {
+        plain.append_label(i % 2 ? "odd" : "even");
+        interned.append_label(i % 2 ? "odd" : "even");
+      }
+      TEST_ASSERT(interned.label_count() == 3);
+      TEST_ASSERT(interned.label_table()->count() == 3);
+      TEST_ASSERT(interned.label_id_at(0) == interned.label_id_at(2));
+      const var::String expected = json::JsonDocument()
+                                     .set_flags(json::JsonDocument::Option::compact)
+                                     .stringify(plain.to_object());
+      TEST_ASSERT(
+        json::JsonDocument()
+          .set_flags(json::JsonDocument::Option::compact)
+          .stringify(interned.to_object())
+        == expected);
+      var::String output;
+      {
+        ChartJsWriter writer(&output, append_string);
+        interned.write(writer);
+      }
+      TEST_ASSERT(output == expected);
+
+      // without a table the labels are strings again
+      interned.set_label_table(nullptr);
+      TEST_ASSERT(interned.label_list().count() == 3);
+      TEST_ASSERT(interned.label_at(0) == plain.label_at(0));
+      interned.append_label("next");
+      TEST_ASSERT(interned.label_at(2) == "next");
+    }
+
+    {
+      // label points
+      auto table = std::make_shared<ChartJsLabelTable>();
+      ChartJsDataSet dataset;
+      dataset.x_column().set_label_table(table);
+      for (int i = 0; i < 1000; i++) {
+        dataset.append_point(i % 3 ? "api" : "web", double(i));
+      }
+      TEST_ASSERT(table->count() == 2);
+      TEST_ASSERT(dataset.x_column().type() == ChartJsDataColumn::Type::label);
+      TEST_ASSERT(dataset.x_column().label_at(1) == "api");
+      const json::JsonObject point
+        = dataset.to_object().at("data").to_array().at(0).to_object();
+      TEST_ASSERT(var::StringView(point.at("x").to_cstring()) == "web");
+
+      var::String output;
+      {
+        ChartJsWriter writer(&output, append_string);
+        writer.set_real_format(
+          ChartJsRealFormat().set_style(ChartJsRealFormat::Style::exact));
+        dataset.write(writer);
+      }
+      TEST_ASSERT(
+        output
+        == json::JsonDocument()
+             .set_flags(json::JsonDocument::Option::compact)
+             .stringify(dataset.to_object()));
+
+      ChartJsDataSet strings;
+      strings.append_point("a", "b").append_point("b", "a");
+      TEST_ASSERT(strings.y_column().label_at(1) == "a");
+
+      // numbers are only taken if they are ids of the table
+      ChartJsDataColumn &column = strings.y_column();
+      column.append(s64(1)).append(s64(2)).append(-1.0).append(0.0f);
+      TEST_ASSERT(column.count() == 4);
+      TEST_ASSERT(column.label_at(2) == "a" && column.label_at(3) == "b");
+
+      // a point with a value its column ignores is dropped from both
+      // columns
+      ChartJsDataSet labeled;
+      labeled.x_column().set_label_table(table);
+      labeled.append_point(s64(1), s64(10)).append_point(s64(7), s64(20));
+      const double x_values[] = {0.0, -1.0, 1.0};
+      const double y_values[] = {30.0, 40.0, 50.0};
+      labeled.append_points(x_values, y_values, 3);
+      TEST_ASSERT(labeled.x_column().count() == 3);
+      TEST_ASSERT(labeled.y_column().count() == 3);
+      TEST_ASSERT(labeled.y_column().at(1) == 30.0);
+      TEST_ASSERT(labeled.x_column().label_at(2) == "api");
+
+      ChartJsDataSet numeric;
+      numeric.append_point(1.0, 2.0).append_point("web", 3.0);
+      TEST_ASSERT(numeric.point_count() == 1);
+      TEST_ASSERT(numeric.x_column().count() == 1);
+
+      // encoded label columns are ids with the table
+      dataset.set_data_encoding(ChartJsDataSet::DataEncoding::base64);
+      const json::JsonObject x
+        = dataset.to_object().at("encodedData").to_object().at("x").to_object();
+      TEST_ASSERT(var::StringView(x.at("type").to_cstring()) == "Int32");
+      TEST_ASSERT(x.at("labels").to_array().count() == 2);
+      const var::Vector<u8> bytes = decode_base64(x.at("base64").to_cstring());
+      TEST_ASSERT(bytes.count() == 1000 * sizeof(s32));
+      TEST_ASSERT(bytes.at(0) == 0 && bytes.at(4) == 1);
+    }
+
+    return true;
+  }
+
+  bool chunk_writer_api_case() {
+    ChartJs chart;
+    chart.set_type(ChartJs::Type::bar)
+      .options()
+      .set_title(ChartJsTitle().set_text("title"));
+    chart.data().append_label("a").append_label("label\n\"quoted\"");
+    chart.data().emplace_dataset();
+    chart.data().emplace_dataset();
+    chart.data().emplace_dataset();
+    chart.data().emplace_dataset();
+    {
+      ChartJsDataSet &values = chart.data().dataset_list().at(0);
+      values.set_label("values").data().push_back(json::JsonReal(1.5f));
+      values.data().push_back(json::JsonString("text"));
+      for (u32 i = 0; i < 200; i++) {
+        values.append_point(i * 0.25f, sinf(i * 0.1f));
+      }
+    }
+    {
+      ChartJsDataSet &decimated = chart.data().dataset_list().at(1);
+      decimated.set_decimation(
+        ChartJsDecimation()
+          .set_algorithm(ChartJsDecimation::Algorithm::lttb)
+          .set_sample_count(50));
+      for (u32 i = 0; i < 1000; i++) {
+        decimated.append_point(double(i), cos(i * 0.01));
+      }
+    }
+    {
+      ChartJsDataSet &encoded = chart.data().dataset_list().at(2);
+      encoded.set_data_encoding(ChartJsDataSet::DataEncoding::base64);
+      for (u32 i = 0; i < 100; i++) {
+        encoded.append_point(float(i));
+      }
+    }
+    chart.data().dataset_list().at(3).append_point("web", 1.0);
+    {
+      // a timestamp step and Int32Delta
+      ChartJsDataSet &regular = chart.data().emplace_dataset();
+      regular.set_data_encoding(ChartJsDataSet::DataEncoding::base64)
+        .x_column()
+        .set_type(ChartJsDataColumn::Type::timestamp);
+      ChartJsDataSet &irregular = chart.data().emplace_dataset();
+      irregular.set_data_encoding(ChartJsDataSet::DataEncoding::base64)
+        .x_column()
+        .set_type(ChartJsDataColumn::Type::timestamp);
+      for (s64 i = 0; i < 100; i++) {
+        regular.append_point(1600000000000 + i * 1000, i);
+        irregular.append_point(1600000000000 + i * i, i * 3);
+      }
+      // derived values of the selected points
+      ChartJsDataSet &derived = chart.data().emplace_dataset();
+      derived.set_data_encoding(ChartJsDataSet::DataEncoding::base64)
+        .set_transform(ChartJsTransform::create_moving_average(4))
+        .set_decimation(ChartJsDecimation()
+                          .set_algorithm(ChartJsDecimation::Algorithm::lttb)
+                          .set_sample_count(40));
+      for (u32 i = 0; i < 500; i++) {
+        derived.append_point(double(i), sin(i * 0.02));
+      }
+    }
+
+    var::String expected;
+    {
+      ChartJsWriter writer(&expected, append_string);
+      chart.write(writer);
+    }
+
+    // the parts are the same as one write for any buffer size
+    for (const size_t size : {1, 3, 17, 64, 1000, 100000}) {
+      var::Vector<char> buffer(size);
+      ChartJsChunkWriter chunk_writer(chart);
+      var::String output;
+      size_t count = 0;
+      while (const size_t length = chunk_writer.write(
+               var::View(buffer.data(), buffer.count()))) {
+        TEST_ASSERT(length == size || chunk_writer.is_complete());
+        output.append(var::StringView(buffer.data(), length));
+        count++;
+      }
+      TEST_ASSERT(chunk_writer.is_complete());
+      TEST_ASSERT(chunk_writer.size() == expected.length());
+      TEST_ASSERT(count == (expected.length() + size - 1) / size);
+      TEST_ASSERT(output == expected);
+    }
+
+    {
+      // pre-serialized options
+      var::String options;
+      {
+        ChartJsWriter writer(&options, append_string);
+        chart.options().write(writer);
+      }
+      char buffer[7];
+      ChartJsChunkWriter chunk_writer(chart);
+      chunk_writer.set_options_fragment(options.string_view());
+      var::String output;
+      while (const size_t length
+             = chunk_writer.write(var::View(buffer, sizeof(buffer)))) {
+        output.append(var::StringView(buffer, length));
+      }
+      TEST_ASSERT(output == expected);
+    }
+
+#if defined __link
+    {
+      // points and labels are written without allocating
+      ChartJs points;
+      points.data().append_label("a");
+      ChartJsDataSet &dataset = points.data().emplace_dataset();
+      for (u32 i = 0; i < 2000; i++) {
+        dataset.append_point(float(i), sinf(i * 0.1f));
+      }
+      char buffer[64];
+      ChartJsChunkWriter chunk_writer(points);
+      const size_t start = Measurement::get_allocation_count();
+      while (chunk_writer.write(var::View(buffer, sizeof(buffer)))) {
+      }
+      TEST_ASSERT(Measurement::get_allocation_count() == start);
+
+      // and so is encoded data
+      dataset.set_data_encoding(ChartJsDataSet::DataEncoding::base64);
+      chunk_writer.restart();
+      const size_t encoded_start = Measurement::get_allocation_count();
+      while (chunk_writer.write(var::View(buffer, sizeof(buffer)))) {
+      }
+      TEST_ASSERT(Measurement::get_allocation_count() == encoded_start);
+    }
+#endif
+
+    return true;
+  }
+
+  bool encoding_api_case() {
+    ChartJsDataSet dataset;
+    dataset.set_data_encoding(ChartJsDataSet::DataEncoding::base64);
+    for (u32 i = 0; i < 100; i++) {
+      dataset.append_point(i * 0.5f, sinf(i * 0.1f));
+    }
+
+    // the writer and to_object() agree
+    var::String output;
+    {
+      ChartJsWriter writer(&output, append_string);
+      writer.set_real_format(
+        ChartJsRealFormat().set_style(ChartJsRealFormat::Style::exact));
+      dataset.write(writer);
+    }
+    TEST_ASSERT(
+      output.string_view()
+      == json::JsonDocument()
+           .set_flags(json::JsonDocument::Option::compact)
+           .stringify(dataset.to_object())
+           .string_view());
+
+    {
+      const json::JsonObject encoded
+        = dataset.to_object().at("encodedData").to_object();
+      TEST_ASSERT(encoded.at("count").to_integer() == 100);
+      const json::JsonObject y = encoded.at("y").to_object();
+      TEST_ASSERT(var::StringView(y.at("type").to_cstring()) == "Float32");
+      const var::Vector<u8> bytes = decode_base64(y.at("base64").to_cstring());
+      TEST_ASSERT(bytes.count() == 100 * sizeof(float));
+      for (u32 i = 0; i < 100; i++) {
+        TEST_ASSERT(get_float(bytes, i) == sinf(i * 0.1f));
+      }
+    }
+
+    {
+      // integers that fit are Int32, decimation applies to the arrays
+      ChartJsDataSet integer_dataset;
+      integer_dataset.set_data_encoding(ChartJsDataSet::DataEncoding::base64)
+        .set_decimation(ChartJsDecimation()
+                          .set_algorithm(ChartJsDecimation::Algorithm::min_max)
+                          .set_sample_count(10));
+      for (s64 i = 0; i < 1000; i++) {
+        integer_dataset.append_point(i - 500);
+      }
+      const json::JsonObject encoded
+        = integer_dataset.to_object().at("encodedData").to_object();
+      TEST_ASSERT(encoded.at("x").is_valid() == false);
+      TEST_ASSERT(
+        var::StringView(encoded.at("y").to_object().at("type").to_cstring())
+        == "Int32");
+      TEST_ASSERT(
+        decode_base64(encoded.at("y").to_object().at("base64").to_cstring())
+          .count()
+        == size_t(encoded.at("count").to_integer()) * sizeof(s32));
+    }
+
+    {
+      // sidecar arrays start 8-byte aligned
+      fs::DataFile sidecar;
+      ChartJsDataSet sidecar_dataset = dataset;
+      sidecar_dataset.set_data_encoding(ChartJsDataSet::DataEncoding::sidecar);
+      ChartJsData data;
+      data.append(sidecar_dataset).append(sidecar_dataset);
+
+      var::String result;
+      {
+        ChartJsWriter writer(&result, append_string);
+        writer.set_sidecar(&sidecar);
+        data.write(writer);
+        TEST_ASSERT(writer.sidecar_size() == 4 * 100 * sizeof(float));
+      }
+      TEST_ASSERT(
+        result.string_view().find("\"y\":{\"type\":\"Float32\",\"offset\":1200,"
+                                  "\"length\":400}")
+        != var::StringView::npos);
+
+      float value = 0.0f;
+      sidecar.seek(1200 + 99 * sizeof(float));
+      sidecar.read(var::View(&value, sizeof(value)));
+      TEST_ASSERT(value == sinf(99 * 0.1f));
+    }
 
-   
     return true;
   }
 
 private:
+  static var::Vector<u8> decode_base64(var::StringView value) {
+    static const char alphabet[]
+      = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    var::Vector<u8> result;
+    u32 bits = 0;
+    u32 bit_count = 0;
+    for (size_t i = 0; i < value.length(); i++) {
+      const char *position = strchr(alphabet, value.at(i));
+      if (value.at(i) == '=' || position == nullptr) {
+        break;
+      }
+      bits = (bits << 6) | u32(position - alphabet);
+      bit_count += 6;
+      if (bit_count >= 8) {
+        bit_count -= 8;
+        result.push_back(u8(bits >> bit_count));
+      }
+    }
+    return result;
+  }
+
+  // allocations to move point_count points into a chart and write it
+  static size_t get_build_allocation_count(size_t point_count) {
+    var::Vector<double> x_values;
+    var::Vector<double> y_values;
+    x_values.reserve(point_count);
+    y_values.reserve(point_count);
+    for (size_t i = 0; i < point_count; i++) {
+      x_values.push_back(i * 0.001);
+      y_values.push_back(sin(i * 0.001));
+    }
+
+    const size_t start = Measurement::get_allocation_count();
+    {
+      ChartJs chart;
+      chart.options().set_scales(
+        ChartJsScales().append_x_axis(ChartJsAxis().set_type(
+          ChartJsAxis::Type::linear)));
+      chart.data()
+        .emplace_dataset()
+        .set_label("points")
+        .assign_points(std::move(x_values), std::move(y_values));
+
+      class Counter {
+      public:
+        static void update(void *context, const char *, size_t size) {
+          *reinterpret_cast<size_t *>(context) += size;
+        }
+      };
+      size_t size = 0;
+      ChartJsWriter writer(&size, Counter::update);
+      chart.write(writer);
+    }
+    return Measurement::get_allocation_count() - start;
+  }
+
+  // little-endian float at offset
+  static float get_float(const var::Vector<u8> &bytes, size_t offset) {
+    u32 bits = 0;
+    for (u32 i = 0; i < 4; i++) {
+      bits |= u32(bytes.at(offset * 4 + i)) << (8 * i);
+    }
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+  }
+
+  // time, heap allocations and peak resident size since construction
+  class Measurement {
+  public:
+    Measurement() : m_allocation_count(get_allocation_count()) {
+      m_timer.start();
+    }
+
+    Measurement &stop() {
+      m_timer.stop();
+      m_allocation_count = get_allocation_count() - m_allocation_count;
+      return *this;
+    }
+
+    u32 microseconds() const { return m_timer.microseconds(); }
+    size_t allocation_count() const { return m_allocation_count; }
+
+    static size_t get_allocation_count() {
+#if defined __link
+      return ::allocation_count;
+#else
+      return 0;
+#endif
+    }
+
+    static size_t get_peak_resident_size() {
+#if defined __link && !defined __win32
+      struct rusage usage;
+      getrusage(RUSAGE_SELF, &usage);
+#if defined __macosx
+      return size_t(usage.ru_maxrss);
+#else
+      return size_t(usage.ru_maxrss) * 1024;
+#endif
+#else
+      return 0;
+#endif
+    }
+
+  private:
+    chrono::ClockTimer m_timer;
+    size_t m_allocation_count;
+  };
+
+  // one object per measurement so the results can be compared across
+  // commits
+  void print_measurement(var::StringView name, size_t point_count,
+                         const Measurement &measurement, size_t size) {
+    printer::Printer::Object po(
+      printer(),
+      var::GeneralString(name)
+        .append("-")
+        .append(format_size(point_count).string_view())
+        .string_view());
+    printer()
+      .key("points", format_size(point_count).string_view())
+      .key("nsPerPoint",
+           var::GeneralString()
+             .format("%0.1f", measurement.microseconds() * 1000.0 / point_count)
+             .string_view())
+      .key("bytesPerPoint",
+           var::GeneralString()
+             .format("%0.2f", size * 1.0 / point_count)
+             .string_view())
+      .key("allocations",
+           format_size(measurement.allocation_count()).string_view())
+      .key("peakResidentSize",
+           format_size(Measurement::get_peak_resident_size()).string_view());
+  }
+
+  static var::GeneralString format_size(size_t value) {
+    return var::GeneralString().format(
+      "%lu", static_cast<unsigned long>(value));
+  }
+
+  static void append_string(void *context, const char *data, size_t size) {
+    reinterpret_cast<var::String *>(context)->append(
+      var::StringView(data, size));
+  }
+
+  template <typename Value>
+  static var::String write_real(const ChartJsRealFormat &format, Value value) {
+    var::String result;
+    {
+      ChartJsWriter writer(&result, append_string);
+      writer.set_real_format(format).write_real(value);
+    }
+    return result;
+  }
+
+  static var::String stringify(const ChartJsDataSet &dataset) {
+    return json::JsonDocument().stringify(dataset.to_object());
+  }
 };
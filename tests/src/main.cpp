@@ -1,4 +1,7 @@
 ﻿#include <signal.h>
+#include <stdlib.h>
+
+#include <new>
 
 #include "UnitTest.hpp"
 
@@ -7,11 +10,37 @@
 
 void segfault(int a) { API_ASSERT(false); }
 
+#if defined __link
+// counts heap allocations for the performance cases
+size_t allocation_count = 0;
+
+void *operator new(size_t size) {
+  allocation_count++;
+  void *result = malloc(size);
+  if (result == nullptr) {
+    throw std::bad_alloc();
+  }
+  return result;
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+
+// jansson allocates its nodes with malloc rather than operator new
+void *json_malloc_counted(size_t size) {
+  allocation_count++;
+  return malloc(size);
+}
+
+void json_free_counted(void *ptr) { free(ptr); }
+#endif
+
 int main(int argc, char *argv[]) {
   sys::Cli cli(argc, argv);
 
 #if defined __link
   signal(11, segfault);
+  json_set_alloc_funcs(json_malloc_counted, json_free_counted);
 #endif
 
   printer::Printer printer;